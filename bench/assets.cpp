@@ -0,0 +1,31 @@
+#include "./bench.hpp"
+
+namespace okuu::bench {
+
+void run_assets() {
+  const u32 counts[] = {256u, 4096u};
+  constexpr u32 LOOKUPS = 4096u;
+  for (const u32 count : counts) {
+    const auto atlas = make_atlas(count);
+
+    bench_rng rng{1u};
+    std::vector<std::string> names(LOOKUPS);
+    for (auto& name : names) {
+      const u32 idx = static_cast<u32>(rng.next() * static_cast<real>(count));
+      name = fmt::format("chara_sprite.idle.{}", std::min(idx, count - 1u));
+    }
+
+    const u32 iters = 1000u;
+    u32 found = 0u;
+    const f64 ns = measure_ns(iters, [&]() {
+      for (const auto& name : names) {
+        found += atlas.find_sprite(name).has_value();
+      }
+    });
+    do_not_optimize(found);
+    NTF_ASSERT(found == (iters + 1u) * LOOKUPS);
+    report({fmt::format("assets.find_sprite.{}", count), LOOKUPS, iters, ns / LOOKUPS});
+  }
+}
+
+} // namespace okuu::bench
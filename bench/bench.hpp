@@ -0,0 +1,91 @@
+#pragma once
+
+#include "core.hpp"
+#include "stage/stage.hpp"
+
+#include <chrono>
+
+namespace okuu::bench {
+
+struct bench_result {
+  std::string name;
+  u32 entities;
+  u32 iters;
+  f64 ns_per_entity;
+};
+
+// Same sequence on every run, so the numbers are comparable between builds
+class bench_rng {
+public:
+  explicit bench_rng(u32 seed) : _state{seed} {}
+
+public:
+  // Uniform in [0, 1)
+  real next() {
+    _state = _state * 1664525u + 1013904223u;
+    return static_cast<real>(_state >> 8u) / static_cast<real>(1u << 24u);
+  }
+
+  real range(real min, real max) { return min + (max - min) * next(); }
+
+private:
+  u32 _state;
+};
+
+// Keeps the compiler from dropping work whose result is never read
+template<typename T>
+void do_not_optimize(const T& value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+template<typename F>
+f64 measure_ns(u32 iters, F&& func) {
+  using clock = std::chrono::steady_clock;
+  std::invoke(func); // warm up
+  const auto start = clock::now();
+  for (u32 i = 0; i < iters; ++i) {
+    std::invoke(func);
+  }
+  const auto end = clock::now();
+  return std::chrono::duration<f64, std::nano>(end - start).count() / static_cast<f64>(iters);
+}
+
+// Like measure_ns, but calls reset() before every iteration without timing it
+template<typename F, typename R>
+f64 measure_reset_ns(u32 iters, F&& func, R&& reset) {
+  using clock = std::chrono::steady_clock;
+  std::invoke(reset);
+  std::invoke(func); // warm up
+  f64 total = 0.0;
+  for (u32 i = 0; i < iters; ++i) {
+    std::invoke(reset);
+    const auto start = clock::now();
+    std::invoke(func);
+    const auto end = clock::now();
+    total += std::chrono::duration<f64, std::nano>(end - start).count();
+  }
+  return total / static_cast<f64>(iters);
+}
+
+// Atlas with generated sprite names and a single animation, without texture
+assets::sprite_atlas make_atlas(u32 sprites);
+
+// Headless scene with the player parked away from the playfield and culling pushed far enough
+// that nothing gets removed while measuring
+struct stage_fixture {
+  stage_fixture();
+
+  assets::asset_bundle bundle;
+  assets::atlas_handle atlas;
+  std::unique_ptr<stage::stage_scene> scene;
+};
+
+void report(const bench_result& res);
+
+bool run_movement(); // False if a kernel doesn't match next_pos
+void run_stage();
+void run_lua();
+void run_assets();
+void run_render(); // Needs a window
+
+} // namespace okuu::bench
@@ -0,0 +1,54 @@
+#include "./bench.hpp"
+
+namespace okuu::bench {
+
+namespace {
+
+constexpr u32 ANIM_FRAMES = 4u;
+constexpr real FIXTURE_CULL_MARGIN = 1e6f;
+
+fn make_player(const assets::sprite_atlas& atlas, assets::atlas_handle handle) {
+  const auto anim = atlas.find_animation("chara_sprite.idle").value();
+  stage::player_entity::animation_data anims;
+  anims.fill({anim, 0u});
+  assets::sprite_animator animator{atlas, anim};
+  return stage::player_entity{handle, vec2{1e5f, 1e5f}, 3.f, std::move(anims),
+                              std::move(animator)};
+}
+
+} // namespace
+
+assets::sprite_atlas make_atlas(u32 sprites) {
+  NTF_ASSERT(sprites >= ANIM_FRAMES);
+  ntf::unique_array<render::sprite_uvs> uvs(sprites);
+  std::unordered_map<std::string, u32> sprite_map;
+  const f32 uv_step = 1.f / static_cast<f32>(sprites);
+  for (u32 i = 0; i < sprites; ++i) {
+    uvs[i] = {uv_step, uv_step * static_cast<f32>(i), 1.f, 0.f};
+    // Long enough to skip the small string optimization, like the real atlas names
+    sprite_map.emplace(fmt::format("chara_sprite.idle.{}", i), i);
+  }
+
+  ntf::unique_array<assets::sprite_atlas::anim_meta> anims(1u);
+  anims[0] = {.fps = 12u, .start_idx = 0u, .count = ANIM_FRAMES};
+  std::unordered_map<std::string, u32> anim_map;
+  anim_map.emplace("chara_sprite.idle", 0u);
+
+  return {ntf::nullopt, std::move(uvs), std::move(sprite_map), std::move(anims),
+          std::move(anim_map)};
+}
+
+stage_fixture::stage_fixture() :
+    bundle{}, atlas{bundle.emplace_asset<assets::sprite_atlas>("bench", make_atlas(256u))} {
+  const stage::stage_config config{
+    .playfield_size = {600.f, 700.f},
+    .cull_margin = FIXTURE_CULL_MARGIN,
+    .graze_radius = 24.f,
+    .seed = 1u,
+    .workers = util::thread_pool::default_workers(),
+  };
+  auto player = make_player(bundle.get_asset(atlas), atlas);
+  scene = std::make_unique<stage::stage_scene>(config, std::move(player), ntf::nullopt);
+}
+
+} // namespace okuu::bench
@@ -0,0 +1,155 @@
+#include "./bench.hpp"
+
+#include "lua/assets.hpp"
+#include "lua/stage_env.hpp"
+
+namespace okuu::bench {
+
+namespace {
+
+constexpr std::string_view BENCH_SCRIPT = R"(
+local okuu = okuu
+local stage = okuu.__curr_stage
+local atlas = okuu.assets.require("bench")
+local sprite = atlas:get_sprite("chara_sprite.idle.0")
+local move_linear = okuu.stage.movement.move_linear
+
+function bench_spawn_n(count)
+  stage:spawn_proj_n(count, function(n)
+    local ang = 2*math.pi*n/count
+    return {
+      sprite = sprite,
+      pos = { x = 0, y = 0 },
+      vel = { x = 0, y = 0 },
+      scale = { x = 10, y = 10 },
+      angular_speed = math.pi,
+      movement = move_linear(math.cos(ang), math.sin(ang)),
+    }
+  end)
+end
+
+function bench_emit_ring(count)
+  stage:emit_ring {
+    sprite = sprite,
+    pos = { x = 0, y = 0 },
+    scale = { x = 10, y = 10 },
+    angular_speed = math.pi,
+    count = count,
+    speed = 1,
+  }
+end
+
+local batch = okuu.stage.spawn_buffer(10000)
+local sprite_id = sprite:get_id()
+
+function bench_spawn_batch(count)
+  for i = 0, count-1 do
+    local ang = 2*math.pi*i/count
+    local entry = batch[i]
+    entry.vel_x = math.cos(ang)
+    entry.vel_y = math.sin(ang)
+    entry.scale_x = 10
+    entry.scale_y = 10
+    entry.angular_speed = math.pi
+    entry.sprite = sprite_id
+  end
+  stage:spawn_batch(batch, count, atlas)
+end
+
+-- Closest projectile to a point, once through the view and once through handles
+function bench_scan_view()
+  local view = stage:get_proj_view()
+  local pos_x, pos_y = view.pos_x, view.pos_y
+  local best, best_dist = -1, math.huge
+  for i = 0, view.count-1 do
+    local dist = pos_x[i]*pos_x[i] + pos_y[i]*pos_y[i]
+    if (dist < best_dist) then
+      best, best_dist = i, dist
+    end
+  end
+  return best
+end
+
+function bench_scan_handles(handles)
+  local best, best_dist = nil, math.huge
+  for i = 1, #handles do
+    local pos = handles[i]:get_pos()
+    local dist = pos.x*pos.x + pos.y*pos.y
+    if (dist < best_dist) then
+      best, best_dist = handles[i], dist
+    end
+  end
+  return best
+end
+
+function bench_collect_handles()
+  local handles = {}
+  local count = stage:get_proj_view().count
+  for i = 0, count-1 do
+    handles[i+1] = stage:proj_at(i)
+  end
+  return handles
+end
+)";
+
+} // namespace
+
+void run_lua() {
+  stage_fixture fix;
+
+  sol::state lua;
+  lua.open_libraries(sol::lib::base, sol::lib::coroutine, sol::lib::package, sol::lib::table,
+                     sol::lib::math, sol::lib::string, sol::lib::ffi, sol::lib::jit);
+  auto okuu_lib = lua["okuu"].get_or_create<sol::table>();
+  lua::lua_assets::setup_module(okuu_lib, fix.bundle);
+  sol::protected_function stage_run = lua.safe_script("return function(stage) end");
+
+  lua::stage_env env{*fix.scene, std::move(lua), sol::nullopt, std::move(stage_run)};
+  env.setup_stage_modules();
+
+  auto env_lua = env.lua();
+  env_lua.safe_script(BENCH_SCRIPT);
+
+  const auto run_spawn = [&](const char* name, sol::protected_function spawn) {
+    const u32 counts[] = {100u, 1000u, 10000u};
+    for (const u32 count : counts) {
+      const u32 iters = std::max(2000000u / count, 10u);
+      const f64 ns = measure_reset_ns(
+        iters,
+        [&]() {
+          auto res = spawn(count);
+          NTF_ASSERT(res.valid());
+        },
+        [&]() { fix.scene->cancel_projs(); });
+      NTF_ASSERT(fix.scene->get_projectiles().size() == count);
+      report({name, count, iters, ns / count});
+    }
+  };
+  run_spawn("lua.spawn_proj_n", env_lua["bench_spawn_n"]);
+  run_spawn("lua.emit_ring", env_lua["bench_emit_ring"]);
+  run_spawn("lua.spawn_batch", env_lua["bench_spawn_batch"]);
+
+  sol::protected_function spawn_batch = env_lua["bench_spawn_batch"];
+  sol::protected_function scan_view = env_lua["bench_scan_view"];
+  sol::protected_function scan_handles = env_lua["bench_scan_handles"];
+  sol::protected_function collect_handles = env_lua["bench_collect_handles"];
+  const u32 scan_count = 10000u;
+  fix.scene->cancel_projs();
+  auto spawn_res = spawn_batch(scan_count);
+  NTF_ASSERT(spawn_res.valid());
+  sol::table handles = collect_handles();
+  const u32 scan_iters = 200u;
+  const f64 view_ns = measure_ns(scan_iters, [&]() {
+    auto res = scan_view();
+    NTF_ASSERT(res.valid());
+  });
+  report({"lua.scan_proj_view", scan_count, scan_iters, view_ns / scan_count});
+  const f64 handle_ns = measure_ns(scan_iters, [&]() {
+    auto res = scan_handles(handles);
+    NTF_ASSERT(res.valid());
+  });
+  report({"lua.scan_get_pos", scan_count, scan_iters, handle_ns / scan_count});
+  fix.scene->cancel_projs();
+}
+
+} // namespace okuu::bench
@@ -0,0 +1,87 @@
+#include "./bench.hpp"
+
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+
+namespace okuu::bench {
+
+namespace {
+
+std::vector<bench_result> g_results;
+
+bool write_json(const std::string& path) {
+  std::ofstream file{path};
+  if (!file) {
+    logger::error("Failed to open \"{}\"", path);
+    return false;
+  }
+
+  // Names are plain identifiers, nothing to escape
+  file << "{\n  \"results\": [\n";
+  for (u32 i = 0; i < g_results.size(); ++i) {
+    const auto& res = g_results[i];
+    file << fmt::format("    {{\"name\": \"{}\", \"entities\": {}, \"iters\": {}, "
+                        "\"ns_per_entity\": {:.4f}}}{}\n",
+                        res.name, res.entities, res.iters, res.ns_per_entity,
+                        i + 1u < g_results.size() ? "," : "");
+  }
+  file << "  ]\n}\n";
+  return static_cast<bool>(file);
+}
+
+} // namespace
+
+void report(const bench_result& res) {
+  logger::info("{:<40} {:>8} entities {:>6} iters {:>10.3f} ns/entity", res.name, res.entities,
+               res.iters, res.ns_per_entity);
+  g_results.push_back(res);
+}
+
+} // namespace okuu::bench
+
+int main(int argc, char* argv[]) {
+  ntf::logger::set_level(ntf::log_level::verbose);
+
+  const char* json_path = nullptr;
+  const char* filter = nullptr;
+  bool with_gl = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+      json_path = argv[++i];
+    } else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+      filter = argv[++i];
+    } else if (std::strcmp(argv[i], "--gl") == 0) {
+      with_gl = true;
+    } else {
+      ntf::logger::error("Usage: okuu_bench [--json file] [--filter group] [--gl]");
+      return 1;
+    }
+  }
+
+  // Groups that validate something return false on a mismatch, the run still finishes
+  bool valid = true;
+  const auto run_group = [&](const char* name, auto func) {
+    if (filter && std::strcmp(filter, name) != 0) {
+      return;
+    }
+    if constexpr (std::is_same_v<decltype(func()), bool>) {
+      valid = func() && valid;
+    } else {
+      func();
+    }
+  };
+  run_group("movement", &okuu::bench::run_movement);
+  run_group("stage", &okuu::bench::run_stage);
+  run_group("lua", &okuu::bench::run_lua);
+  run_group("assets", &okuu::bench::run_assets);
+  if (with_gl) {
+    // Opens a window, so it's opt in
+    run_group("render", &okuu::bench::run_render);
+  }
+
+  if (json_path && !okuu::bench::write_json(json_path)) {
+    return 1;
+  }
+  return valid ? 0 : 1;
+}
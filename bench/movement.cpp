@@ -0,0 +1,207 @@
+#include "./bench.hpp"
+
+#include "stage/movement.hpp"
+
+#include <cstring>
+
+namespace okuu::bench {
+
+namespace {
+
+struct movement_data {
+  movement_data(u32 count, u32 seed) :
+      pos_x(count), pos_y(count), vel_x(count), vel_y(count), acc_x(count), acc_y(count),
+      ret(count), rot(count), ang_speed(count), margin(count), dead(count), attr(count) {
+    bench_rng rng{seed};
+    const auto rand = [&]() -> real { return rng.next(); };
+    for (u32 i = 0; i < count; ++i) {
+      pos_x[i] = 600.f * rand() - 300.f;
+      pos_y[i] = 700.f * rand() - 350.f;
+      vel_x[i] = 10.f * rand() - 5.f;
+      vel_y[i] = 10.f * rand() - 5.f;
+      acc_x[i] = rand() - .5f;
+      acc_y[i] = rand() - .5f;
+      ret[i] = .8f + .2f * rand();
+      rot[i] = 0.f;
+      ang_speed[i] = 6.28f * rand();
+      margin[i] = 20.f * rand();
+      attr[i] = {cmplx{.01f * rand(), 0.f}, cmplx{600.f * rand() - 300.f, 0.f}, 1.f};
+    }
+  }
+
+  stage::movement_batch batch() {
+    return {
+      .pos_x = pos_x.data(),
+      .pos_y = pos_y.data(),
+      .vel_x = vel_x.data(),
+      .vel_y = vel_y.data(),
+      .acc_x = acc_x.data(),
+      .acc_y = acc_y.data(),
+      .ret = ret.data(),
+      .rot = rot.data(),
+      .ang_speed = ang_speed.data(),
+      .margin = margin.data(),
+      .dead = dead.data(),
+      .bounds = {-300.f, -350.f, 300.f, 350.f},
+      .count = static_cast<u32>(pos_x.size()),
+    };
+  }
+
+  bool same_as(const movement_data& other) const {
+    const auto cmp = [](const std::vector<real>& a, const std::vector<real>& b) {
+      return std::memcmp(a.data(), b.data(), a.size() * sizeof(real)) == 0;
+    };
+    return cmp(pos_x, other.pos_x) && cmp(pos_y, other.pos_y) && cmp(vel_x, other.vel_x) &&
+           cmp(vel_y, other.vel_y) && cmp(rot, other.rot) && dead == other.dead;
+  }
+
+  std::vector<real> pos_x, pos_y;
+  std::vector<real> vel_x, vel_y;
+  std::vector<real> acc_x, acc_y;
+  std::vector<real> ret;
+  std::vector<real> rot;
+  std::vector<real> ang_speed;
+  std::vector<real> margin;
+  std::vector<u8> dead;
+  std::vector<stage::attractor_data> attr;
+};
+
+constexpr u32 VALIDATE_STEPS = 64u;
+
+enum class checked_kind {
+  linear,
+  interpolated,
+  attractor,
+};
+
+// Steps every entry of `start` through entity_movement::next_pos, which is what the rest of the
+// entities use. The kernels have to match it, not only each other.
+bool matches_next_pos(const movement_data& start, const movement_data& result, checked_kind kind) {
+  const auto same = [](real a, real b) { return std::memcmp(&a, &b, sizeof(real)) == 0; };
+  for (u32 i = 0; i < start.pos_x.size(); ++i) {
+    const vec2 vel{start.vel_x[i], start.vel_y[i]};
+    const vec2 acc{start.acc_x[i], start.acc_y[i]};
+    const auto& attr = start.attr[i];
+    stage::entity_movement movement;
+    switch (kind) {
+      case checked_kind::linear: {
+        movement = stage::entity_movement::move_linear(vel);
+      } break;
+      case checked_kind::interpolated: {
+        movement = stage::entity_movement::move_interpolated(vel, vec2{0.f}, start.ret[i]);
+        movement.acc(acc.x, acc.y);
+      } break;
+      case checked_kind::attractor: {
+        // The bench data always uses an exponent of 1, same as move_towards
+        movement = stage::entity_movement::move_towards(
+          vec2{attr.attr_p.real(), attr.attr_p.imag()}, vel,
+          vec2{attr.attr.real(), attr.attr.imag()}, start.ret[i]);
+        movement.acc(acc.x, acc.y);
+      } break;
+    }
+    vec2 pos{start.pos_x[i], start.pos_y[i]};
+    for (u32 step = 0; step < VALIDATE_STEPS; ++step) {
+      movement.next_pos(pos);
+    }
+    const vec2 end_vel = movement.vel();
+    if (!same(pos.x, result.pos_x[i]) || !same(pos.y, result.pos_y[i]) ||
+        !same(end_vel.x, result.vel_x[i]) || !same(end_vel.y, result.vel_y[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool validate(stage::simd_level level) {
+  const auto& scalar = stage::get_movement_kernels(stage::simd_level::scalar);
+  const auto& simd = stage::get_movement_kernels(level);
+
+  const movement_data lin_start{1027u, 1u}, int_start{1027u, 2u};
+  movement_data lin_a{lin_start}, lin_b{lin_start};
+  movement_data int_a{int_start}, int_b{int_start};
+  for (u32 i = 0; i < VALIDATE_STEPS; ++i) {
+    scalar.linear(lin_a.batch());
+    simd.linear(lin_b.batch());
+    scalar.interpolated(int_a.batch());
+    simd.interpolated(int_b.batch());
+  }
+
+  const auto name = stage::simd_level_name(level);
+  if (!matches_next_pos(lin_start, lin_a, checked_kind::linear) ||
+      !matches_next_pos(int_start, int_a, checked_kind::interpolated)) {
+    logger::error("Scalar movement kernels don't match entity_movement::next_pos");
+    return false;
+  }
+  if (!lin_a.same_as(lin_b) || !int_a.same_as(int_b)) {
+    logger::error("Movement kernel \"{}\" doesn't match the scalar results", name);
+    return false;
+  }
+  logger::info("Movement kernel \"{}\" is bit identical to scalar and next_pos after {} steps",
+               name, VALIDATE_STEPS);
+  return true;
+}
+
+// Not part of the kernel table, it always goes through the active interpolated kernel
+bool validate_attractor() {
+  const movement_data start{1027u, 3u};
+  movement_data result{start};
+  for (u32 i = 0; i < VALIDATE_STEPS; ++i) {
+    stage::integrate_attractor(result.batch(), result.attr.data());
+  }
+  if (!matches_next_pos(start, result, checked_kind::attractor)) {
+    logger::error("integrate_attractor doesn't match entity_movement::next_pos");
+    return false;
+  }
+  logger::info("integrate_attractor is bit identical to next_pos after {} steps", VALIDATE_STEPS);
+  return true;
+}
+
+} // namespace
+
+bool run_movement() {
+  const auto best = stage::detect_simd_level();
+  logger::info("Detected SIMD level: {}", stage::simd_level_name(best));
+
+  const stage::simd_level levels[] = {
+    stage::simd_level::scalar,
+    stage::simd_level::sse2,
+    stage::simd_level::avx2,
+  };
+  bool valid = validate_attractor();
+  for (const auto level : levels) {
+    if (level > best) {
+      continue;
+    }
+    valid = validate(level) && valid;
+  }
+
+  const u32 counts[] = {1000u, 10000u, 100000u};
+  for (const u32 count : counts) {
+    const u32 iters = 10000000u / count;
+    for (const auto level : levels) {
+      if (level > best) {
+        continue;
+      }
+      const auto& kernels = stage::get_movement_kernels(level);
+      const auto name = stage::simd_level_name(level);
+
+      movement_data data{count, 1u};
+      const auto batch = data.batch();
+
+      const f64 lin_ns = measure_ns(iters, [&]() { kernels.linear(batch); });
+      report({fmt::format("movement.linear.{}", name), count, iters, lin_ns / count});
+
+      const f64 int_ns = measure_ns(iters, [&]() { kernels.interpolated(batch); });
+      report({fmt::format("movement.interpolated.{}", name), count, iters, int_ns / count});
+    }
+
+    movement_data data{count, 1u};
+    const auto batch = data.batch();
+    const f64 attr_ns =
+      measure_ns(iters, [&]() { stage::integrate_attractor(batch, data.attr.data()); });
+    report({"movement.attractor", count, iters, attr_ns / count});
+  }
+  return valid;
+}
+
+} // namespace okuu::bench
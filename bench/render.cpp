@@ -0,0 +1,72 @@
+#include "./bench.hpp"
+
+#include "render/common.hpp"
+#include "stage/stage.hpp"
+
+namespace okuu::bench {
+
+void run_render() {
+  auto _rh = render::init();
+
+  const u32 instances = render::stage_renderer::DEFAULT_STAGE_INSTANCES;
+  auto renderer = render::stage_renderer::create(instances).value();
+
+  const u32 pixel = 0xFFFFFFFF;
+  auto tex = render::create_texture(1u, 1u, &pixel).value();
+
+  bench_rng rng{1u};
+  std::vector<render::stage_renderer::sprite_render_data> sprites(instances);
+  for (auto& sprite : sprites) {
+    shogle::transform2d<real> t{};
+    t.pos(vec2{rng.range(-300.f, 300.f), rng.range(-350.f, 350.f)}).scale(10.f, 10.f);
+    sprite = {
+      .transform = t.world(),
+      .texture = tex,
+      .ticks = 0u,
+      .uvs = {1.f, 0.f, 1.f, 0.f},
+      .color = {1.f, 1.f, 1.f, 1.f},
+    };
+  }
+
+  const u32 iters = 1000u;
+  const f64 ns = measure_reset_ns(
+    iters,
+    [&]() {
+      for (const auto& sprite : sprites) {
+        renderer.enqueue_sprite(sprite);
+      }
+    },
+    [&]() { renderer.reset_instances(); });
+  report({"render.enqueue_sprite", instances, iters, ns / instances});
+
+  // A full bullet cancel burst, appended the same way the scene does it
+  {
+    constexpr u32 BURST = 10000u;
+    auto stage_renderer =
+      render::stage_renderer::create(render::stage_renderer::MAX_STAGE_INSTANCES).value();
+    stage::particle_system particles;
+    const auto desc = particles.register_desc({
+      .lifetime = 30u,
+      .count = BURST,
+      .angle = 0.f,
+      .spread = 6.28f,
+      .speed_min = 1.f,
+      .speed_max = 4.f,
+      .drag = .95f,
+      .scale_start = 8.f,
+      .scale_end = 2.f,
+      .alpha_start = 1.f,
+      .alpha_end = 0.f,
+      .sprite = {assets::atlas_handle{0u}, assets::sprite_atlas::sprite{0u}, vec2{1.f, 1.f}},
+    });
+    particles.emit(desc, vec2{0.f, 0.f});
+    const stage::particle_sprites sprite_data{{tex, render::sprite_uvs{1.f, 0.f, 1.f, 0.f}}};
+    const f64 burst_ns = measure_reset_ns(
+      100u, [&]() { stage::enqueue_particles(stage_renderer, particles, sprite_data, 0u); },
+      [&]() { stage_renderer.reset_instances(); });
+    NTF_ASSERT(stage_renderer.dropped_instances() == 0u);
+    report({"render.particle_burst", BURST, 100u, burst_ns / BURST});
+  }
+}
+
+} // namespace okuu::bench
@@ -0,0 +1,328 @@
+#include "./bench.hpp"
+
+#include "stage/snapshot.hpp"
+
+#include <numeric>
+
+namespace okuu::bench {
+
+namespace {
+
+enum class tick_movement {
+  linear = 0,
+  interpolated,
+  attractor,
+  analytic,
+  orbit,
+  wave,
+  path,
+  capped,
+  mixed, // Every kind above, interleaved on spawn
+};
+
+constexpr std::string_view tick_movement_name(tick_movement kind) {
+  switch (kind) {
+    case tick_movement::linear:
+      return "linear";
+    case tick_movement::interpolated:
+      return "interpolated";
+    case tick_movement::attractor:
+      return "attractor";
+    case tick_movement::analytic:
+      return "analytic";
+    case tick_movement::orbit:
+      return "orbit";
+    case tick_movement::wave:
+      return "wave";
+    case tick_movement::path:
+      return "path";
+    case tick_movement::capped:
+      return "capped";
+    case tick_movement::mixed:
+      return "mixed";
+  }
+  NTF_UNREACHABLE();
+}
+
+constexpr u32 MIXED_KINDS = static_cast<u32>(tick_movement::mixed);
+
+void spawn_projs(stage_fixture& fix, u32 count, tick_movement kind, u32 seed) {
+  bench_rng rng{seed};
+  auto& projs = fix.scene->get_projectiles();
+  const auto sprite = fix.bundle.get_asset(fix.atlas).find_sprite("chara_sprite.idle.0").value();
+  for (u32 i = 0; i < count; ++i) {
+    const vec2 vel{rng.range(-2.f, 2.f), rng.range(-2.f, 2.f)};
+    const tick_movement curr_kind =
+      kind == tick_movement::mixed ? static_cast<tick_movement>(i % MIXED_KINDS) : kind;
+    stage::entity_movement movement;
+    switch (curr_kind) {
+      case tick_movement::linear: {
+        movement = stage::entity_movement::move_linear(vel);
+      } break;
+      case tick_movement::interpolated:
+      case tick_movement::analytic: {
+        movement = stage::entity_movement::move_interpolated(vel * 4.f, vel, .95f);
+      } break;
+      case tick_movement::attractor: {
+        const vec2 target{rng.range(-300.f, 300.f), rng.range(-350.f, 350.f)};
+        movement = stage::entity_movement::move_towards(target, vel, vec2{.01f, 0.f}, .9f);
+      } break;
+      case tick_movement::orbit: {
+        const vec2 center{rng.range(-300.f, 300.f), rng.range(-350.f, 350.f)};
+        movement = stage::entity_movement::move_orbit(center, rng.range(10.f, 100.f),
+                                                      rng.range(0.f, 6.28f), .05f, .1f);
+      } break;
+      case tick_movement::wave: {
+        movement = stage::entity_movement::move_wave(vel, 20.f, .1f);
+      } break;
+      case tick_movement::path: {
+        movement = stage::entity_movement::move_path(
+          stage::path_curve::bezier,
+          {vec2{0.f, 0.f}, vec2{100.f, 0.f}, vec2{100.f, 100.f}, vec2{0.f, 100.f}}, 120u);
+      } break;
+      case tick_movement::capped: {
+        movement = stage::entity_movement::move_capped(vel, .05f, 4.f);
+      } break;
+      case tick_movement::mixed: NTF_UNREACHABLE();
+    }
+    projs.spawn({
+      .pos = {rng.range(-300.f, 300.f), rng.range(-350.f, 350.f)},
+      .vel = vel,
+      .scale = {10.f, 10.f},
+      .angular_speed = rng.range(0.f, 6.28f),
+      .hitbox = 5.f,
+      .cull_margin = 10.f,
+      .sprite = {fix.atlas, sprite, vec2{1.f, 1.f}},
+      .movement = movement,
+      .analytic = curr_kind == tick_movement::analytic,
+      .damage = 1.f,
+    });
+  }
+}
+
+void bench_tick() {
+  const tick_movement kinds[] = {
+    tick_movement::linear,
+    tick_movement::interpolated,
+    tick_movement::attractor,
+    tick_movement::analytic,
+    tick_movement::orbit,
+    tick_movement::wave,
+    tick_movement::path,
+    tick_movement::capped,
+    tick_movement::mixed,
+  };
+  const u32 counts[] = {1000u, 10000u, 50000u};
+  for (const u32 count : counts) {
+    const u32 iters = std::max(20000000u / count, 10u);
+    for (const auto kind : kinds) {
+      stage_fixture fix;
+      spawn_projs(fix, count, kind, 1u);
+      const f64 ns = measure_ns(iters, [&]() { fix.scene->tick(stage::KEY_NONE); });
+      NTF_ASSERT(fix.scene->get_projectiles().size() == count);
+      report({fmt::format("stage.tick.{}", tick_movement_name(kind)), count, iters, ns / count});
+    }
+  }
+}
+
+void bench_entity_churn() {
+  const u32 counts[] = {1000u, 10000u};
+  for (const u32 count : counts) {
+    const u32 iters = std::max(5000000u / count, 10u);
+    stage::entity_list<stage::sprite_entity> list;
+
+    // Kill in a shuffled order, so the swaps and freed slots don't line up with spawn order
+    bench_rng rng{1u};
+    std::vector<u32> order(count);
+    std::iota(order.begin(), order.end(), 0u);
+    for (u32 i = count - 1u; i > 0u; --i) {
+      const u32 j = static_cast<u32>(rng.next() * static_cast<real>(i + 1u));
+      std::swap(order[i], order[std::min(j, i)]);
+    }
+
+    std::vector<u64> handles(count);
+    const stage::sprite_args args{
+      .pos = {0.f, 0.f},
+      .scale = {1.f, 1.f},
+      .rot = 0.f,
+      .angular_speed = 0.f,
+      .sprite = {assets::atlas_handle{0u}, assets::sprite_atlas::sprite{0u}, vec2{1.f, 1.f}},
+      .movement = stage::entity_movement::move_linear(vec2{1.f, 0.f}),
+    };
+    const f64 ns = measure_ns(iters, [&]() {
+      for (u32 i = 0; i < count; ++i) {
+        handles[i] = list.spawn(args);
+      }
+      for (const u32 idx : order) {
+        list.kill(handles[idx]);
+      }
+    });
+    report({"stage.entity_list.churn", count, iters, ns / count});
+  }
+}
+
+// A full tick with a fresh volley of player shots over enemies that never die, so every tick does
+// the same broadphase work. Per shot cost should stay flat as the enemy count grows.
+void bench_shot_hits() {
+  constexpr u32 SHOT_COUNT = 200u;
+  const u32 enemy_counts[] = {100u, 1000u};
+  for (const u32 enemy_count : enemy_counts) {
+    stage_fixture fix;
+    const auto sprite =
+      fix.bundle.get_asset(fix.atlas).find_sprite("chara_sprite.idle.0").value();
+    bench_rng rng{1u};
+    auto& enemies = fix.scene->get_enemies();
+    for (u32 i = 0; i < enemy_count; ++i) {
+      enemies.spawn(stage::enemy_args{
+        .pos = {rng.range(-300.f, 300.f), rng.range(-350.f, 350.f)},
+        .scale = {20.f, 20.f},
+        .hp = 1e9f,
+        .hitbox = 10.f,
+        .sprite = {fix.atlas, sprite, vec2{1.f, 1.f}},
+        .movement = stage::entity_movement::move_linear(vec2{0.f, 0.f}),
+      });
+    }
+
+    auto& shots = fix.scene->get_shots();
+    const f64 ns = measure_reset_ns(
+      1000u, [&]() { fix.scene->tick(stage::KEY_NONE); },
+      [&]() {
+        shots.clear();
+        for (u32 i = 0; i < SHOT_COUNT; ++i) {
+          shots.spawn({
+            .pos = {rng.range(-300.f, 300.f), rng.range(-350.f, 350.f)},
+            .vel = {0.f, -8.f},
+            .scale = {8.f, 8.f},
+            .angular_speed = 0.f,
+            .hitbox = 4.f,
+            .cull_margin = 8.f,
+            .sprite = {fix.atlas, sprite, vec2{1.f, 1.f}},
+            .movement = stage::entity_movement::move_linear(vec2{0.f, -8.f}),
+            .analytic = false,
+            .damage = 1.f,
+          });
+        }
+      });
+    NTF_ASSERT(enemies.size() == enemy_count);
+    report({"stage.shot_hits", enemy_count, 1000u, ns / SHOT_COUNT});
+  }
+}
+
+// Items falling over the whole playfield with the player in the middle of them, so every tick
+// collects some, attracts some and moves the rest
+void bench_items() {
+  const u32 counts[] = {1000u, 5000u};
+  for (const u32 count : counts) {
+    stage_fixture fix;
+    const auto sprite =
+      fix.bundle.get_asset(fix.atlas).find_sprite("chara_sprite.idle.0").value();
+    auto& items = fix.scene->get_items();
+    items.reserve(count);
+    fix.scene->get_player().pos(0.f, 200.f);
+    bench_rng rng{1u};
+    const f64 ns = measure_reset_ns(
+      1000u, [&]() { fix.scene->tick(stage::KEY_NONE); },
+      [&]() {
+        items.clear();
+        for (u32 i = 0; i < count; ++i) {
+          items.spawn({
+            .kind = static_cast<stage::item_kind>(i % stage::ITEM_KIND_COUNT),
+            .pos = {rng.range(-300.f, 300.f), rng.range(-350.f, 350.f)},
+            .vel = {rng.range(-2.f, 2.f), -2.f},
+            .value = 1.f,
+            .scale = 16.f,
+            .sprite = {fix.atlas, sprite, vec2{1.f, 1.f}},
+          });
+        }
+      });
+    report({"stage.items", count, 1000u, ns / count});
+  }
+}
+
+// A bullet cancel sized burst, reset every iteration so half of the particles don't expire midway
+void bench_particles() {
+  const u32 counts[] = {1000u, 10000u};
+  for (const u32 count : counts) {
+    stage::particle_system particles;
+    particles.reserve(count);
+    const auto desc = particles.register_desc({
+      .lifetime = 30u,
+      .count = count,
+      .angle = 0.f,
+      .spread = 6.28f,
+      .speed_min = 1.f,
+      .speed_max = 4.f,
+      .drag = .95f,
+      .scale_start = 8.f,
+      .scale_end = 2.f,
+      .alpha_start = 1.f,
+      .alpha_end = 0.f,
+      .sprite = {assets::atlas_handle{0u}, assets::sprite_atlas::sprite{0u}, vec2{1.f, 1.f}},
+    });
+    const f64 ns = measure_reset_ns(
+      1000u, [&]() { particles.tick(); },
+      [&]() {
+        particles.clear();
+        particles.emit(desc, vec2{0.f, 0.f});
+      });
+    NTF_ASSERT(particles.size() == count);
+    report({"stage.particles", count, 1000u, ns / count});
+  }
+}
+
+// Serialized snapshots of a moving bullet field, taken against the one from the previous tick like
+// the game does. Checkpoints don't serialize on the tick, but saving the state still does.
+void bench_snapshots() {
+  const u32 counts[] = {10000u, 50000u};
+  for (const u32 count : counts) {
+    stage_fixture fix;
+    spawn_projs(fix, count, tick_movement::mixed, 1u);
+    auto prev = stage::stage_snapshot::take(*fix.scene, 0u);
+    const f64 take_ns = measure_reset_ns(
+      100u, [&]() { prev = stage::stage_snapshot::take(*fix.scene, 0u, &prev); },
+      [&]() { fix.scene->tick(stage::KEY_NONE); });
+    report({"stage.snapshot.take", count, 100u, take_ns / count});
+
+    const f64 restore_ns = measure_ns(100u, [&]() {
+      if (!prev.restore(*fix.scene)) {
+        logger::error("Failed to restore the bench snapshot");
+      }
+    });
+    NTF_ASSERT(fix.scene->get_projectiles().size() == count);
+    report({"stage.snapshot.restore", count, 100u, restore_ns / count});
+  }
+}
+
+// Scalar draws against the bulk lanes, per value
+void bench_rng_fill() {
+  constexpr u32 count = 4096u;
+  std::vector<real> values(count);
+  util::rng_stream rng{1u};
+  const f64 scalar_ns = measure_ns(1000u, [&]() {
+    for (u32 i = 0; i < count; ++i) {
+      values[i] = rng.uniform();
+    }
+    do_not_optimize(values.data());
+  });
+  report({"util.rng_uniform", count, 1000u, scalar_ns / count});
+
+  const f64 bulk_ns = measure_ns(1000u, [&]() {
+    rng.fill_uniform(values.data(), count);
+    do_not_optimize(values.data());
+  });
+  report({"util.rng_fill_uniform", count, 1000u, bulk_ns / count});
+}
+
+} // namespace
+
+void run_stage() {
+  bench_tick();
+  bench_entity_churn();
+  bench_shot_hits();
+  bench_items();
+  bench_particles();
+  bench_snapshots();
+  bench_rng_fill();
+}
+
+} // namespace okuu::bench
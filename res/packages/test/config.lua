@@ -11,6 +11,10 @@ okuu.package.register_stages {
   {
     name = "the funny_stage",
     path = "stage0.lua",
+    playfield = { width = 600, height = 700 },
+    cull_margin = 0,
+    graze_radius = 24,
+    seed = 1,
   },
 }
 
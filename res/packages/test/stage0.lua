@@ -6,6 +6,10 @@ local function stage_setup(stage)
   stage:register_event("stage::on_boss_move", function(pos)
     okuu.logger.info(string.format("[lua] Marisa moved to %f %f!!!!", pos.x, pos.y))
   end)
+  stage:register_event("stage::on_player_hit", function(proj)
+    local pos = proj:get_pos()
+    okuu.logger.info(string.format("[lua] Cirno got hit at %f %f!!!!", pos.x, pos.y))
+  end)
 end
 
 local function stage_run(stage)
@@ -45,12 +49,15 @@ local function stage_run(stage)
     scale = { x = -500, y = 500 },
   }
 
+  local on_boss_move = stage:event_id("stage::on_boss_move")
+
   local sprites = {
     "chara_marisa.idle.1",
     "chara_reimu.idle.1"
   }
   local function move_to(x, y)
     local proj_pos = marisa_boss:get_pos()
+    local rng = stage:rng()
     stage:spawn_proj_n(16, function(n)
       local dir_x = 10*math.cos(2*math.pi*n/16)
       local dir_y = 10*math.sin(2*math.pi*n/16)
@@ -60,7 +67,11 @@ local function stage_run(stage)
         vel = { x = 0, y = 0},
         scale = { x = 50, y = 50 },
         angular_speed = 2*math.pi,
-        movement = okuu.stage.movement.move_linear(dir_x, dir_y)
+        movement = okuu.stage.movement.move_linear(dir_x, dir_y),
+        state_handler = function(proj)
+          coroutine.yield(30) -- sleep for 30 ticks
+          proj:set_movement(okuu.stage.movement.move_linear(-dir_x/2, -dir_y/2))
+        end,
       }
     end)
     stage:spawn_proj_n(32, function(n)
@@ -68,8 +79,8 @@ local function stage_run(stage)
       local dir_player = player_pos - proj_pos
       local len = math.sqrt(dir_player.x*dir_player.x + dir_player.y*dir_player.y)
 
-      local ang = math.random()/2
-      local sp = math.random(4, 10)
+      local ang = rng:next()/2
+      local sp = rng:int(4, 10)
       local dir = okuu.math.cmplx(sp*dir_player.x/len, sp*dir_player.y/len)
       if (n % 2 == 0) then
         local rot = okuu.math.cmplx(math.cos(ang), math.sin(-ang))
@@ -89,16 +100,24 @@ local function stage_run(stage)
       }
     end)
     marisa_boss:set_movement(okuu.stage.movement.move_towards(10., 10., x, y))
-    stage:trigger_event("stage::on_boss_move", {x = proj_pos.x, y = proj_pos.y})
+    -- Delivered at the end of the tick
+    stage:queue_event(on_boss_move, {x = proj_pos.x, y = proj_pos.y})
   end
 
+  -- Runs alongside the boss pattern
+  stage:spawn_task(function(stage)
+    while (true) do
+      reimu:set_pos(-600, -150)
+      reimu:set_movement(okuu.stage.movement.move_linear(20, 0))
+      stage:yield_secs(1)
+    end
+  end)
+
   while (true) do
-    reimu:set_movement(okuu.stage.movement.move_linear(20, 0))
     move_to(-150, -250)
     stage:yield_secs(.5)
     move_to(150, -250)
     stage:yield_secs(.5)
-    reimu:set_pos(-600, -150)
   end
 end
 
@@ -1,17 +1,20 @@
 #include "./sprite.hpp"
 #include "../render/common.hpp"
+#include "../util/profiler.hpp"
 
 namespace okuu::assets {
 
-sprite_atlas::sprite_atlas(shogle::texture2d&& tex, ntf::unique_array<render::sprite_uvs>&& uvs,
+sprite_atlas::sprite_atlas(ntf::optional<shogle::texture2d>&& tex,
+                           ntf::unique_array<render::sprite_uvs>&& uvs,
                            std::unordered_map<std::string, u32>&& sprite_map,
                            ntf::unique_array<anim_meta>&& anim_pos,
                            std::unordered_map<std::string, u32>&& anim_map) :
     _tex{std::move(tex)}, _sprite_uvs{std::move(uvs)}, _sprite_map{std::move(sprite_map)},
     _anim_pos{std::move(anim_pos)}, _anim_map{std::move(anim_map)} {}
 
-expect<sprite_atlas> sprite_atlas::from_chima(const chima::spritesheet& sheet) {
-  const auto parse_sheet = [&](shogle::texture2d&& atlas_tex) -> sprite_atlas {
+expect<sprite_atlas> sprite_atlas::from_chima(const chima::spritesheet& sheet, bool load_texture) {
+  OKUU_PROFILE_ZONE("assets::from_chima");
+  const auto parse_sheet = [&](ntf::optional<shogle::texture2d>&& atlas_tex) -> sprite_atlas {
     const auto sprites = sheet.sprites();
     ntf::unique_array<render::sprite_uvs> uvs(sprites.size());
     std::unordered_map<std::string, u32> sprite_map;
@@ -50,8 +53,14 @@ expect<sprite_atlas> sprite_atlas::from_chima(const chima::spritesheet& sheet) {
             std::move(anim_map)};
   };
 
+  if (!load_texture) {
+    return {ntf::in_place, parse_sheet(ntf::nullopt)};
+  }
   const auto [width, height] = sheet.atlas_extent();
-  return render::create_texture(width, height, sheet.atlas_data()).transform(parse_sheet);
+  return render::create_texture(width, height, sheet.atlas_data())
+    .transform([&](shogle::texture2d&& tex) {
+      return parse_sheet(ntf::optional<shogle::texture2d>{ntf::in_place, std::move(tex)});
+    });
 }
 
 auto sprite_atlas::find_sprite(std::string_view name) const -> ntf::optional<sprite> {
@@ -74,7 +83,8 @@ auto sprite_atlas::render_data(sprite spr) const
   -> std::pair<shogle::texture2d_view, render::sprite_uvs> {
   const u32 idx = static_cast<u32>(spr);
   NTF_ASSERT(idx < _sprite_uvs.size());
-  return {_tex, _sprite_uvs[idx]};
+  NTF_ASSERT(_tex.has_value(), "Atlas loaded without texture");
+  return {*_tex, _sprite_uvs[idx]};
 }
 
 u32 sprite_atlas::anim_length(animation anim) const {
@@ -176,4 +186,27 @@ std::pair<sprite_atlas::sprite, vec2> sprite_animator::frame() const {
   return {idx, uv_modifier};
 }
 
+void sprite_animator::save(util::byte_writer& out) const {
+  // std::queue can't be iterated, go through a copy
+  auto queue = _anim_queue;
+  std::vector<anim_entry> entries;
+  entries.reserve(queue.size());
+  while (!queue.empty()) {
+    entries.push_back(queue.front());
+    queue.pop();
+  }
+  out.write(entries);
+}
+
+void sprite_animator::load(util::byte_reader& in) {
+  auto entries = in.read<std::vector<anim_entry>>();
+  if (entries.empty()) {
+    return; // The queue always keeps at least one animation
+  }
+  _anim_queue = {};
+  for (const auto& entry : entries) {
+    _anim_queue.push(entry);
+  }
+}
+
 } // namespace okuu::assets
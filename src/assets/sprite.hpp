@@ -2,6 +2,7 @@
 
 #include "../core.hpp"
 #include "../render/stage.hpp"
+#include "../util/serialize.hpp"
 #include <chimatools/chimatools.hpp>
 
 #include <ntfstl/unique_array.hpp>
@@ -11,7 +12,7 @@
 namespace okuu::assets {
 
 class sprite_atlas {
-private:
+public:
   struct anim_meta {
     u32 fps;
     u32 start_idx;
@@ -23,13 +24,16 @@ public:
   enum class animation : u32 {};
 
 public:
-  sprite_atlas(shogle::texture2d&& tex, ntf::unique_array<render::sprite_uvs>&& uvs,
+  sprite_atlas(ntf::optional<shogle::texture2d>&& tex,
+               ntf::unique_array<render::sprite_uvs>&& uvs,
                std::unordered_map<std::string, u32>&& sprite_map,
                ntf::unique_array<anim_meta>&& anim_pos,
                std::unordered_map<std::string, u32>&& anim_map);
 
 public:
-  static expect<sprite_atlas> from_chima(const chima::spritesheet& sheet);
+  // Without the texture only the sprite and animation metadata gets loaded, for headless runs
+  static expect<sprite_atlas> from_chima(const chima::spritesheet& sheet,
+                                         bool load_texture = true);
 
 public:
   ntf::optional<sprite> find_sprite(std::string_view name) const;
@@ -37,11 +41,13 @@ public:
 
   std::pair<shogle::texture2d_view, render::sprite_uvs> render_data(sprite spr) const;
 
+  u32 sprite_count() const { return static_cast<u32>(_sprite_uvs.size()); }
+
   u32 anim_length(animation anim) const;
   sprite anim_sprite_at(animation anim, u32 tick) const;
 
 private:
-  shogle::texture2d _tex;
+  ntf::optional<shogle::texture2d> _tex;
   ntf::unique_array<render::sprite_uvs> _sprite_uvs;
   std::unordered_map<std::string, u32> _sprite_map;
   ntf::unique_array<anim_meta> _anim_pos;
@@ -79,6 +85,10 @@ public:
   void tick();
   std::pair<sprite_atlas::sprite, vec2> frame() const;
 
+  // Saves the animation queue, the atlas stays the same
+  void save(util::byte_writer& out) const;
+  void load(util::byte_reader& in);
+
   const sprite_atlas& atlas() const { return *_atlas; }
 
 private:
@@ -0,0 +1,309 @@
+#include "./game.hpp"
+
+#include "./lua/package.hpp"
+#include "./util/profiler.hpp"
+
+namespace okuu {
+
+static constexpr u32 MAX_ENTITIES = render::stage_renderer::MAX_STAGE_INSTANCES;
+
+namespace {
+
+void step_stage(lua::stage_env& env, stage::stage_scene& scene, stage::input_state input) {
+  env.run_tasks();
+  env.run_behaviors();
+  scene.tick(input);
+  env.dispatch_events();
+}
+
+// Runs on the standby worker, the snapshot shares most of its pages with the expected one
+bool standby_diverged(const stage::stage_scene& scene, const stage::stage_snapshot& expected) {
+  OKUU_PROFILE_ZONE("game::check_standby");
+  const auto snap = stage::stage_snapshot::take(scene, expected.tick(), &expected);
+  return !snap.same_as(expected);
+}
+
+} // namespace
+
+game_state::game_state(std::unique_ptr<assets::asset_bundle>&& assets,
+                       std::unique_ptr<stage::stage_scene>&& scene, lua::stage_env&& lua_env,
+                       std::unique_ptr<stage::input_source>&& input, std::string script_path) :
+    _assets{std::move(assets)},
+    _scene{std::move(scene)}, _lua_env{std::make_unique<lua::stage_env>(std::move(lua_env))},
+    _input{std::move(input)}, _script_path{std::move(script_path)}, _input_log{}, _initial{},
+    _last_snapshot{}, _checkpoint_snap{}, _standby{}, _checkpoint{0u}, _ticks{0u}, _t{0.f},
+    _standby_worker{} {
+  NTF_ASSERT(_input);
+
+  // Replays start from here, before the setup function gets to touch the scene
+  _initial = stage::stage_snapshot::take(*_scene, 0u);
+  _lua_env->setup_stage_modules(); // Call this AFTER _lua_env has been constructed
+}
+
+expect<game_state> game_state::load_from_package(const std::string& path, chima::context& chima,
+                                                 std::unique_ptr<stage::input_source>&& input,
+                                                 bool headless) {
+  OKUU_PROFILE_ZONE("game::load_from_package");
+  sol::state cfg_state;
+  auto cfg = lua::package_cfg::load_config(cfg_state, path);
+  if (!cfg.has_value()) {
+    return {ntf::unexpect, std::move(cfg.error())};
+  }
+
+  ntf::optional<render::stage_renderer> renderer;
+  if (!headless) {
+    auto stage_renderer = render::stage_renderer::create(MAX_ENTITIES);
+    if (!stage_renderer.has_value()) {
+      return {ntf::unexpect, std::move(stage_renderer.error())};
+    }
+    renderer.emplace(std::move(*stage_renderer));
+  }
+
+  if (cfg->players.size() == 0) {
+    return {ntf::unexpect, "No players defined"};
+  }
+
+  if (cfg->stages.size() == 0) {
+    return {ntf::unexpect, "No stages defined"};
+  }
+
+  auto& stage = cfg->stages[0];
+  auto player_it = std::find_if(cfg->players.begin(), cfg->players.end(),
+                                [](const auto& player) { return player.name == "cirno"; });
+  if (player_it == cfg->players.end()) {
+    return {ntf::unexpect, "No baka defined"};
+  }
+  auto& player = *player_it;
+  const auto make_player = [&](assets::atlas_handle atlas_handle,
+                               const assets::sprite_atlas& atlas) -> stage::player_entity {
+    stage::player_entity::animation_data player_anims;
+    NTF_ASSERT(player_anims.size() == player.anim.size());
+    for (u32 i = 0; const auto& [name, modifier] : player.anim) {
+      auto atlas_anim = atlas.find_animation(name).value();
+      player_anims[i] = {atlas_anim, modifier};
+      ++i;
+    }
+
+    assets::sprite_animator player_animator{atlas, player_anims[0].first};
+    const vec2 initial_pos{0.f, 0.f};
+    return {atlas_handle, initial_pos, player.hitbox, std::move(player_anims),
+            std::move(player_animator)};
+  };
+
+  auto assets = std::make_unique<assets::asset_bundle>();
+  const auto put_asset = [&](const std::string& name, const lua::package_cfg::asset_elem& asset) {
+    switch (asset.type) {
+      case assets::asset_type::sprite_atlas: {
+        OKUU_PROFILE_ZONE("game::load_atlas");
+        chima::spritesheet sheet{chima, asset.path.c_str()};
+        auto atlas = assets::sprite_atlas::from_chima(sheet, !headless).value();
+        assets->emplace_asset<assets::sprite_atlas>(name, std::move(atlas));
+      } break;
+      default:
+        NTF_UNREACHABLE();
+    }
+  };
+
+  try {
+    for (const auto& [name, asset] : cfg->assets) {
+      logger::info("Loading asset \"{}\"", name);
+      put_asset(name, asset);
+    }
+    logger::info("Loading player \"{}\"", player.name);
+    const auto atlas_handle = assets->find_asset<assets::sprite_atlas>(player.sheet).value();
+    const auto& player_atlas = assets->get_asset(atlas_handle);
+
+    const stage::stage_config stage_cfg{
+      .playfield_size = stage.playfield,
+      .cull_margin = stage.cull_margin,
+      .graze_radius = stage.graze_radius,
+      .seed = stage.seed,
+      .workers = util::thread_pool::default_workers(),
+    };
+    auto scene = std::make_unique<stage::stage_scene>(
+      stage_cfg, make_player(atlas_handle, player_atlas), std::move(renderer));
+    auto lua_env = lua::stage_env::load(stage.script.c_str(), *scene, *assets).value();
+
+    return {ntf::in_place, std::move(assets), std::move(scene), std::move(lua_env),
+            std::move(input), stage.script};
+  } catch (const std::exception& ex) {
+    return {ntf::unexpect, ex.what()};
+  }
+}
+
+void game_state::tick() {
+  // Sampled before the scripts run, so they see the same input as the player
+  const stage::input_state input = _input->poll(_ticks);
+  _input_log.push_back(input);
+  _step(input);
+  ++_ticks;
+}
+
+void game_state::_step(stage::input_state input) {
+  step_stage(*_lua_env, *_scene, input);
+}
+
+stage::stage_snapshot game_state::take_snapshot() {
+  const stage::stage_snapshot* prev = _last_snapshot.empty() ? nullptr : &_last_snapshot;
+  _last_snapshot = stage::stage_snapshot::take(*_scene, _ticks, prev);
+  return _last_snapshot;
+}
+
+expect<u32> game_state::restore_snapshot(const stage::stage_snapshot& snap) {
+  OKUU_PROFILE_ZONE("game::restore_snapshot");
+  if (snap.tick() > _input_log.size()) {
+    return {ntf::unexpect, "Snapshot is ahead of the recorded input"};
+  }
+
+  if (_standby_worker) {
+    _standby_worker->wait();
+  }
+  if (_standby && _standby->env && _checkpoint <= snap.tick()) {
+    _swap_standby();
+  } else {
+    // Drop the old environment first, it takes its scene handlers with it
+    _lua_env.reset();
+    if (!_initial.restore(*_scene)) {
+      return {ntf::unexpect, "Failed to reset the stage"};
+    }
+    auto lua_env = lua::stage_env::load(_script_path, *_scene, *_assets);
+    if (!lua_env.has_value()) {
+      return {ntf::unexpect, std::move(lua_env.error())};
+    }
+    _lua_env = std::make_unique<lua::stage_env>(std::move(*lua_env));
+    _lua_env->setup_stage_modules();
+    _ticks = 0u;
+  }
+
+  {
+    OKUU_PROFILE_ZONE("game::replay");
+    for (u32 tick = _ticks; tick < snap.tick(); ++tick) {
+      _step(_input_log[tick]);
+    }
+  }
+
+  auto replayed = stage::stage_snapshot::take(*_scene, snap.tick());
+  if (!replayed.same_as(snap)) {
+    logger::warning("Replay diverged from the snapshot at tick {}", snap.tick());
+    if (!snap.restore(*_scene)) {
+      return {ntf::unexpect, "Failed to load the snapshot"};
+    }
+    replayed = snap;
+  }
+
+  _ticks = snap.tick();
+  _input_log.resize(_ticks);
+  _last_snapshot = std::move(replayed);
+  if (_standby && _checkpoint > _ticks) {
+    // The standby is ahead on a timeline that won't happen anymore
+    _checkpoint = _ticks;
+    _checkpoint_snap = _last_snapshot;
+    _rebuild_standby(nullptr);
+  }
+  return {ntf::in_place, _ticks};
+}
+
+void game_state::checkpoint() {
+  OKUU_PROFILE_ZONE("game::checkpoint");
+  const stage::stage_snapshot* prev = _checkpoint_snap.empty() ? nullptr : &_checkpoint_snap;
+  _checkpoint_snap = stage::stage_snapshot::take(*_scene, _ticks, prev);
+
+  if (!_standby) {
+    // Same config and player, the rest comes from _initial. It replays in the background, so it
+    // ticks inline instead of competing with the main scene's workers.
+    stage::stage_config standby_cfg = _scene->config();
+    standby_cfg.workers = 0u;
+    _standby = std::make_unique<standby_state>();
+    _standby->scene = std::make_unique<stage::stage_scene>(
+      standby_cfg, stage::player_entity{_scene->get_player()}, ntf::nullopt);
+    _standby_worker = std::make_unique<util::serial_worker>();
+    _checkpoint = _ticks;
+    _rebuild_standby(nullptr);
+    return;
+  }
+
+  std::vector<stage::input_state> inputs{_input_log.begin() + _checkpoint, _input_log.end()};
+  _checkpoint = _ticks;
+  _standby_worker->push([standby = _standby.get(), inputs = std::move(inputs),
+                         expected = _checkpoint_snap]() {
+    OKUU_PROFILE_ZONE("game::advance_standby");
+    if (!standby->env) {
+      return;
+    }
+    for (const auto input : inputs) {
+      step_stage(*standby->env, *standby->scene, input);
+    }
+    standby->diverged = standby_diverged(*standby->scene, expected);
+  });
+}
+
+expect<u32> game_state::restore_checkpoint() {
+  OKUU_PROFILE_ZONE("game::restore_checkpoint");
+  if (!_standby) {
+    return {ntf::unexpect, "No checkpoint taken"};
+  }
+  _standby_worker->wait();
+  if (!_standby->env) {
+    return {ntf::unexpect, "The checkpoint stage failed to load"};
+  }
+  if (_standby->diverged) {
+    // Same as restore_snapshot(), the scene is what has to match
+    logger::warning("Checkpoint stage diverged at tick {}", _checkpoint);
+    if (!_checkpoint_snap.restore(*_standby->scene)) {
+      return {ntf::unexpect, "Failed to load the checkpoint snapshot"};
+    }
+  }
+  _swap_standby();
+  _input_log.resize(_ticks);
+  return {ntf::in_place, _ticks};
+}
+
+bool game_state::checkpoint_ready() const {
+  return !_standby_worker || _standby_worker->idle();
+}
+
+// The standby takes over as is, the old stage gets recycled as the next standby. Leaves the input
+// log alone, restore_snapshot() still replays from it.
+void game_state::_swap_standby() {
+  _standby->scene->attach_renderer(_scene->release_renderer());
+  std::swap(_scene, _standby->scene);
+  auto old_env = std::exchange(_lua_env, std::move(_standby->env));
+  _ticks = _checkpoint;
+  _rebuild_standby(std::move(old_env));
+}
+
+void game_state::_rebuild_standby(std::unique_ptr<lua::stage_env> old_env) {
+  std::vector<stage::input_state> inputs{_input_log.begin(), _input_log.begin() + _checkpoint};
+  _standby_worker->push([standby = _standby.get(), assets = _assets.get(), script = _script_path,
+                         initial = _initial, old_env = std::move(old_env),
+                         inputs = std::move(inputs), expected = _checkpoint_snap]() mutable {
+    OKUU_PROFILE_ZONE("game::rebuild_standby");
+    // Before touching the scene, the old env still has its handlers registered on it
+    old_env.reset();
+    standby->env.reset();
+    standby->diverged = false;
+    if (!initial.restore(*standby->scene)) {
+      logger::error("Failed to reset the checkpoint stage");
+      return;
+    }
+    auto env = lua::stage_env::load(script, *standby->scene, *assets);
+    if (!env.has_value()) {
+      logger::error("Failed to load the checkpoint stage: {}", env.error());
+      return;
+    }
+    standby->env = std::make_unique<lua::stage_env>(std::move(*env));
+    standby->env->setup_stage_modules();
+    for (const auto input : inputs) {
+      step_stage(*standby->env, *standby->scene, input);
+    }
+    standby->diverged = standby_diverged(*standby->scene, expected);
+  });
+}
+
+void game_state::render(f64 dt, f64 alpha) {
+  _t += static_cast<f32>(dt);
+  okuu::render::render_back(_t);
+  _scene->render(dt, alpha, *_assets);
+}
+
+} // namespace okuu
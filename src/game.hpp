@@ -0,0 +1,88 @@
+#pragma once
+
+#include "./lua/stage_env.hpp"
+#include "./stage/input.hpp"
+#include "./stage/snapshot.hpp"
+#include "./util/serial_worker.hpp"
+
+namespace okuu {
+
+class game_state {
+public:
+  game_state(std::unique_ptr<assets::asset_bundle>&& assets,
+             std::unique_ptr<stage::stage_scene>&& scene, lua::stage_env&& lua_env,
+             std::unique_ptr<stage::input_source>&& input, std::string script_path);
+
+public:
+  // Headless states skip every GL resource, they can tick without a window but not render
+  static expect<game_state> load_from_package(const std::string& path, chima::context& chima,
+                                              std::unique_ptr<stage::input_source>&& input,
+                                              bool headless = false);
+
+public:
+  void tick();
+  void render(f64 dt, f64 alpha);
+
+  // Deltas against the last snapshot taken or restored
+  stage::stage_snapshot take_snapshot();
+
+  // Lua coroutines can't be serialized, so the stage script gets replayed with the recorded input
+  // up to the snapshot tick. Snapshots at or after the checkpoint only replay from there, older
+  // ones go back to tick 0. The snapshot is only loaded over the replay if they diverged. Returns
+  // the tick the game is at afterwards.
+  expect<u32> restore_snapshot(const stage::stage_snapshot& snap);
+
+  // Practice checkpoints. A headless standby copy of the stage, Lua included, follows the game
+  // one checkpoint behind on a background thread. It only gets built on the first checkpoint, so
+  // games that never take one don't pay for it. Taking a checkpoint copies the input since the
+  // last one and snapshots the scene, restoring swaps the standby in.
+  void checkpoint();
+
+  // Blocks until the standby catches up if it's still replaying, see checkpoint_ready(). If the
+  // standby ended up somewhere else than the checkpoint snapshot, the snapshot gets loaded over it.
+  expect<u32> restore_checkpoint();
+
+  // False while the standby replays, right after a restore it has to start over from tick 0
+  bool checkpoint_ready() const;
+
+  u32 checkpoint_tick() const { return _checkpoint; }
+
+public:
+  u32 ticks() const { return _ticks; }
+
+  stage::stage_scene& scene() { return *_scene; }
+
+  stage::input_source& input() { return *_input; }
+
+private:
+  struct standby_state {
+    std::unique_ptr<stage::stage_scene> scene;
+    std::unique_ptr<lua::stage_env> env; // Null if the script failed to load
+    bool diverged{false};                // Doesn't match the checkpoint snapshot
+  };
+
+private:
+  void _step(stage::input_state input);
+  void _swap_standby();
+  void _rebuild_standby(std::unique_ptr<lua::stage_env> old_env);
+
+private:
+  std::unique_ptr<assets::asset_bundle> _assets;
+  std::unique_ptr<stage::stage_scene> _scene;
+  std::unique_ptr<lua::stage_env> _lua_env; // Recreated on restore
+  std::unique_ptr<stage::input_source> _input;
+  std::string _script_path;
+  std::vector<stage::input_state> _input_log; // One entry per tick, for replays
+  stage::stage_snapshot _initial;
+  stage::stage_snapshot _last_snapshot;
+  stage::stage_snapshot _checkpoint_snap; // Main scene at the checkpoint tick
+  std::unique_ptr<standby_state> _standby; // Null until the first checkpoint
+  u32 _checkpoint;                         // Tick the standby is at once its jobs are done
+  u32 _ticks;
+  f32 _t;
+  // Last, finishes the standby jobs before anything they use goes away. Jobs run one after
+  // another, so only the running one touches the standby.
+  std::unique_ptr<util::serial_worker> _standby_worker;
+};
+
+} // namespace okuu
@@ -34,7 +34,9 @@ namespace {
 fn prep_usertypes(sol::table& module) {
   // clang-format off
   module.new_usertype<lua_sprite>(
-    "sprite", sol::no_constructor
+    "sprite", sol::no_constructor,
+    // Index in its atlas, for stage:spawn_batch()
+    "get_id", [](const lua_sprite& spr) -> u32 { return static_cast<u32>(spr.get().second); }
   );
   module.new_usertype<lua_sprite_atlas>(
     "spritesheet", sol::no_constructor,
@@ -25,6 +25,8 @@ public:
 public:
   sol::variadic_results get_sprite(sol::this_state ts, std::string name) const;
 
+  assets::atlas_handle get() const { return _atlas; }
+
 private:
   assets::atlas_handle _atlas;
 };
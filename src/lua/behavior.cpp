@@ -0,0 +1,79 @@
+#include "./behavior.hpp"
+#include "./stage.hpp"
+
+#include "../util/profiler.hpp"
+
+namespace okuu::lua {
+
+lua_thread_pool::lua_thread_pool(sol::state_view lua) : _lua{lua}, _threads{} {}
+
+sol::thread lua_thread_pool::acquire() {
+  if (_threads.empty()) {
+    return sol::thread::create(_lua);
+  }
+  sol::thread thread = std::move(_threads.back());
+  _threads.pop_back();
+  return thread;
+}
+
+void lua_thread_pool::release(sol::thread&& thread) {
+  if (thread.status() != sol::thread_status::ok) {
+    return;
+  }
+  _threads.emplace_back(std::move(thread));
+}
+
+behavior_scheduler::behavior_scheduler(sol::state_view lua, stage::projectile_pool& projs) :
+    _projs{projs}, _threads{lua}, _heap{}, _tick{0u}, _seq{0u} {}
+
+void behavior_scheduler::add(u64 handle, sol::protected_function func) {
+  sol::thread thread = _threads.acquire();
+  sol::coroutine coro{thread.state(), func};
+  _push({_tick + 1u, 0u, handle, std::move(thread), std::move(coro)});
+}
+
+void behavior_scheduler::run() {
+  OKUU_PROFILE_ZONE("lua::run_behaviors");
+  ++_tick;
+  // Behaviors resumed here can spawn new ones, those are scheduled for the next tick at least
+  while (!_heap.empty() && _heap.front().wake <= _tick) {
+    std::pop_heap(_heap.begin(), _heap.end(), later_wake{});
+    behavior beh = std::move(_heap.back());
+    _heap.pop_back();
+
+    if (!_projs->is_alive(beh.handle)) {
+      _finish(std::move(beh));
+      continue;
+    }
+
+    u32 sleep = 0u;
+    {
+      auto res = beh.coro(lua_projectile{beh.handle});
+      if (!res.valid()) {
+        sol::error err = res;
+        logger::error("Error on projectile behavior: {}", err.what());
+      } else if (res.status() == sol::call_status::yielded) {
+        sleep = std::max(res.get<sol::optional<u32>>().value_or(1u), 1u);
+      }
+    }
+    if (sleep == 0u) {
+      _finish(std::move(beh));
+      continue;
+    }
+    beh.wake = _tick + sleep;
+    _push(std::move(beh));
+  }
+}
+
+void behavior_scheduler::_push(behavior&& beh) {
+  beh.seq = _seq++;
+  _heap.emplace_back(std::move(beh));
+  std::push_heap(_heap.begin(), _heap.end(), later_wake{});
+}
+
+void behavior_scheduler::_finish(behavior&& beh) {
+  beh.coro = sol::coroutine{};
+  _threads.release(std::move(beh.thread));
+}
+
+} // namespace okuu::lua
@@ -0,0 +1,69 @@
+#pragma once
+
+#define OKUU_SOL_IMPL
+#include "./sol.hpp"
+
+#include "../stage/projectile.hpp"
+
+namespace okuu::lua {
+
+// Recycles lua threads from coroutines that returned normally. LuaJIT can't reset a suspended or
+// errored thread, those are just dropped and left to the GC.
+class lua_thread_pool {
+public:
+  explicit lua_thread_pool(sol::state_view lua);
+
+public:
+  sol::thread acquire();
+  void release(sol::thread&& thread);
+
+  u32 size() const { return static_cast<u32>(_threads.size()); }
+
+private:
+  sol::state_view _lua;
+  std::vector<sol::thread> _threads;
+};
+
+// Per projectile Lua behaviors. A behavior receives its projectile handle and sleeps with
+// coroutine.yield(ticks), only the ones due in the current tick get resumed. Behaviors of dead
+// projectiles are dropped when they wake up.
+class behavior_scheduler {
+private:
+  struct behavior {
+    u32 wake;
+    u32 seq; // Keeps resume order stable between behaviors waking in the same tick
+    u64 handle;
+    sol::thread thread;
+    sol::coroutine coro;
+  };
+
+  struct later_wake {
+    bool operator()(const behavior& a, const behavior& b) const {
+      return a.wake != b.wake ? a.wake > b.wake : a.seq > b.seq;
+    }
+  };
+
+public:
+  behavior_scheduler(sol::state_view lua, stage::projectile_pool& projs);
+
+public:
+  // First resumed in the next call to run()
+  void add(u64 handle, sol::protected_function func);
+
+  // Advances one tick and resumes every behavior due
+  void run();
+
+  u32 size() const { return static_cast<u32>(_heap.size()); }
+
+private:
+  void _push(behavior&& beh);
+  void _finish(behavior&& beh);
+
+private:
+  ntf::weak_ptr<stage::projectile_pool> _projs;
+  lua_thread_pool _threads;
+  std::vector<behavior> _heap;
+  u32 _tick, _seq;
+};
+
+} // namespace okuu::lua
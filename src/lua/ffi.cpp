@@ -0,0 +1,195 @@
+#include "./ffi.hpp"
+
+#include <cstring>
+
+namespace okuu::lua {
+
+namespace {
+
+// Keep in sync with ffi_proj_spawn, ffi_movement and ffi_proj_view
+constexpr std::string_view FFI_PRELUDE = R"(
+local raw, stage_module = ...
+local ok, ffi = pcall(require, "ffi")
+if (not ok) then
+  return nil
+end
+
+ffi.cdef[[
+typedef struct okuu_proj_spawn {
+  float pos_x, pos_y;
+  float vel_x, vel_y;
+  float end_vel_x, end_vel_y;
+  float ret;
+  float scale_x, scale_y;
+  float angular_speed;
+  float hitbox;
+  uint32_t sprite;
+  uint32_t movement;
+} okuu_proj_spawn;
+
+typedef struct okuu_proj_view {
+  const float* pos_x;
+  const float* pos_y;
+  const float* vel_x;
+  const float* vel_y;
+  uint32_t count;
+  uint32_t tick;
+  uint32_t generation;
+} okuu_proj_view;
+
+enum {
+  OKUU_MOVE_LINEAR = 0,
+  OKUU_MOVE_INTERPOLATED = 1,
+  OKUU_MOVE_ANALYTIC = 2,
+};
+]]
+
+local buffer_t = ffi.typeof("okuu_proj_spawn[?]")
+local ptr_t = ffi.typeof("const okuu_proj_spawn*")
+local view_t = ffi.typeof("okuu_proj_view")
+local view_ptr_t = ffi.typeof("const okuu_proj_view*")
+local view_size = ffi.sizeof("okuu_proj_view")
+local spawn_size = ffi.sizeof("okuu_proj_spawn")
+local raw_spawn, raw_view = raw.spawn_batch, raw.proj_view
+
+-- Zero initialized, so unset fields mean linear movement and the default hitbox
+stage_module.spawn_buffer = function(count)
+  return buffer_t(count)
+end
+
+local methods = {}
+
+-- Arrays and pointers both end up as a pointer cdata, the C++ side only reads those. Arrays know
+-- their size so the count gets clamped to it, pointers need an explicit count.
+methods.spawn_batch = function(stage, buf, count, atlas)
+  if (tostring(ffi.typeof(buf)):find("%[")) then
+    local cap = ffi.sizeof(buf) / spawn_size
+    if (count == nil or count > cap) then
+      count = cap
+    end
+  elseif (count == nil) then
+    error("spawn_batch needs a count when given a pointer", 2)
+  end
+  if (count < 0) then
+    count = 0
+  end
+  return raw_spawn(stage, ffi.cast(ptr_t, buf), count, atlas)
+end
+
+-- The C++ side keeps a single struct for the whole tick, copy it so older views keep their own
+-- count and generation
+methods.get_proj_view = function(stage)
+  local view = view_t()
+  ffi.copy(view, raw_view(stage), view_size)
+  return view
+end
+
+-- False once the view is from an older tick, its arrays got replaced by a newer copy
+methods.proj_view_valid = function(stage, view)
+  return ffi.cast(view_ptr_t, raw_view(stage)).generation == view.generation
+end
+
+return methods
+)";
+
+constexpr std::string_view FFI_RNG_PRELUDE = R"(
+local raw = ...
+local ok, ffi = pcall(require, "ffi")
+if (not ok) then
+  return nil
+end
+
+local buffer_t = ffi.typeof("float[?]")
+local ptr_t = ffi.typeof("float*")
+local float_size = ffi.sizeof("float")
+local raw_uniform, raw_normal = raw.fill_uniform, raw.fill_normal
+
+local methods = {}
+
+-- Static, rng.buffer(n)
+methods.buffer = function(count)
+  return buffer_t(count)
+end
+
+-- Same rules as spawn_batch, arrays clamp the count to their size and pointers need one
+local function fill_args(buf, count)
+  if (tostring(ffi.typeof(buf)):find("%[")) then
+    local cap = ffi.sizeof(buf) / float_size
+    if (count == nil or count > cap) then
+      count = cap
+    end
+  elseif (count == nil) then
+    error("rng fills need a count when given a pointer", 3)
+  end
+  if (count < 0) then
+    count = 0
+  end
+  return ffi.cast(ptr_t, buf), count
+end
+
+methods.fill_uniform = function(rng, buf, count)
+  local ptr, n = fill_args(buf, count)
+  raw_uniform(rng, ptr, n)
+  return buf
+end
+
+methods.fill_normal = function(rng, buf, count)
+  local ptr, n = fill_args(buf, count)
+  raw_normal(rng, ptr, n)
+  return buf
+end
+
+return methods
+)";
+
+sol::object run_prelude(sol::state_view lua, std::string_view source, auto&&... args) {
+  auto prelude = lua.load(source);
+  if (!prelude.valid()) {
+    sol::error err = prelude;
+    logger::error("Failed to load FFI prelude: {}", err.what());
+    return sol::make_object(lua, sol::nil);
+  }
+  sol::protected_function prelude_func = prelude;
+  auto res = prelude_func(args...);
+  if (!res.valid()) {
+    sol::error err = res;
+    logger::error("Failed to setup FFI types: {}", err.what());
+    return sol::make_object(lua, sol::nil);
+  }
+  sol::object methods = res;
+  return methods;
+}
+
+} // namespace
+
+const void* ffi_cdata_ptr(lua_State* L, int index) {
+  if (lua_type(L, index) != LUAJIT_TCDATA) {
+    return nullptr;
+  }
+  // lua_topointer gives the cdata payload, which for a pointer cdata is the pointer itself
+  const void* payload = lua_topointer(L, index);
+  if (!payload) {
+    return nullptr;
+  }
+  const void* ptr;
+  std::memcpy(&ptr, payload, sizeof(ptr));
+  return ptr;
+}
+
+sol::object setup_ffi_methods(sol::state_view lua, sol::table& stage_module, sol::table raw) {
+  sol::object methods = run_prelude(lua, FFI_PRELUDE, raw, stage_module);
+  if (methods.get_type() != sol::type::table) {
+    logger::warning("LuaJIT FFI not available, FFI stage methods disabled");
+  }
+  return methods;
+}
+
+sol::object setup_ffi_rng_methods(sol::state_view lua, sol::table raw) {
+  sol::object methods = run_prelude(lua, FFI_RNG_PRELUDE, raw);
+  if (methods.get_type() != sol::type::table) {
+    logger::warning("LuaJIT FFI not available, rng bulk fills disabled");
+  }
+  return methods;
+}
+
+} // namespace okuu::lua
@@ -0,0 +1,67 @@
+#pragma once
+
+#define OKUU_SOL_IMPL
+#include "./sol.hpp"
+
+#include "../core.hpp"
+
+namespace okuu::lua {
+
+// Movement for each ffi_proj_spawn entry, OKUU_MOVE_* on the Lua side
+enum class ffi_movement : u32 {
+  linear = 0,   // vel only
+  interpolated, // From vel to end_vel, like movement.move_interpolated
+  analytic,     // Same as interpolated, evaluated in closed form
+
+  count,
+};
+
+constexpr u32 FFI_MOVEMENT_COUNT = static_cast<u32>(ffi_movement::count);
+
+// Plain struct read straight from LuaJIT cdata, has to match okuu_proj_spawn in the cdef
+// (see ffi.cpp). Scripts fill an array of these and submit it with stage:spawn_batch().
+struct ffi_proj_spawn {
+  f32 pos_x, pos_y;
+  f32 vel_x, vel_y;
+  f32 end_vel_x, end_vel_y;
+  f32 ret;
+  f32 scale_x, scale_y;
+  f32 angular_speed;
+  f32 hitbox; // <= 0 picks the default from the scale, like spawn_proj
+  u32 sprite; // From sprite:get_id(), indexes the atlas passed to spawn_batch
+  u32 movement;
+};
+
+static_assert(std::is_standard_layout_v<ffi_proj_spawn>);
+static_assert(sizeof(ffi_proj_spawn) == 13u * sizeof(u32));
+
+// Read only view over the projectile pool, okuu_proj_view on the Lua side. The arrays are a copy of
+// the pool taken on the first request of the tick, indexed like the pool was at that point. They
+// stay valid until the next tick no matter what gets spawned or killed, `generation` counts the
+// copies so scripts can tell with stage:proj_view_valid(view). Each stage:get_proj_view() returns
+// its own struct. Analytic entries report the velocity from their last movement change.
+struct ffi_proj_view {
+  const f32* pos_x;
+  const f32* pos_y;
+  const f32* vel_x;
+  const f32* vel_y;
+  u32 count;
+  u32 tick;
+  u32 generation;
+};
+
+// LuaJIT reports cdata as its own type, lua.h doesn't name it
+constexpr int LUAJIT_TCDATA = 10;
+
+// Reads the address held by a pointer cdata, null if the value isn't cdata
+const void* ffi_cdata_ptr(lua_State* L, int index);
+
+// Declares the FFI types and returns a table of stage methods wrapping the raw functions, so
+// cdata gets cast to the right type on the Lua side. raw needs `spawn_batch` and `proj_view`.
+// Returns nil if the state wasn't opened with the ffi lib.
+sol::object setup_ffi_methods(sol::state_view lua, sol::table& stage_module, sol::table raw);
+
+// Same for okuu.math.rng, raw needs `fill_uniform` and `fill_normal`
+sol::object setup_ffi_rng_methods(sol::state_view lua, sol::table raw);
+
+} // namespace okuu::lua
@@ -0,0 +1,42 @@
+#include "./handle.hpp"
+
+namespace okuu::lua {
+
+namespace {
+
+// __index(handle, key), upvalue 1 is the array of method tables indexed by tag
+int handle_index(lua_State* L) {
+  const auto tag = unpack_tag(lua_touserdata(L, 1));
+  if (tag == handle_tag::none) {
+    lua_pushnil(L);
+    return 1;
+  }
+  lua_rawgeti(L, lua_upvalueindex(1), static_cast<int>(tag));
+  lua_pushvalue(L, 2);
+  lua_rawget(L, -2);
+  return 1;
+}
+
+} // namespace
+
+void setup_handle_metatable(sol::state_view lua,
+                            const std::array<sol::table, HANDLE_TAG_COUNT>& methods) {
+  lua_State* L = lua.lua_state();
+
+  lua_createtable(L, static_cast<int>(HANDLE_TAG_COUNT), 0);
+  for (u32 i = 1; i < HANDLE_TAG_COUNT; ++i) {
+    methods[i].push(L);
+    lua_rawseti(L, -2, static_cast<int>(i));
+  }
+
+  // Light userdata have a single metatable per state, set it through any of them
+  lua_pushlightuserdata(L, nullptr);
+  lua_createtable(L, 0, 1);
+  lua_pushvalue(L, -3);
+  lua_pushcclosure(L, &handle_index, 1);
+  lua_setfield(L, -2, "__index");
+  lua_setmetatable(L, -2);
+  lua_pop(L, 2);
+}
+
+} // namespace okuu::lua
@@ -0,0 +1,95 @@
+#pragma once
+
+#define OKUU_SOL_IMPL
+#include "./sol.hpp"
+
+#include "../stage/handle_table.hpp"
+
+namespace okuu::lua {
+
+// Entity references are pushed to Lua as tagged light userdata instead of full usertypes, so
+// spawning doesn't allocate on the Lua heap and handles compare by value. All light userdata share
+// a single metatable, its __index picks the method table using the tag.
+enum class handle_tag : u8 {
+  none = 0,
+  projectile,
+  sprite,
+  task,
+  emitter,
+  laser,
+  enemy,
+
+  count,
+};
+
+constexpr u32 HANDLE_TAG_COUNT = static_cast<u32>(handle_tag::count);
+
+// [tag:3][gen:16][slot:20], 39 bits is the range LuaJIT stores without interning the pointer.
+// Only the low bits of the generation fit, so a handle kept in Lua can look alive again after 64k
+// reuses of its slot. Unpacking gives a short handle, the tables compare it against the same bits.
+constexpr u32 HANDLE_TAG_BITS = 3u;
+constexpr u32 HANDLE_GEN_SHIFT = stage::handle_table::SLOT_BITS;
+constexpr u32 HANDLE_TAG_SHIFT = HANDLE_GEN_SHIFT + stage::handle_table::SHORT_GEN_BITS;
+static_assert(HANDLE_TAG_SHIFT + HANDLE_TAG_BITS <= 39u);
+static_assert(HANDLE_TAG_COUNT <= (1u << HANDLE_TAG_BITS));
+
+inline void* pack_handle(handle_tag tag, u64 handle) {
+  using table = stage::handle_table;
+  const u64 bits = (static_cast<u64>(tag) << HANDLE_TAG_SHIFT) |
+                   (static_cast<u64>(table::handle_gen(handle) & table::SHORT_GEN_MASK)
+                    << HANDLE_GEN_SHIFT) |
+                   static_cast<u64>(table::handle_slot(handle));
+  return reinterpret_cast<void*>(static_cast<uintptr_t>(bits));
+}
+
+inline handle_tag unpack_tag(const void* ptr) {
+  const u64 bits = static_cast<u64>(reinterpret_cast<uintptr_t>(ptr));
+  const u64 tag = bits >> HANDLE_TAG_SHIFT;
+  return tag < HANDLE_TAG_COUNT ? static_cast<handle_tag>(tag) : handle_tag::none;
+}
+
+inline u64 unpack_handle(const void* ptr) {
+  using table = stage::handle_table;
+  const u64 bits = static_cast<u64>(reinterpret_cast<uintptr_t>(ptr));
+  const u32 slot = static_cast<u32>(bits) & table::SLOT_MASK;
+  const u32 gen = static_cast<u32>(bits >> HANDLE_GEN_SHIFT) & table::SHORT_GEN_MASK;
+  return table::make_short_handle(slot, gen);
+}
+
+template<typename T>
+concept lua_handle_type = requires(const T ent) {
+  { T::HANDLE_TAG } -> std::convertible_to<handle_tag>;
+  { ent.get_handle() } -> std::same_as<u64>;
+};
+
+// Installs the shared light userdata metatable, methods[tag] is the method table for each tag
+void setup_handle_metatable(sol::state_view lua,
+                            const std::array<sol::table, HANDLE_TAG_COUNT>& methods);
+
+// sol2 customization points, found through ADL
+
+template<lua_handle_type T, typename Handler>
+bool sol_lua_check(sol::types<T>, lua_State* L, int index, Handler&& handler,
+                   sol::stack::record& tracking) {
+  tracking.use(1);
+  if (lua_type(L, index) != LUA_TLIGHTUSERDATA ||
+      unpack_tag(lua_touserdata(L, index)) != T::HANDLE_TAG) {
+    handler(L, index, sol::type::lightuserdata, sol::type_of(L, index), "not an entity handle");
+    return false;
+  }
+  return true;
+}
+
+template<lua_handle_type T>
+T sol_lua_get(sol::types<T>, lua_State* L, int index, sol::stack::record& tracking) {
+  tracking.use(1);
+  return T{unpack_handle(lua_touserdata(L, index))};
+}
+
+template<lua_handle_type T>
+int sol_lua_push(sol::types<T>, lua_State* L, const T& ent) {
+  lua_pushlightuserdata(L, pack_handle(T::HANDLE_TAG, ent.get_handle()));
+  return 1;
+}
+
+} // namespace okuu::lua
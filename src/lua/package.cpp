@@ -11,6 +11,11 @@ static constexpr f32 DEF_VEL_FAC = 1.f;
 static constexpr f32 DEF_ACC_FAC = 1.f;
 static constexpr f32 DEF_FOCUS_FAC = .8f;
 static constexpr f32 DEF_HITBOX_FAC = 4.f;
+static constexpr f32 DEF_PLAYFIELD_WIDTH = 600.f;
+static constexpr f32 DEF_PLAYFIELD_HEIGHT = 700.f;
+static constexpr f32 DEF_CULL_MARGIN = 0.f;
+static constexpr f32 DEF_GRAZE_RADIUS = 24.f;
+static constexpr u64 DEF_STAGE_SEED = 0u;
 
 fn make_setup_stages(std::vector<package_cfg::stage_entry>& stages, const std::string& dir) {
   return [&](sol::this_state, sol::table args) {
@@ -21,7 +26,16 @@ fn make_setup_stages(std::vector<package_cfg::stage_entry>& stages, const std::s
 
         std::string path = fmt::format("{}/{}", dir, stage_tbl.get<std::string>("path"));
         std::string name = stage_tbl.get<std::string>("name");
-        stages.emplace_back(std::move(name), std::move(path));
+        vec2 playfield{DEF_PLAYFIELD_WIDTH, DEF_PLAYFIELD_HEIGHT};
+        if (auto field = stage_tbl.get<sol::optional<sol::table>>("playfield")) {
+          playfield.x = field->get_or("width", DEF_PLAYFIELD_WIDTH);
+          playfield.y = field->get_or("height", DEF_PLAYFIELD_HEIGHT);
+        }
+        const f32 cull_margin = stage_tbl.get_or("cull_margin", DEF_CULL_MARGIN);
+        const f32 graze_radius = stage_tbl.get_or("graze_radius", DEF_GRAZE_RADIUS);
+        const u64 seed = stage_tbl.get_or("seed", DEF_STAGE_SEED);
+        stages.emplace_back(std::move(name), std::move(path), playfield, cull_margin,
+                            graze_radius, seed);
       });
     } catch (const sol::error& err) {
       logger::error("Malformed stage setup on lua script: {}", err.what());
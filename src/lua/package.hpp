@@ -12,6 +12,10 @@ public:
   struct stage_entry {
     std::string name;
     stdfs::path script;
+    vec2 playfield;
+    f32 cull_margin;
+    f32 graze_radius;
+    u64 seed; // Fixed per stage for now, so recordings replay without storing it
   };
 
   enum player_anim_entry {
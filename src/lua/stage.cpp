@@ -1,7 +1,10 @@
 #include "./stage.hpp"
 #include "./assets.hpp"
+#include "./ffi.hpp"
 #include "./stage_env.hpp"
 
+#include <numbers>
+
 namespace okuu::lua {
 
 lua_player::lua_player() {}
@@ -22,43 +25,8 @@ void lua_boss::kill(sol::this_state ts) const {
   scene.kill_boss(_boss_slot);
 }
 
-lua_projectile::lua_projectile(u64 handle) : _handle{handle} {}
-
-u32 lua_projectile::get_handle() const {
-  return _handle;
-}
-
-bool lua_projectile::is_alive(sol::this_state ts) const {
-  auto& scene = lua_stage::instance(ts)->scene();
-  return scene.get_projectiles().is_alive(_handle);
-}
-
-void lua_projectile::kill(sol::this_state ts) const {
-  auto& scene = lua_stage::instance(ts)->scene();
-  scene.get_projectiles().kill(_handle);
-}
-
-void lua_projectile::set_pos(sol::this_state ts, f32 x, f32 y) {
-  auto& scene = lua_stage::instance(ts)->scene();
-  scene.get_projectiles().at(_handle).pos(x, y);
-}
-
-vec2 lua_projectile::get_pos(sol::this_state ts) {
-  auto& scene = lua_stage::instance(ts)->scene();
-  return scene.get_projectiles().at(_handle).pos();
-}
-
-void lua_projectile::set_movement(sol::this_state ts, stage::entity_movement movement) {
-  auto& scene = lua_stage::instance(ts)->scene();
-  scene.get_projectiles().at(_handle).movement(movement);
-}
-
 lua_stage::lua_stage(stage_env& env) : _env{env} {}
 
-void lua_stage::on_yield(u32 ticks) {
-  _env->scene().task_wait(ticks);
-}
-
 sol::variadic_results lua_stage::get_boss(sol::this_state ts, u32 slot) {
   sol::variadic_results res;
   if (slot >= stage::stage_scene::MAX_BOSSES) {
@@ -78,6 +46,16 @@ sol::variadic_results lua_stage::get_boss(sol::this_state ts, u32 slot) {
 
 namespace {
 
+static constexpr f32 DEF_PROJ_HITBOX_FAC = .2f;
+static constexpr const char* ORBIT_PARENT_ERR = "Orbit parents only work on projectiles";
+
+// Parents are enemy projectile handles and only the projectile pool resolves them, anything else
+// would silently orbit around (0, 0)
+bool has_orbit_parent(const sol::optional<stage::entity_movement>& mov) {
+  return mov.has_value() && mov->kind() == stage::movement_kind::orbit &&
+         mov->params().orbit.parent != stage::orbit_params::NO_PARENT;
+}
+
 auto parse_vec2(sol::table& args, const char* name) -> ntf::optional<vec2> {
   auto lua_vec = args[name].get<sol::optional<sol::table>>();
   if (!lua_vec.has_value()) {
@@ -94,6 +72,42 @@ auto parse_vec2(sol::table& args, const char* name) -> ntf::optional<vec2> {
   return {ntf::in_place, *pos_x, *pos_y};
 }
 
+// Everything but the position and velocity
+auto parse_proj_base(sol::table& args, vec2 pos, vec2 vel) -> expect<stage::projectile_args> {
+  auto scale = parse_vec2(args, "scale");
+
+  auto sprite_arg = args["sprite"].get<sol::optional<lua_sprite>>();
+  if (!sprite_arg.has_value()) {
+    return {ntf::unexpect, "No sprite"};
+  }
+  auto [atlas, sprite] = sprite_arg->get();
+
+  const real ang_speed = args["angular_speed"].get_or(0.f);
+  const auto movement = args["movement"].get<sol::optional<stage::entity_movement>>();
+  const bool analytic = args["analytic"].get_or(false);
+  const real damage = args["damage"].get_or(1.f);
+
+  const vec2 proj_scale = scale.value_or(vec2{10.f, 10.f});
+  const real def_hitbox =
+    DEF_PROJ_HITBOX_FAC * std::min(std::abs(proj_scale.x), std::abs(proj_scale.y));
+  const real hitbox = args["hitbox"].get_or(def_hitbox);
+  // Enough for the sprite to be fully off screen before culling it
+  const real def_margin = std::max(std::abs(proj_scale.x), std::abs(proj_scale.y));
+  const real cull_margin = args["cull_margin"].get_or(def_margin);
+
+  return {ntf::in_place,
+          pos,
+          vel,
+          proj_scale,
+          ang_speed,
+          hitbox,
+          cull_margin,
+          std::make_tuple(atlas, sprite, vec2{1.f, 1.f}),
+          movement.value_or(stage::entity_movement{}),
+          analytic,
+          damage};
+}
+
 auto parse_proj_args(sol::table& args) -> expect<stage::projectile_args> {
   auto pos = parse_vec2(args, "pos");
   if (!pos.has_value()) {
@@ -104,7 +118,56 @@ auto parse_proj_args(sol::table& args) -> expect<stage::projectile_args> {
   if (!vel.has_value()) {
     return {ntf::unexpect, "No velocity"};
   }
-  auto scale = parse_vec2(args, "scale");
+  return parse_proj_base(args, *pos, *vel);
+}
+
+auto parse_emitter_args(sol::table& args, stage::emitter_shape shape,
+                        vec2 player_pos) -> expect<stage::emitter_args> {
+  auto pos = parse_vec2(args, "pos");
+  if (!pos.has_value()) {
+    return {ntf::unexpect, "No position"};
+  }
+  auto proj = parse_proj_base(args, *pos, vec2{0.f, 0.f});
+  if (!proj.has_value()) {
+    return {ntf::unexpect, std::move(proj.error())};
+  }
+
+  const real speed = args["speed"].get_or(1.f);
+  return {ntf::in_place,
+          shape,
+          *proj,
+          args["count"].get_or(1u),
+          args["layers"].get_or(1u),
+          args["angle"].get_or(0.f),
+          args["spread"].get_or(0.f),
+          speed,
+          args["speed_step"].get_or(0.f),
+          args["end_speed"].get_or(speed),
+          args["ret"].get_or(1.f),
+          parse_vec2(args, "target").value_or(player_pos),
+          args["angle_jitter"].get_or(0.f),
+          args["speed_jitter"].get_or(0.f)};
+}
+
+auto parse_emitter_shape(sol::table& args) -> expect<stage::emitter_shape> {
+  const auto shape = args["shape"].get<sol::optional<std::string_view>>();
+  if (!shape.has_value() || *shape == "ring") {
+    return {ntf::in_place, stage::emitter_shape::ring};
+  }
+  if (*shape == "spread") {
+    return {ntf::in_place, stage::emitter_shape::spread};
+  }
+  if (*shape == "aimed") {
+    return {ntf::in_place, stage::emitter_shape::aimed};
+  }
+  return {ntf::unexpect, fmt::format("Invalid emitter shape \"{}\"", *shape)};
+}
+
+auto parse_laser_args(sol::table& args) -> expect<stage::laser_args> {
+  auto pos = parse_vec2(args, "pos");
+  if (!pos.has_value()) {
+    return {ntf::unexpect, "No position"};
+  }
 
   auto sprite_arg = args["sprite"].get<sol::optional<lua_sprite>>();
   if (!sprite_arg.has_value()) {
@@ -112,40 +175,103 @@ auto parse_proj_args(sol::table& args) -> expect<stage::projectile_args> {
   }
   auto [atlas, sprite] = sprite_arg->get();
 
-  const real ang_speed = args["angular_speed"].get_or(0.f);
+  stage::laser_kind kind = stage::laser_kind::straight;
+  const auto kind_arg = args["kind"].get<sol::optional<std::string_view>>();
+  if (kind_arg.has_value()) {
+    if (*kind_arg == "curvy") {
+      kind = stage::laser_kind::curvy;
+    } else if (*kind_arg != "straight") {
+      return {ntf::unexpect, fmt::format("Invalid laser kind \"{}\"", *kind_arg)};
+    }
+  }
+
   const auto movement = args["movement"].get<sol::optional<stage::entity_movement>>();
+  if (has_orbit_parent(movement)) {
+    return {ntf::unexpect, ORBIT_PARENT_ERR};
+  }
+  return {ntf::in_place,
+          kind,
+          *pos,
+          args["angle"].get_or(0.f),
+          args["angular_speed"].get_or(0.f),
+          args["length"].get_or(100.f),
+          args["width"].get_or(10.f),
+          args["warning"].get_or(0u),
+          args["duration"].get_or(0u),
+          args["trail"].get_or(32u),
+          movement.value_or(stage::entity_movement{}),
+          std::make_tuple(atlas, sprite, vec2{1.f, 1.f})};
+}
 
-  auto lua_state_handler = args["state_handler"].get<sol::optional<sol::protected_function>>();
-  ntf::optional<sol::coroutine> state_handler;
-  if (lua_state_handler.has_value()) {
-    state_handler.emplace(std::move(*lua_state_handler));
+auto parse_enemy_args(sol::table& args) -> expect<stage::enemy_args> {
+  auto pos = parse_vec2(args, "pos");
+  if (!pos.has_value()) {
+    return {ntf::unexpect, "No position"};
+  }
+
+  auto sprite_arg = args["sprite"].get<sol::optional<lua_sprite>>();
+  if (!sprite_arg.has_value()) {
+    return {ntf::unexpect, "No sprite"};
   }
+  auto [atlas, sprite] = sprite_arg->get();
 
+  const vec2 scale = parse_vec2(args, "scale").value_or(vec2{20.f, 20.f});
+  const real def_hitbox = .5f * std::min(std::abs(scale.x), std::abs(scale.y));
+  const auto movement = args["movement"].get<sol::optional<stage::entity_movement>>();
+  if (has_orbit_parent(movement)) {
+    return {ntf::unexpect, ORBIT_PARENT_ERR};
+  }
   return {ntf::in_place,
           *pos,
-          *vel,
-          scale.value_or(vec2{10.f, 10.f}),
-          ang_speed,
+          scale,
+          args["hp"].get_or(1.f),
+          args["hitbox"].get_or(def_hitbox),
           std::make_tuple(atlas, sprite, vec2{1.f, 1.f}),
-          movement.value_or(stage::entity_movement{}),
-          std::move(state_handler)};
+          movement.value_or(stage::entity_movement{})};
 }
 
-} // namespace
+// `kind` is one of "point" (default), "power", "life" or "bomb"
+auto parse_item_args(sol::table& args, vec2 pos) -> expect<stage::item_args> {
+  auto sprite_arg = args["sprite"].get<sol::optional<lua_sprite>>();
+  if (!sprite_arg.has_value()) {
+    return {ntf::unexpect, "No sprite"};
+  }
+  auto [atlas, sprite] = sprite_arg->get();
 
-sol::variadic_results lua_stage::spawn_proj(sol::this_state ts, sol::table args) {
-  sol::variadic_results res;
+  static constexpr std::array<std::string_view, stage::ITEM_KIND_COUNT> kind_names{
+    "point", "power", "life", "bomb"};
+  stage::item_kind kind = stage::item_kind::point;
+  if (auto kind_arg = args["kind"].get<sol::optional<std::string_view>>()) {
+    const auto it = std::find(kind_names.begin(), kind_names.end(), *kind_arg);
+    if (it == kind_names.end()) {
+      return {ntf::unexpect, fmt::format("Invalid item kind \"{}\"", *kind_arg)};
+    }
+    kind = static_cast<stage::item_kind>(it - kind_names.begin());
+  }
 
-  auto proj = parse_proj_args(args).transform([&](stage::projectile_args&& args) {
-    auto& scene = lua_stage::instance(ts)->scene();
-    return scene.get_projectiles().spawn(std::move(args));
-  });
+  // Items pop up a bit before falling
+  const auto vel = parse_vec2(args, "vel");
+  return {ntf::in_place,
+          kind,
+          pos,
+          vel.value_or(vec2{0.f, -2.f}),
+          args["value"].get_or(1.f),
+          args["scale"].get_or(16.f),
+          std::make_tuple(atlas, sprite, vec2{1.f, 1.f})};
+}
+
+} // namespace
+
+sol::optional<lua_projectile> lua_stage::spawn_proj(sol::table args) {
+  auto proj = parse_proj_args(args);
   if (!proj.has_value()) {
-    res.push_back({ts, sol::nil});
-  } else {
-    res.push_back({ts, sol::in_place_type<lua_projectile>, *proj});
+    return sol::nullopt;
   }
-  return res;
+  const u64 handle = _env->scene().get_projectiles().spawn(std::move(*proj));
+  if (auto handler = args["state_handler"].get<sol::optional<sol::protected_function>>()) {
+    _env->add_behavior(handle, std::move(*handler));
+  }
+  return lua_projectile{handle};
 }
 
 sol::table lua_stage::spawn_proj_n(sol::this_state ts, u32 count, sol::protected_function func) {
@@ -164,10 +290,7 @@ sol::table lua_stage::spawn_proj_n(sol::this_state ts, u32 count, sol::protected
   sol::table out = lua.create_table(count);
   u32 i = 1;
   for (auto& arg : args) {
-    auto proj = parse_proj_args(arg).transform([&](stage::projectile_args&& args) {
-      auto& scene = lua_stage::instance(ts)->scene();
-      return scene.get_projectiles().spawn(std::move(args));
-    });
+    auto proj = spawn_proj(arg);
     if (proj.has_value()) {
       out[i] = *proj;
       ++i;
@@ -199,6 +322,9 @@ auto parse_sprite_args(sol::table& args) -> expect<stage::sprite_args> {
   const real rot = args["rot"].get_or(0.f);
   const real ang_speed = args["angular_speed"].get_or(0.f);
   const auto movement = args["movement"].get<sol::optional<stage::entity_movement>>();
+  if (has_orbit_parent(movement)) {
+    return {ntf::unexpect, ORBIT_PARENT_ERR};
+  }
 
   return {ntf::in_place,
           *pos,
@@ -211,80 +337,468 @@ auto parse_sprite_args(sol::table& args) -> expect<stage::sprite_args> {
 
 } // namespace
 
-sol::variadic_results lua_stage::spawn_sprite(sol::this_state ts, sol::table args) {
-  sol::variadic_results res;
-
-  auto ent = parse_sprite_args(args).transform([&](stage::sprite_args&& args) {
-    auto& scene = lua_stage::instance(ts)->scene();
-    return scene.get_sprites().spawn(std::move(args));
-  });
+sol::optional<lua_sprite_ent> lua_stage::spawn_sprite(sol::table args) {
+  auto ent = parse_sprite_args(args);
   if (!ent.has_value()) {
-    res.push_back({ts, sol::nil});
+    logger::error("Failed to spawn sprite: {}", ent.error());
+    return sol::nullopt;
+  }
+  return lua_sprite_ent{_env->scene().get_sprites().spawn(std::move(*ent))};
+}
+
+lua_task lua_stage::spawn_task(sol::this_state ts, sol::protected_function func) {
+  return {_env->tasks().spawn(std::move(func), sol::make_object(ts, *this))};
+}
+
+sol::object lua_stage::rng(sol::this_state ts) {
+  sol::object* slot = _env->tasks().running_rng();
+  if (!slot) {
+    slot = &_env->rng();
+  }
+  if (!slot->valid()) {
+    *slot = sol::make_object(ts, _env->scene().split_rng());
+  }
+  return *slot;
+}
+
+namespace {
+
+u32 emit_shape(stage::stage_scene& scene, sol::table& args, stage::emitter_shape shape) {
+  auto pattern = parse_emitter_args(args, shape, scene.get_player().pos());
+  if (!pattern.has_value()) {
+    logger::error("Failed to emit pattern: {}", pattern.error());
+    return 0u;
+  }
+  return stage::emit_pattern(scene.get_projectiles(), *pattern, scene.rng());
+}
+
+} // namespace
+
+u32 lua_stage::emit_ring(sol::table args) {
+  return emit_shape(_env->scene(), args, stage::emitter_shape::ring);
+}
+
+u32 lua_stage::emit_spread(sol::table args) {
+  return emit_shape(_env->scene(), args, stage::emitter_shape::spread);
+}
+
+u32 lua_stage::emit_aimed(sol::table args) {
+  return emit_shape(_env->scene(), args, stage::emitter_shape::aimed);
+}
+
+sol::optional<lua_emitter> lua_stage::spawn_emitter(sol::table args) {
+  auto& scene = _env->scene();
+  auto shape = parse_emitter_shape(args);
+  if (!shape.has_value()) {
+    logger::error("Failed to spawn emitter: {}", shape.error());
+    return sol::nullopt;
+  }
+  auto pattern = parse_emitter_args(args, *shape, scene.get_player().pos());
+  if (!pattern.has_value()) {
+    logger::error("Failed to spawn emitter: {}", pattern.error());
+    return sol::nullopt;
+  }
+  return lua_emitter{scene.get_emitters().spawn(stage::periodic_emitter_args{
+    .pattern = *pattern,
+    .delay = args["delay"].get_or(0u),
+    .period = std::max(args["period"].get_or(1u), 1u),
+    .shots = args["shots"].get_or(0u),
+    .rotation = args["rotation"].get_or(0.f),
+  })};
+}
+
+sol::optional<lua_laser> lua_stage::spawn_laser(sol::table args) {
+  auto laser = parse_laser_args(args);
+  if (!laser.has_value()) {
+    logger::error("Failed to spawn laser: {}", laser.error());
+    return sol::nullopt;
+  }
+  return lua_laser{_env->scene().get_lasers().spawn(*laser)};
+}
+
+sol::optional<lua_enemy> lua_stage::spawn_enemy(sol::table args) {
+  auto enemy = parse_enemy_args(args);
+  if (!enemy.has_value()) {
+    logger::error("Failed to spawn enemy: {}", enemy.error());
+    return sol::nullopt;
+  }
+  return lua_enemy{_env->scene().get_enemies().spawn(*enemy)};
+}
+
+bool lua_stage::spawn_shot(sol::table args) {
+  auto shot = parse_proj_args(args);
+  if (!shot.has_value()) {
+    logger::error("Failed to spawn shot: {}", shot.error());
+    return false;
+  }
+  // Shots live in their own pool, enemy projectile handles mean nothing there
+  if (has_orbit_parent(shot->movement)) {
+    logger::error("Failed to spawn shot: {}", ORBIT_PARENT_ERR);
+    return false;
+  }
+  _env->scene().get_shots().spawn(std::move(*shot));
+  return true;
+}
+
+bool lua_stage::spawn_item(sol::table args) {
+  auto pos = parse_vec2(args, "pos");
+  if (!pos.has_value()) {
+    logger::error("Failed to spawn item: No position");
+    return false;
+  }
+  auto item = parse_item_args(args, *pos);
+  if (!item.has_value()) {
+    logger::error("Failed to spawn item: {}", item.error());
+    return false;
+  }
+  _env->scene().get_items().spawn(*item);
+  return true;
+}
+
+namespace {
+
+auto parse_particle_desc(sol::table& args) -> expect<stage::particle_desc> {
+  auto sprite_arg = args["sprite"].get<sol::optional<lua_sprite>>();
+  if (!sprite_arg.has_value()) {
+    return {ntf::unexpect, "No sprite"};
+  }
+  auto [atlas, sprite] = sprite_arg->get();
+
+  const real speed = args["speed"].get_or(2.f);
+  const real scale = args["scale"].get_or(8.f);
+  return {ntf::in_place,
+          args["lifetime"].get_or(30u),
+          args["count"].get_or(8u),
+          args["angle"].get_or(0.f),
+          args["spread"].get_or(2.f * std::numbers::pi_v<real>),
+          args["speed_min"].get_or(speed),
+          args["speed_max"].get_or(speed),
+          args["drag"].get_or(1.f),
+          scale,
+          args["end_scale"].get_or(scale),
+          args["alpha"].get_or(1.f),
+          args["end_alpha"].get_or(0.f),
+          std::make_tuple(atlas, sprite, vec2{1.f, 1.f})};
+}
+
+} // namespace
+
+sol::optional<u32> lua_stage::register_particles(sol::table args) {
+  auto desc = parse_particle_desc(args);
+  if (!desc.has_value()) {
+    logger::error("Failed to register particles: {}", desc.error());
+    return sol::nullopt;
+  }
+  return _env->scene().get_particles().register_desc(*desc);
+}
+
+void lua_stage::emit_particles(u32 desc, f32 x, f32 y, sol::optional<u32> count) {
+  auto& particles = _env->scene().get_particles();
+  if (!particles.is_valid(desc)) {
+    logger::error("Failed to emit particles: Invalid desc {}", desc);
+    return;
+  }
+  if (count.has_value()) {
+    particles.emit(desc, {x, y}, *count);
   } else {
-    res.push_back({ts, sol::in_place_type<lua_sprite_ent>, *ent});
+    particles.emit(desc, {x, y});
   }
+}
 
-  return res;
+void lua_stage::set_cancel_particles(sol::optional<u32> desc) {
+  auto& scene = _env->scene();
+  if (desc.has_value() && !scene.get_particles().is_valid(*desc)) {
+    logger::error("Failed to set cancel particles: Invalid desc {}", *desc);
+    return;
+  }
+  scene.cancel_particles(desc.has_value() ? ntf::optional<u32>{ntf::in_place, *desc}
+                                          : ntf::optional<u32>{ntf::nullopt});
 }
 
-lua_sprite_ent::lua_sprite_ent(u64 handle) : _handle{handle} {}
+u32 lua_stage::spawn_proj_batch(sol::this_state ts, sol::stack_object buf, u32 count,
+                                const lua_sprite_atlas& atlas) {
+  const auto* entries = static_cast<const ffi_proj_spawn*>(ffi_cdata_ptr(ts, buf.stack_index()));
+  if (!entries) {
+    logger::error("Failed to spawn batch: buffer is not cdata");
+    return 0u;
+  }
 
-bool lua_sprite_ent::is_alive(sol::this_state ts) const {
-  auto& scene = lua_stage::instance(ts)->scene();
-  return scene.get_sprites().is_alive(_handle);
+  const auto atlas_handle = atlas.get();
+  const u32 sprite_count = lua_assets::instance(ts).get_asset(atlas_handle).sprite_count();
+  auto& projs = _env->scene().get_projectiles();
+  u32 spawned = 0u;
+  for (u32 i = 0; i < count; ++i) {
+    const ffi_proj_spawn& entry = entries[i];
+    if (entry.sprite >= sprite_count || entry.movement >= FFI_MOVEMENT_COUNT) {
+      continue;
+    }
+
+    const vec2 vel{entry.vel_x, entry.vel_y};
+    const auto kind = static_cast<ffi_movement>(entry.movement);
+    const auto movement =
+      kind == ffi_movement::linear
+        ? stage::entity_movement::move_linear(vel)
+        : stage::entity_movement::move_interpolated(vel, {entry.end_vel_x, entry.end_vel_y},
+                                                    entry.ret);
+    const vec2 scale{entry.scale_x, entry.scale_y};
+    const auto sprite = static_cast<assets::sprite_atlas::sprite>(entry.sprite);
+    const real hitbox = entry.hitbox > 0.f
+                          ? entry.hitbox
+                          : DEF_PROJ_HITBOX_FAC * std::min(std::abs(scale.x), std::abs(scale.y));
+    projs.spawn({
+      .pos = {entry.pos_x, entry.pos_y},
+      .vel = vel,
+      .scale = scale,
+      .angular_speed = entry.angular_speed,
+      .hitbox = hitbox,
+      .cull_margin = std::max(std::abs(scale.x), std::abs(scale.y)),
+      .sprite = std::make_tuple(atlas_handle, sprite, vec2{1.f, 1.f}),
+      .movement = movement,
+      .analytic = kind == ffi_movement::analytic,
+      .damage = 1.f,
+    });
+    ++spawned;
+  }
+  if (spawned != count) {
+    logger::warning("Skipped {} batch entries with invalid sprites or movements", count - spawned);
+  }
+  return spawned;
 }
 
-void lua_sprite_ent::kill(sol::this_state ts) const {
-  auto& scene = lua_stage::instance(ts)->scene();
-  scene.get_sprites().kill(_handle);
+void* lua_stage::proj_view() {
+  // Only read through const pointers on the Lua side
+  return const_cast<ffi_proj_view*>(&_env->proj_view());
 }
 
-void lua_sprite_ent::set_pos(sol::this_state ts, f32 x, f32 y) {
-  auto& scene = lua_stage::instance(ts)->scene();
-  scene.get_sprites().at(_handle).pos(x, y);
+sol::optional<lua_projectile> lua_stage::proj_at(u32 idx) {
+  auto& projs = _env->scene().get_projectiles();
+  if (idx >= projs.size()) {
+    return sol::nullopt;
+  }
+  return lua_projectile{projs.handle_at(idx)};
 }
 
-vec2 lua_sprite_ent::get_pos(sol::this_state ts) {
-  auto& scene = lua_stage::instance(ts)->scene();
-  return scene.get_sprites().at(_handle).pos();
+u32 lua_stage::cancel_projs() {
+  return _env->scene().cancel_projs();
 }
 
-void lua_sprite_ent::set_movement(sol::this_state ts, stage::entity_movement movement) {
-  auto& scene = lua_stage::instance(ts)->scene();
-  scene.get_sprites().at(_handle).set_movement(movement);
+u32 lua_stage::cancel_projs_circle(f32 x, f32 y, f32 radius) {
+  return _env->scene().cancel_projs_circle({x, y}, radius);
 }
 
-auto lua_stage::register_event(std::string name, sol::protected_function func) -> lua_event {
-  auto it = _env->register_event(std::move(name), std::move(func));
-  return {it};
+u32 lua_stage::cancel_projs_rect(f32 x0, f32 y0, f32 x1, f32 y1) {
+  const vec2 min{std::min(x0, x1), std::min(y0, y1)};
+  const vec2 max{std::max(x0, x1), std::max(y0, y1)};
+  return _env->scene().cancel_projs_rect(min, max);
 }
 
-void lua_stage::trigger_event(std::string name, sol::variadic_args args) {
-  _env->trigger_event(std::move(name), std::move(args));
+u32 lua_stage::convert_projs_circle(f32 x, f32 y, f32 radius, sol::table args) {
+  auto item_args = parse_item_args(args, vec2{0.f, 0.f});
+  if (!item_args.has_value()) {
+    logger::error("Failed to convert projectiles: {}", item_args.error());
+    return 0u;
+  }
+  return _env->scene().convert_projs_circle({x, y}, radius, *item_args);
 }
 
-void lua_stage::unregister_event(std::string name, lua_event event) {
-  _env->unregister_event(std::move(name), event.get());
+namespace {
+
+// Strings only get interned when registering, triggering an unknown name is a no-op
+auto resolve_event(stage_env& env, const sol::stack_object& name,
+                   bool intern) -> ntf::optional<stage_env::event_id> {
+  if (name.get_type() == sol::type::number) {
+    const auto event = name.as<stage_env::event_id>();
+    if (!env.is_valid_event(event)) {
+      return {ntf::nullopt};
+    }
+    return {ntf::in_place, event};
+  }
+  if (name.get_type() != sol::type::string) {
+    return {ntf::nullopt};
+  }
+  const auto str = name.as<std::string_view>();
+  if (intern) {
+    return {ntf::in_place, env.intern_event(str)};
+  }
+  return env.find_event(str);
 }
 
-void lua_stage::clear_events(std::string name) {
-  _env->clear_events(std::move(name));
+} // namespace
+
+u32 lua_stage::event_id(std::string_view name) {
+  return _env->intern_event(name);
+}
+
+void lua_stage::trigger_event(sol::stack_object name, sol::variadic_args args) {
+  if (auto event = resolve_event(*_env, name, false)) {
+    _env->trigger_event(*event, std::move(args));
+  }
+}
+
+void lua_stage::queue_event(sol::stack_object name, sol::variadic_args args) {
+  if (auto event = resolve_event(*_env, name, false)) {
+    _env->queue_event(*event, std::move(args));
+  }
+}
+
+sol::optional<lua_event> lua_stage::register_event(sol::stack_object name,
+                                                   sol::protected_function func) {
+  auto event = resolve_event(*_env, name, true);
+  if (!event) {
+    logger::error("Failed to register event: invalid event name");
+    return sol::nullopt;
+  }
+  return lua_event{*event, _env->register_event(*event, std::move(func))};
+}
+
+void lua_stage::unregister_event(lua_event event) {
+  _env->unregister_event(event.event(), event.handler());
+}
+
+void lua_stage::clear_events(sol::stack_object name) {
+  if (auto event = resolve_event(*_env, name, false)) {
+    _env->clear_events(*event);
+  }
 }
 
 namespace {
 
-fn prep_usertypes(sol::table& module) {
+fn prep_handle_methods(sol::state_view lua, stage_env& env) {
+  // The scene and the env outlive the lua state, so the methods capture them directly instead of
+  // going through okuu.__curr_stage on every call
+  auto* projs = &env.scene().get_projectiles();
+  auto* sprites = &env.scene().get_sprites();
+  auto* tasks = &env.tasks();
+  auto* emitters = &env.scene().get_emitters();
+  auto* lasers = &env.scene().get_lasers();
+  auto* enemies = &env.scene().get_enemies();
+
+  std::array<sol::table, HANDLE_TAG_COUNT> methods;
+  auto& proj = methods[static_cast<u32>(handle_tag::projectile)];
+  proj = lua.create_table();
+  proj.set_function("is_alive", [projs](lua_projectile self) {
+    return projs->is_alive(self.get_handle());
+  });
+  proj.set_function("kill", [projs](lua_projectile self) { projs->kill(self.get_handle()); });
+  proj.set_function("set_pos", [projs](lua_projectile self, f32 x, f32 y) {
+    projs->pos(self.get_handle(), x, y);
+  });
+  proj.set_function("get_pos", [projs](lua_projectile self) -> vec2 {
+    return projs->pos(self.get_handle());
+  });
+  proj.set_function("set_movement", [projs](lua_projectile self, stage::entity_movement mov) {
+    projs->movement(self.get_handle(), mov);
+  });
+
+  auto& sprite = methods[static_cast<u32>(handle_tag::sprite)];
+  sprite = lua.create_table();
+  sprite.set_function("is_alive", [sprites](lua_sprite_ent self) {
+    return sprites->is_alive(self.get_handle());
+  });
+  sprite.set_function("kill", [sprites](lua_sprite_ent self) {
+    sprites->kill(self.get_handle());
+  });
+  sprite.set_function("set_pos", [sprites](lua_sprite_ent self, f32 x, f32 y) {
+    sprites->at(self.get_handle()).pos(x, y);
+  });
+  sprite.set_function("get_pos", [sprites](lua_sprite_ent self) -> vec2 {
+    return sprites->at(self.get_handle()).pos();
+  });
+  sprite.set_function("set_movement", [sprites](lua_sprite_ent self, stage::entity_movement mov) {
+    if (has_orbit_parent(mov)) {
+      logger::error("Failed to set sprite movement: {}", ORBIT_PARENT_ERR);
+      return;
+    }
+    sprites->at(self.get_handle()).set_movement(mov);
+  });
+
+  auto& task = methods[static_cast<u32>(handle_tag::task)];
+  task = lua.create_table();
+  task.set_function("is_alive", [tasks](lua_task self) {
+    return tasks->is_alive(self.get_handle());
+  });
+  task.set_function("cancel", [tasks](lua_task self) { tasks->cancel(self.get_handle()); });
+
+  auto& emitter = methods[static_cast<u32>(handle_tag::emitter)];
+  emitter = lua.create_table();
+  emitter.set_function("is_alive", [emitters](lua_emitter self) {
+    return emitters->is_alive(self.get_handle());
+  });
+  emitter.set_function("kill", [emitters](lua_emitter self) {
+    emitters->kill(self.get_handle());
+  });
+  emitter.set_function("set_pos", [emitters](lua_emitter self, f32 x, f32 y) {
+    emitters->at(self.get_handle()).pos(x, y);
+  });
+  emitter.set_function("get_pos", [emitters](lua_emitter self) -> vec2 {
+    return emitters->at(self.get_handle()).pos();
+  });
+  emitter.set_function("set_angle", [emitters](lua_emitter self, f32 angle) {
+    emitters->at(self.get_handle()).angle(angle);
+  });
+
+  auto& laser = methods[static_cast<u32>(handle_tag::laser)];
+  laser = lua.create_table();
+  laser.set_function("is_alive", [lasers](lua_laser self) {
+    return lasers->is_alive(self.get_handle());
+  });
+  laser.set_function("kill", [lasers](lua_laser self) { lasers->kill(self.get_handle()); });
+  laser.set_function("set_pos", [lasers](lua_laser self, f32 x, f32 y) {
+    lasers->at(self.get_handle()).pos(x, y);
+  });
+  laser.set_function("get_pos", [lasers](lua_laser self) -> vec2 {
+    return lasers->at(self.get_handle()).pos();
+  });
+  laser.set_function("set_angle", [lasers](lua_laser self, f32 angle) {
+    lasers->at(self.get_handle()).angle(angle);
+  });
+  laser.set_function("set_length", [lasers](lua_laser self, f32 length) {
+    lasers->at(self.get_handle()).length(length);
+  });
+  laser.set_function("set_movement", [lasers](lua_laser self, stage::entity_movement mov) {
+    if (has_orbit_parent(mov)) {
+      logger::error("Failed to set laser movement: {}", ORBIT_PARENT_ERR);
+      return;
+    }
+    lasers->at(self.get_handle()).set_movement(mov);
+  });
+
+  auto& enemy = methods[static_cast<u32>(handle_tag::enemy)];
+  enemy = lua.create_table();
+  enemy.set_function("is_alive", [enemies](lua_enemy self) {
+    return enemies->is_alive(self.get_handle());
+  });
+  enemy.set_function("kill", [enemies](lua_enemy self) { enemies->kill(self.get_handle()); });
+  enemy.set_function("set_pos", [enemies](lua_enemy self, f32 x, f32 y) {
+    enemies->at(self.get_handle()).pos(x, y);
+  });
+  enemy.set_function("get_pos", [enemies](lua_enemy self) -> vec2 {
+    return enemies->at(self.get_handle()).pos();
+  });
+  enemy.set_function("get_hp", [enemies](lua_enemy self) -> f32 {
+    return enemies->at(self.get_handle()).hp();
+  });
+  enemy.set_function("set_hp", [enemies](lua_enemy self, f32 hp) {
+    enemies->at(self.get_handle()).hp(hp);
+  });
+  enemy.set_function("set_movement", [enemies](lua_enemy self, stage::entity_movement mov) {
+    if (has_orbit_parent(mov)) {
+      logger::error("Failed to set enemy movement: {}", ORBIT_PARENT_ERR);
+      return;
+    }
+    enemies->at(self.get_handle()).set_movement(mov);
+  });
+
+  setup_handle_metatable(lua, methods);
+}
+
+auto prep_usertypes(sol::table& module, stage::stage_scene& scene) -> sol::usertype<lua_stage> {
+  auto* player = &scene.get_player();
   // clang-format off
   module.new_usertype<lua_player>(
     "player", sol::no_constructor,
-    "set_pos", +[](sol::this_state ts, lua_player&, f32 x, f32 y) {
-      auto& player = lua_stage::instance(ts)->scene().get_player();
-      player.pos(x, y);
-    },
-    "get_pos", +[](sol::this_state ts, lua_player&) -> vec2 {
-      auto& player = lua_stage::instance(ts)->scene().get_player();
-      return player.pos();
-    }
+    "set_pos", [player](lua_player&, f32 x, f32 y) { player->pos(x, y); },
+    "get_pos", [player](lua_player&) -> vec2 { return player->pos(); }
   );
   module.new_usertype<lua_boss>(
     "boss", sol::no_constructor,
@@ -292,22 +806,6 @@ fn prep_usertypes(sol::table& module) {
     "kill", &lua_boss::kill,
     "is_alive", &lua_boss::is_alive
   );
-  module.new_usertype<lua_projectile>(
-    "projectile", sol::no_constructor,
-    "is_alive", &lua_projectile::is_alive,
-    "kill", &lua_projectile::kill,
-    "set_pos", &lua_projectile::set_pos,
-    "set_movement", &lua_projectile::set_movement,
-    "get_pos", &lua_projectile::get_pos
-  );
-  module.new_usertype<lua_sprite_ent>(
-    "sprite_ent", sol::no_constructor,
-    "is_alive", &lua_sprite_ent::is_alive,
-    "kill", &lua_sprite_ent::kill,
-    "set_pos", &lua_sprite_ent::set_pos,
-    "set_movement", &lua_sprite_ent::set_movement,
-    "get_pos", &lua_sprite_ent::get_pos
-  );
   module.new_usertype<stage::entity_movement>(
     "movement", sol::no_constructor,
     "move_linear", +[](f32 vel_x, f32 vel_y) {
@@ -316,27 +814,84 @@ fn prep_usertypes(sol::table& module) {
     "move_towards", +[](f32 vel_x, f32 vel_y, f32 x, f32 y) {
       static constexpr f32 DT = 1/60.f;
       return stage::entity_movement::move_towards({x, y}, {DT*vel_x, DT*vel_y}, {DT, 0.f}, .8f);
+    },
+    "move_orbit", +[](f32 x, f32 y, f32 radius, f32 angle, f32 ang_vel,
+                      sol::optional<f32> radial_vel) {
+      return stage::entity_movement::move_orbit({x, y}, radius, angle, ang_vel,
+                                                radial_vel.value_or(0.f));
+    },
+    "move_orbit_proj", +[](lua_projectile parent, f32 radius, f32 angle, f32 ang_vel,
+                           sol::optional<f32> radial_vel) {
+      return stage::entity_movement::move_orbit_parent(parent.get_handle(), radius, angle,
+                                                       ang_vel, radial_vel.value_or(0.f));
+    },
+    "move_wave", +[](f32 vel_x, f32 vel_y, f32 amp, f32 freq, sol::optional<f32> phase) {
+      return stage::entity_movement::move_wave({vel_x, vel_y}, amp, freq, phase.value_or(0.f));
+    },
+    "move_bezier", +[](f32 x0, f32 y0, f32 x1, f32 y1, f32 x2, f32 y2, f32 x3, f32 y3,
+                       u32 duration) {
+      return stage::entity_movement::move_path(stage::path_curve::bezier,
+                                               {vec2{x0, y0}, vec2{x1, y1}, vec2{x2, y2},
+                                                vec2{x3, y3}}, duration);
+    },
+    "move_catmull_rom", +[](f32 x0, f32 y0, f32 x1, f32 y1, f32 x2, f32 y2, f32 x3, f32 y3,
+                            u32 duration) {
+      return stage::entity_movement::move_path(stage::path_curve::catmull_rom,
+                                               {vec2{x0, y0}, vec2{x1, y1}, vec2{x2, y2},
+                                                vec2{x3, y3}}, duration);
+    },
+    "move_delayed", +[](u32 ticks, const stage::entity_movement& after) {
+      return stage::entity_movement::move_delayed(ticks, after);
+    },
+    "move_capped", +[](f32 vel_x, f32 vel_y, f32 accel, f32 cap) {
+      return stage::entity_movement::move_capped({vel_x, vel_y}, accel, cap);
     }
   );
   module.new_usertype<lua_event>(
     "event", sol::no_constructor
   );
-  module.new_usertype<lua_stage>(
+  return module.new_usertype<lua_stage>(
     "stage", sol::no_constructor,
-    "yield", sol::yielding(+[](lua_stage& stage) { stage.on_yield(1); }),
-    "yield_ticks", sol::yielding(+[](lua_stage& stage, u32 ticks) { stage.on_yield(ticks); }),
-    "yield_secs", sol::yielding(+[](lua_stage& stage, f32 secs) {
-      stage.on_yield(secs_to_ticks(secs));
-    }),
+    // The scheduler reads the yielded value as the number of ticks to sleep
+    "yield", sol::yielding(+[](lua_stage&) -> u32 { return 1u; }),
+    "yield_ticks", sol::yielding(+[](lua_stage&, u32 ticks) { return ticks; }),
+    "yield_secs", sol::yielding(+[](lua_stage&, f32 secs) { return secs_to_ticks(secs); }),
+    "event_id", &lua_stage::event_id,
     "trigger_event", &lua_stage::trigger_event,
+    "queue_event", &lua_stage::queue_event,
     "register_event", &lua_stage::register_event,
-    "unregister_event", &lua_stage::unregister_event,
+    // The name used to be required, still accepted but the event already knows it
+    "unregister_event", sol::overload(
+      &lua_stage::unregister_event,
+      +[](lua_stage& self, sol::stack_object, lua_event event) { self.unregister_event(event); }
+    ),
     "clear_events", &lua_stage::clear_events,
     "get_player", +[](lua_stage&) -> lua_player { return {}; },
     "get_boss", &lua_stage::get_boss,
+    // Running total, stage::on_graze gets the count for each tick
+    "get_graze_count", +[](lua_stage& self) -> u32 { return self->scene().graze_count(); },
     "spawn_proj", &lua_stage::spawn_proj,
     "spawn_proj_n", &lua_stage::spawn_proj_n,
-    "spawn_sprite", &lua_stage::spawn_sprite
+    "spawn_sprite", &lua_stage::spawn_sprite,
+    "spawn_task", &lua_stage::spawn_task,
+    "rng", &lua_stage::rng,
+    "emit_ring", &lua_stage::emit_ring,
+    "emit_spread", &lua_stage::emit_spread,
+    "emit_aimed", &lua_stage::emit_aimed,
+    "spawn_emitter", &lua_stage::spawn_emitter,
+    "spawn_laser", &lua_stage::spawn_laser,
+    "spawn_enemy", &lua_stage::spawn_enemy,
+    "spawn_shot", &lua_stage::spawn_shot,
+    "spawn_item", &lua_stage::spawn_item,
+    "attract_items", +[](lua_stage& self) { self->scene().get_items().attract_all(); },
+    "register_particles", &lua_stage::register_particles,
+    "emit_particles", &lua_stage::emit_particles,
+    "set_cancel_particles", &lua_stage::set_cancel_particles,
+    "proj_at", &lua_stage::proj_at,
+    "cancel_projs", &lua_stage::cancel_projs,
+    "cancel_projs_circle", &lua_stage::cancel_projs_circle,
+    "cancel_projs_rect", &lua_stage::cancel_projs_rect,
+    "convert_projs_circle", &lua_stage::convert_projs_circle
   );
   // clang-format on
 }
@@ -347,7 +902,19 @@ lua_stage lua_stage::setup_module(sol::table& okuu_lib, stage_env& scene) {
   sol::table stage_module = okuu_lib["stage"].get_or_create<sol::table>();
   lua_stage env_stage{scene};
   okuu_lib["__curr_stage"] = env_stage;
-  prep_usertypes(stage_module);
+  auto stage_type = prep_usertypes(stage_module, scene.scene());
+  prep_handle_methods(okuu_lib.lua_state(), scene);
+
+  // These live in Lua so cdata can be cast with the FFI before crossing over
+  sol::state_view lua = okuu_lib.lua_state();
+  sol::table raw = lua.create_table_with("spawn_batch", &lua_stage::spawn_proj_batch,
+                                         "proj_view", &lua_stage::proj_view);
+  auto ffi_methods = setup_ffi_methods(lua, stage_module, raw);
+  if (ffi_methods.get_type() == sol::type::table) {
+    for (auto [name, func] : ffi_methods.as<sol::table>()) {
+      stage_type.set(name.as<std::string>(), func);
+    }
+  }
   return env_stage;
 }
 
@@ -1,9 +1,10 @@
 #pragma once
 
 #include "../stage/stage.hpp"
+#include "./assets.hpp"
+#include "./handle.hpp"
 #include "./sol.hpp"
 
-#include <list>
 
 namespace okuu::lua {
 
@@ -30,15 +31,13 @@ private:
 
 class lua_projectile {
 public:
-  lua_projectile(u64 handle);
+  static constexpr handle_tag HANDLE_TAG = handle_tag::projectile;
 
 public:
-  u32 get_handle() const;
-  bool is_alive(sol::this_state ts) const;
-  void kill(sol::this_state ts) const;
-  void set_pos(sol::this_state ts, f32 x, f32 y);
-  vec2 get_pos(sol::this_state ts);
-  void set_movement(sol::this_state ts, stage::entity_movement movement);
+  lua_projectile(u64 handle) noexcept : _handle{handle} {}
+
+public:
+  u64 get_handle() const { return _handle; }
 
 private:
   u64 _handle;
@@ -46,32 +45,86 @@ private:
 
 class lua_sprite_ent {
 public:
-  lua_sprite_ent(u64 handle);
+  static constexpr handle_tag HANDLE_TAG = handle_tag::sprite;
 
+public:
+  lua_sprite_ent(u64 handle) noexcept : _handle{handle} {}
+
+public:
   u64 get_handle() const { return _handle; }
 
-  bool is_alive(sol::this_state ts) const;
-  void kill(sol::this_state ts) const;
-  void set_pos(sol::this_state ts, f32 x, f32 y);
-  vec2 get_pos(sol::this_state ts);
-  void set_movement(sol::this_state ts, stage::entity_movement movement);
+private:
+  u64 _handle;
+};
+
+class lua_task {
+public:
+  static constexpr handle_tag HANDLE_TAG = handle_tag::task;
+
+public:
+  lua_task(u64 handle) noexcept : _handle{handle} {}
+
+public:
+  u64 get_handle() const { return _handle; }
 
 private:
   u64 _handle;
 };
 
-class lua_event {
+class lua_emitter {
+public:
+  static constexpr handle_tag HANDLE_TAG = handle_tag::emitter;
+
+public:
+  lua_emitter(u64 handle) noexcept : _handle{handle} {}
+
+public:
+  u64 get_handle() const { return _handle; }
+
+private:
+  u64 _handle;
+};
+
+class lua_laser {
+public:
+  static constexpr handle_tag HANDLE_TAG = handle_tag::laser;
+
 public:
-  using list_iterator = std::list<sol::protected_function>::iterator;
+  lua_laser(u64 handle) noexcept : _handle{handle} {}
 
 public:
-  lua_event(list_iterator it) : _it{it} {}
+  u64 get_handle() const { return _handle; }
+
+private:
+  u64 _handle;
+};
+
+class lua_enemy {
+public:
+  static constexpr handle_tag HANDLE_TAG = handle_tag::enemy;
+
+public:
+  lua_enemy(u64 handle) noexcept : _handle{handle} {}
+
+public:
+  u64 get_handle() const { return _handle; }
+
+private:
+  u64 _handle;
+};
+
+class lua_event {
+public:
+  lua_event(u32 event, u32 handler) noexcept : _event{event}, _handler{handler} {}
 
 public:
-  list_iterator get() { return _it; }
+  u32 event() const { return _event; }
+
+  u32 handler() const { return _handler; }
 
 private:
-  list_iterator _it;
+  u32 _event;
+  u32 _handler;
 };
 
 class stage_env;
@@ -88,20 +141,67 @@ public:
   stage_env& operator*() { return get(); }
 
 public:
-  void on_yield(u32 ticks);
-
-  void trigger_event(std::string name, sol::variadic_args args);
-  lua_event register_event(std::string name, sol::protected_function func);
-  void unregister_event(std::string name, lua_event event);
-  void clear_events(std::string name);
+  // Events can be named by string or by the integer from event_id(), which skips the lookup
+  u32 event_id(std::string_view name);
+  void trigger_event(sol::stack_object name, sol::variadic_args args);
+  void queue_event(sol::stack_object name, sol::variadic_args args);
+  sol::optional<lua_event> register_event(sol::stack_object name, sol::protected_function func);
+  void unregister_event(lua_event event);
+  void clear_events(sol::stack_object name);
 
   sol::variadic_results get_boss(sol::this_state ts, u32 slot);
 
-  sol::variadic_results spawn_proj(sol::this_state ts, sol::table args);
+  sol::optional<lua_projectile> spawn_proj(sol::table args);
 
   sol::table spawn_proj_n(sol::this_state ts, u32 count, sol::protected_function func);
 
-  sol::variadic_results spawn_sprite(sol::this_state ts, sol::table args);
+  sol::optional<lua_sprite_ent> spawn_sprite(sol::table args);
+
+  lua_task spawn_task(sol::this_state ts, sol::protected_function func);
+
+  // Every task gets its own stream split from the stage one, so spawning or removing a task
+  // doesn't shift the numbers drawn by the others
+  sol::object rng(sol::this_state ts);
+
+  // Native patterns, the whole pattern comes from a single table. Return the bullet count.
+  u32 emit_ring(sol::table args);
+  u32 emit_spread(sol::table args);
+  u32 emit_aimed(sol::table args);
+
+  sol::optional<lua_emitter> spawn_emitter(sol::table args);
+
+  // `kind` is "straight" (default) or "curvy"
+  sol::optional<lua_laser> spawn_laser(sol::table args);
+
+  sol::optional<lua_enemy> spawn_enemy(sol::table args);
+
+  // Player shots take the same table as spawn_proj plus `damage`. There's no handle to them, they
+  // live until they hit something or leave the playfield.
+  bool spawn_shot(sol::table args);
+
+  // Items have no handle either, only their collection is reported through stage::on_item_collect
+  bool spawn_item(sol::table args);
+
+  // Particles are only referenced through the desc id, bursts never create Lua objects
+  sol::optional<u32> register_particles(sol::table args);
+  void emit_particles(u32 desc, f32 x, f32 y, sol::optional<u32> count);
+  void set_cancel_particles(sol::optional<u32> desc);
+
+  // Reads `count` ffi_proj_spawn entries from a pointer cdata, use stage:spawn_batch() from Lua.
+  // The count can't be checked here, the prelude clamps it for arrays.
+  u32 spawn_proj_batch(sol::this_state ts, sol::stack_object buf, u32 count,
+                       const lua_sprite_atlas& atlas);
+
+  // Light userdata pointing to the env's ffi_proj_view, use stage:get_proj_view() from Lua
+  void* proj_view();
+
+  // Handle of the projectile at a dense index from the proj view, 0 based
+  sol::optional<lua_projectile> proj_at(u32 idx);
+
+  u32 cancel_projs();
+  u32 cancel_projs_circle(f32 x, f32 y, f32 radius);
+  u32 cancel_projs_rect(f32 x0, f32 y0, f32 x1, f32 y1);
+  u32 convert_projs_circle(f32 x, f32 y, f32 radius, sol::table args);
 
 public:
   static lua_stage setup_module(sol::table& okuu_lib, stage_env& env);
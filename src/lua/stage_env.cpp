@@ -3,6 +3,11 @@
 #include "./assets.hpp"
 #include "./stage.hpp"
 
+#include "../util/profiler.hpp"
+
+#include <cstring>
+#include <span>
+
 namespace okuu::lua {
 
 namespace {
@@ -60,8 +65,46 @@ fn setup_okuu_base(sol::table& okuu_lib) {
     sol::meta_function::multiplication,
       sol::resolve<mat4(const mat4&, const mat4&)>(&glm::operator*)
   );
+  // Scripts should use stage:rng() to stay in sync with the stage seed, the constructor is for
+  // anything that wants its own fixed sequence
+  auto rng_type = math_module.new_usertype<util::rng_stream>(
+    "rng",
+      sol::call_constructor, sol::factories(+[](sol::optional<u64> seed) {
+        return util::rng_stream{seed.value_or(0u)};
+      }),
+    "next", &util::rng_stream::uniform,
+    "range", &util::rng_stream::range,
+    "int", &util::rng_stream::int_range,
+    "normal", +[](util::rng_stream& rng, sol::optional<f32> mean, sol::optional<f32> dev) {
+      return mean.value_or(0.f) + (dev.value_or(1.f) * rng.normal());
+    },
+    "split", &util::rng_stream::split
+  );
   // clang-format on
 
+  // Bulk fills go through the FFI, rng:fill_uniform(buf, n) and rng:fill_normal(buf, n)
+  const auto raw_fill = [](auto fill) {
+    return [fill](sol::this_state ts, util::rng_stream& rng, sol::stack_object buf, u32 count) {
+      // The prelude casts to float*, so the pointer is writable
+      auto* out = static_cast<real*>(const_cast<void*>(ffi_cdata_ptr(ts, buf.stack_index())));
+      if (!out) {
+        logger::error("Failed to fill rng buffer: buffer is not cdata");
+        return;
+      }
+      std::invoke(fill, rng, out, count);
+    };
+  };
+  sol::state_view lua = okuu_lib.lua_state();
+  sol::table raw =
+    lua.create_table_with("fill_uniform", raw_fill(&util::rng_stream::fill_uniform),
+                          "fill_normal", raw_fill(&util::rng_stream::fill_normal));
+  auto ffi_methods = setup_ffi_rng_methods(lua, raw);
+  if (ffi_methods.get_type() == sol::type::table) {
+    for (auto [name, func] : ffi_methods.as<sol::table>()) {
+      rng_type.set(name.as<std::string>(), func);
+    }
+  }
+
   return okuu_lib;
 }
 
@@ -103,9 +146,36 @@ thread_coro thread_coro::from_func(sol::protected_function func) {
 
 stage_env::stage_env(stage::stage_scene& scene, sol::state&& lua,
                      sol::optional<sol::protected_function>&& stage_setup,
-                     sol::coroutine&& stage_run) :
+                     sol::protected_function&& stage_run) :
     _scene{scene},
-    _lua{std::move(lua)}, _stage_setup{std::move(stage_setup)}, _stage_run{std::move(stage_run)} {}
+    _lua{std::move(lua)}, _stage_setup{std::move(stage_setup)}, _stage_run{std::move(stage_run)},
+    _events{}, _player_hit_event{_events.intern("stage::on_player_hit")},
+    _laser_hit_event{_events.intern("stage::on_laser_hit")},
+    _enemy_death_event{_events.intern("stage::on_enemy_death")},
+    _graze_event{_events.intern("stage::on_graze")},
+    _item_collect_event{_events.intern("stage::on_item_collect")}, _scene_handlers{}, _queued{},
+    _dispatching{}, _queued_args{}, _dispatching_args{},
+    _behaviors{_lua, scene.get_projectiles()}, _tasks{_lua}, _proj_view{}, _proj_view_data{}, _rng{} {}
+
+stage_env::~stage_env() noexcept {
+  // All of them get registered together, moved from envs never have any
+  if (_scene_handlers.player_hit == scene_handlers::NULL_HANDLER) {
+    return;
+  }
+  const auto unregister = [](auto& event, scene_handlers::handler_id id) {
+    if (id != scene_handlers::NULL_HANDLER) {
+      event.unregister_event(id);
+    }
+  };
+  auto& scene = *_scene;
+  unregister(scene.on_player_hit(), _scene_handlers.player_hit);
+  unregister(scene.on_laser_hit(), _scene_handlers.laser_hit);
+  unregister(scene.on_enemy_death(), _scene_handlers.enemy_death);
+  unregister(scene.on_graze(), _scene_handlers.graze);
+  unregister(scene.on_item_collect(), _scene_handlers.item_collect);
+  // Registered by this env's script, the next one registers its own
+  scene.reset_particles();
+}
 
 static constexpr std::string_view incl_path = ";res/script/?.lua";
 
@@ -113,7 +183,7 @@ expect<stage_env> stage_env::load(const std::string& script_path, stage::stage_s
                                   assets::asset_bundle& assets) {
   sol::state lua;
   lua.open_libraries(sol::lib::base, sol::lib::coroutine, sol::lib::package, sol::lib::table,
-                     sol::lib::math, sol::lib::string);
+                     sol::lib::math, sol::lib::string, sol::lib::ffi, sol::lib::jit);
   lua["package"]["path"] = incl_path.data();
   auto okuu_lib = lua["okuu"].get_or_create<sol::table>();
   setup_okuu_base(okuu_lib);
@@ -128,47 +198,116 @@ expect<stage_env> stage_env::load(const std::string& script_path, stage::stage_s
     if (!stage_data.has_value()) {
       return {ntf::unexpect, "No stage functions defined in lua scriptl"};
     }
-    sol::coroutine run_coro{lua.lua_state(), stage_data->stage_run};
-
     return {ntf::in_place, scene, std::move(lua), std::move(stage_data->stage_setup),
-            std::move(run_coro)};
+            std::move(stage_data->stage_run)};
   } catch (const sol::error& err) {
     return {ntf::unexpect, err.what()};
   }
 }
 
 void stage_env::setup_stage_modules() {
-  if (!_stage_setup) {
-    return;
-  }
+  NTF_ASSERT(_scene_handlers.player_hit == scene_handlers::NULL_HANDLER);
+  _scene_handlers.player_hit = _scene->on_player_hit().register_event([this](u64 handle) {
+    _events.trigger_event(_player_hit_event, lua_projectile{handle});
+  });
+  _scene_handlers.laser_hit = _scene->on_laser_hit().register_event([this](u64 handle) {
+    _events.trigger_event(_laser_hit_event, lua_laser{handle});
+  });
+  _scene_handlers.enemy_death = _scene->on_enemy_death().register_event([this](u64 handle) {
+    _events.trigger_event(_enemy_death_event, lua_enemy{handle});
+  });
+  _scene_handlers.graze = _scene->on_graze().register_event([this](u32 count) {
+    _events.trigger_event(_graze_event, count);
+  });
+  // Handlers get the item count and then the value for each kind, in item_kind order
+  static_assert(stage::ITEM_KIND_COUNT == 4u);
+  _scene_handlers.item_collect =
+    _scene->on_item_collect().register_event([this](const stage::item_totals& totals) {
+      _events.trigger_event(_item_collect_event, totals.count, totals.value[0], totals.value[1],
+                            totals.value[2], totals.value[3]);
+    });
+
   auto okuu_lib = _lua["okuu"].get<sol::table>();
   auto env = lua_stage::setup_module(okuu_lib, *this);
-  auto setup_res = std::invoke(*_stage_setup, env);
-  if (!setup_res.valid()) {
-    sol::error err = setup_res;
-    logger::error("Error on script stage_setup: {}", err.what());
+  if (_stage_setup) {
+    auto setup_res = std::invoke(*_stage_setup, env);
+    if (!setup_res.valid()) {
+      sol::error err = setup_res;
+      logger::error("Error on script stage_setup: {}", err.what());
+    }
+  }
+
+  // The stage run function is just the first task
+  _tasks.spawn(_stage_run, sol::make_object(_lua, env));
+}
+
+const ffi_proj_view& stage_env::proj_view() {
+  auto& projs = _scene->get_projectiles();
+  if (_proj_view.generation != 0u && _proj_view.tick == projs.clock()) {
+    return _proj_view;
   }
+
+  // Once per tick, views taken after a spawn or kill still point at the copy from the first call
+  OKUU_PROFILE_ZONE("lua::copy_proj_view");
+  projs.sync_analytic();
+  const u32 count = projs.size();
+  _proj_view_data.resize(4u * count);
+  f32* out = _proj_view_data.data();
+  for (const auto arr : {projs.pos_x(), projs.pos_y(), projs.vel_x(), projs.vel_y()}) {
+    std::memcpy(out, arr.data(), count * sizeof(f32));
+    out += count;
+  }
+  _proj_view = {
+    .pos_x = _proj_view_data.data(),
+    .pos_y = _proj_view_data.data() + count,
+    .vel_x = _proj_view_data.data() + (2u * count),
+    .vel_y = _proj_view_data.data() + (3u * count),
+    .count = count,
+    .tick = projs.clock(),
+    .generation = _proj_view.generation + 1u,
+  };
+  return _proj_view;
+}
+
+void stage_env::trigger_event(event_id event, sol::variadic_args args) {
+  _events.trigger_event(event, args);
 }
 
-void stage_env::run_tasks() {
-  auto env = lua_stage::instance(_lua);
-  std::invoke(_stage_run, env);
+auto stage_env::register_event(event_id event, sol::protected_function func) -> handler_id {
+  return _events.register_event(event, std::move(func));
 }
 
-void stage_env::trigger_event(std::string name, sol::variadic_args args) {
-  _events.trigger_event(name, args);
+void stage_env::unregister_event(event_id event, handler_id handler) {
+  _events.unregister_event(event, handler);
 }
 
-auto stage_env::register_event(std::string name, sol::protected_function func) -> list_iterator {
-  return _events.register_event(name, func);
+void stage_env::clear_events(event_id event) {
+  _events.clear_events(event);
 }
 
-void stage_env::unregister_event(std::string name, list_iterator event) {
-  _events.unregister_event(name, event);
+void stage_env::queue_event(event_id event, sol::variadic_args args) {
+  if (!_events.is_valid(event)) {
+    return;
+  }
+  const u32 first = static_cast<u32>(_queued_args.size());
+  for (auto arg : args) {
+    _queued_args.push_back(arg.get<sol::object>());
+  }
+  _queued.push_back({event, first, static_cast<u32>(_queued_args.size()) - first});
 }
 
-void stage_env::clear_events(std::string name) {
-  _events.clear_events(name);
+void stage_env::dispatch_events() {
+  OKUU_PROFILE_ZONE("lua::dispatch_events");
+  // Swap first so handlers can queue more without touching what's being dispatched
+  std::swap(_queued, _dispatching);
+  std::swap(_queued_args, _dispatching_args);
+  for (const auto& queued : _dispatching) {
+    const std::span<const sol::object> args{_dispatching_args.data() + queued.first_arg,
+                                            queued.arg_count};
+    _events.trigger_event(queued.event, sol::as_args(args));
+  }
+  _dispatching.clear();
+  _dispatching_args.clear();
 }
 
 } // namespace okuu::lua
@@ -7,8 +7,10 @@
 #include "../stage/stage.hpp"
 
 #include "../util/event.hpp"
+#include "./behavior.hpp"
+#include "./ffi.hpp"
+#include "./task.hpp"
 
-#include <list>
 
 namespace okuu::lua {
 
@@ -36,12 +38,42 @@ private:
 };
 
 class stage_env {
+private:
+  struct queued_event {
+    u32 event;
+    u32 first_arg;
+    u32 arg_count;
+  };
+
+  // Handlers setup_stage_modules() registers on the scene, NULL_HANDLER until then
+  struct scene_handlers {
+    using handler_id = stage::stage_scene::player_hit_event::handler_id;
+    static constexpr handler_id NULL_HANDLER = stage::stage_scene::player_hit_event::NULL_HANDLER;
+
+    handler_id player_hit{NULL_HANDLER};
+    handler_id laser_hit{NULL_HANDLER};
+    handler_id enemy_death{NULL_HANDLER};
+    handler_id graze{NULL_HANDLER};
+    handler_id item_collect{NULL_HANDLER};
+  };
+
 public:
-  using list_iterator = std::list<sol::protected_function>::iterator;
+  using event_bus = util::multi_event_handler<sol::protected_function>;
+  using event_id = event_bus::event_id;
+  using handler_id = event_bus::handler_id;
 
 public:
   stage_env(stage::stage_scene& scene, sol::state&& lua,
-            sol::optional<sol::protected_function>&& stage_setup, sol::coroutine&& stage_run);
+            sol::optional<sol::protected_function>&& stage_setup,
+            sol::protected_function&& stage_run);
+
+  // The scene handlers capture `this`, so the env can't move once setup_stage_modules() ran
+  stage_env(stage_env&&) = default;
+  stage_env& operator=(stage_env&&) = delete;
+
+  // Unregisters the scene handlers and drops the particle descs, the scene can outlive the env on
+  // snapshot restores
+  ~stage_env() noexcept;
 
 public:
   static expect<stage_env> load(const std::string& script_path, stage::stage_scene& scene,
@@ -49,21 +81,62 @@ public:
 
 public:
   void setup_stage_modules();
-  void run_tasks();
+  void run_tasks() { _tasks.run(); }
+  void run_behaviors() { _behaviors.run(); }
+
+  task_scheduler& tasks() { return _tasks; }
+
+  void add_behavior(u64 handle, sol::protected_function func) {
+    _behaviors.add(handle, std::move(func));
+  }
 
-  void trigger_event(std::string name, sol::variadic_args args);
-  list_iterator register_event(std::string name, sol::protected_function func);
-  void unregister_event(std::string name, list_iterator event);
-  void clear_events(std::string name);
+  event_id intern_event(std::string_view name) { return _events.intern(name); }
+
+  ntf::optional<event_id> find_event(std::string_view name) const { return _events.find(name); }
+
+  bool is_valid_event(event_id event) const { return _events.is_valid(event); }
+
+  void trigger_event(event_id event, sol::variadic_args args);
+  handler_id register_event(event_id event, sol::protected_function func);
+  void unregister_event(event_id event, handler_id handler);
+  void clear_events(event_id event);
+
+  // Copies the arguments and holds the event until dispatch_events(), which runs once at the end
+  // of every tick. Events queued while dispatching wait for the next one.
+  void queue_event(event_id event, sol::variadic_args args);
+  void dispatch_events();
 
   stage::stage_scene& scene() { return *_scene; }
 
+  sol::state_view lua() { return _lua; }
+
+  // Copies the pool arrays on the first call of each tick and points the view at the copy, so it
+  // stays put until the next tick whatever gets spawned or killed meanwhile. The FFI prelude copies
+  // the struct out for scripts.
+  const ffi_proj_view& proj_view();
+
+  // Stream for code running outside of tasks, split from the stage stream on first use
+  sol::object& rng() { return _rng; }
+
 private:
   ntf::weak_ptr<stage::stage_scene> _scene;
   sol::state _lua;
   sol::optional<sol::protected_function> _stage_setup;
-  sol::coroutine _stage_run;
-  util::multi_event_handler<sol::protected_function> _events;
+  sol::protected_function _stage_run;
+  event_bus _events;
+  event_id _player_hit_event;
+  event_id _laser_hit_event;
+  event_id _enemy_death_event;
+  event_id _graze_event;
+  event_id _item_collect_event;
+  scene_handlers _scene_handlers;
+  std::vector<queued_event> _queued, _dispatching;
+  std::vector<sol::object> _queued_args, _dispatching_args;
+  behavior_scheduler _behaviors;
+  task_scheduler _tasks;
+  ffi_proj_view _proj_view;
+  std::vector<f32> _proj_view_data; // pos_x, pos_y, vel_x, vel_y back to back
+  sol::object _rng;
 };
 
 } // namespace okuu::lua
@@ -0,0 +1,83 @@
+#include "./task.hpp"
+
+#include "../util/profiler.hpp"
+
+namespace okuu::lua {
+
+task_scheduler::task_scheduler(sol::state_view lua) :
+    _threads{lua}, _tasks{}, _wheel{}, _running{}, _cancel_running{false} {}
+
+auto task_scheduler::spawn(sol::protected_function func, sol::object arg) -> task_handle {
+  sol::thread thread = _threads.acquire();
+  sol::coroutine coro{thread.state(), func};
+  const task_handle handle =
+    _tasks.spawn(std::move(thread), std::move(coro), std::move(arg), 0u, sol::object{});
+  _tasks.at(handle).timer = _wheel.schedule(1u, handle);
+  return handle;
+}
+
+void task_scheduler::cancel(task_handle handle) {
+  if (!_tasks.is_alive(handle)) {
+    return;
+  }
+  // A running task can't be dropped from inside its own coroutine, remove it once it yields.
+  // Handles coming from Lua are short, so compare the slots.
+  if (_running.has_value() &&
+      stage::handle_table::handle_slot(*_running) == stage::handle_table::handle_slot(handle)) {
+    _cancel_running = true;
+    return;
+  }
+  _wheel.cancel(_tasks.at(handle).timer);
+  _remove(handle);
+}
+
+void task_scheduler::run() {
+  OKUU_PROFILE_ZONE("lua::run_tasks");
+  _wheel.advance([this](task_handle handle) { _resume(handle); });
+}
+
+sol::object* task_scheduler::running_rng() {
+  if (!_running.has_value() || !_tasks.is_alive(*_running)) {
+    return nullptr;
+  }
+  return &_tasks.at(*_running).rng;
+}
+
+void task_scheduler::_resume(task_handle handle) {
+  if (!_tasks.is_alive(handle)) {
+    return;
+  }
+
+  OKUU_PROFILE_ZONE("lua::task_resume");
+  u32 sleep = 0u;
+  _running.emplace(handle);
+  _cancel_running = false;
+  {
+    // The task can spawn others while running, don't hold references into the list
+    sol::coroutine coro = _tasks.at(handle).coro;
+    auto res = coro(_tasks.at(handle).arg);
+    if (!res.valid()) {
+      sol::error err = res;
+      logger::error("Error on stage task: {}", err.what());
+    } else if (res.status() == sol::call_status::yielded) {
+      sleep = std::max(res.get<sol::optional<u32>>().value_or(1u), 1u);
+    }
+  }
+  _running.reset();
+
+  if (sleep == 0u || _cancel_running) {
+    _remove(handle);
+    return;
+  }
+  _tasks.at(handle).timer = _wheel.schedule(sleep, handle);
+}
+
+void task_scheduler::_remove(task_handle handle) {
+  auto& task = _tasks.at(handle);
+  task.coro = sol::coroutine{};
+  task.rng = sol::object{};
+  _threads.release(std::move(task.thread));
+  _tasks.kill(handle);
+}
+
+} // namespace okuu::lua
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../stage/stage.hpp"
+#include "../util/timing_wheel.hpp"
+#include "./behavior.hpp"
+
+namespace okuu::lua {
+
+// Independent Lua coroutines resumed from the stage tick. A task sleeps by yielding the number of
+// ticks to wait (stage:yield_ticks() and friends), wake ups go through a timing wheel so only the
+// tasks due in the current tick are touched.
+class task_scheduler {
+public:
+  using task_handle = u64;
+
+private:
+  struct task {
+    using args_type = task;
+
+    sol::thread thread;
+    sol::coroutine coro;
+    sol::object arg; // Passed on every resume
+    util::timing_wheel<task_handle>::timer_id timer;
+    sol::object rng; // Split from the stage stream on first use
+  };
+
+public:
+  explicit task_scheduler(sol::state_view lua);
+
+public:
+  // First resumed in the next call to run()
+  task_handle spawn(sol::protected_function func, sol::object arg);
+  void cancel(task_handle handle);
+  bool is_alive(task_handle handle) const { return _tasks.is_alive(handle); }
+
+  // Advances one tick and resumes every task due
+  void run();
+
+  u32 size() const { return _tasks.size(); }
+
+  // Rng slot of the task being resumed, null outside of tasks
+  sol::object* running_rng();
+
+private:
+  void _resume(task_handle handle);
+  void _remove(task_handle handle);
+
+private:
+  lua_thread_pool _threads;
+  stage::entity_list<task> _tasks;
+  util::timing_wheel<task_handle> _wheel;
+  ntf::optional<task_handle> _running;
+  bool _cancel_running;
+};
+
+} // namespace okuu::lua
@@ -1,153 +1,82 @@
-#include "./lua/stage_env.hpp"
-
-#include "./lua/package.hpp"
+#include "./game.hpp"
+#include "./util/profiler.hpp"
 
 #include <ntfstl/utility.hpp>
 
-namespace okuu {
-
-static constexpr u32 MAX_ENTITIES = render::stage_renderer::DEFAULT_STAGE_INSTANCES;
-
-class game_state {
-public:
-  game_state(std::unique_ptr<assets::asset_bundle>&& assets,
-             std::unique_ptr<stage::stage_scene>&& scene, lua::stage_env&& lua_env);
-
-public:
-  static expect<game_state> load_from_package(const std::string& path, chima::context& chima);
-
-public:
-  void tick();
-  void render(f64 dt, f64 alpha);
-
-private:
-  std::unique_ptr<assets::asset_bundle> _assets;
-  std::unique_ptr<stage::stage_scene> _scene;
-  lua::stage_env _lua_env;
-  f32 _t;
-};
-
-game_state::game_state(std::unique_ptr<assets::asset_bundle>&& assets,
-                       std::unique_ptr<stage::stage_scene>&& scene, lua::stage_env&& lua_env) :
-    _assets{std::move(assets)},
-    _scene{std::move(scene)}, _lua_env{std::move(lua_env)}, _t{0.f} {
-
-  _lua_env.setup_stage_modules(); // Call this AFTER _lua_env has been constructed
-}
-
-expect<game_state> game_state::load_from_package(const std::string& path, chima::context& chima) {
-  sol::state cfg_state;
-  auto cfg = lua::package_cfg::load_config(cfg_state, path);
-  if (!cfg.has_value()) {
-    return {ntf::unexpect, std::move(cfg.error())};
-  }
-
-  auto renderer = okuu::render::stage_renderer::create(MAX_ENTITIES);
-  if (!renderer.has_value()) {
-    return {ntf::unexpect, std::move(renderer.error())};
-  }
-
-  if (cfg->players.size() == 0) {
-    return {ntf::unexpect, "No players defined"};
-  }
-
-  if (cfg->stages.size() == 0) {
-    return {ntf::unexpect, "No stages defined"};
-  }
-
-  auto& stage = cfg->stages[0];
-  auto player_it = std::find_if(cfg->players.begin(), cfg->players.end(),
-                                [](const auto& player) { return player.name == "cirno"; });
-  if (player_it == cfg->players.end()) {
-    return {ntf::unexpect, "No baka defined"};
-  }
-  auto& player = *player_it;
-  const auto make_player = [&](assets::atlas_handle atlas_handle,
-                               const assets::sprite_atlas& atlas) -> stage::player_entity {
-    stage::player_entity::animation_data player_anims;
-    NTF_ASSERT(player_anims.size() == player.anim.size());
-    for (u32 i = 0; const auto& [name, modifier] : player.anim) {
-      auto atlas_anim = atlas.find_animation(name).value();
-      player_anims[i] = {atlas_anim, modifier};
-      ++i;
-    }
+#include <cstring>
 
-    assets::sprite_animator player_animator{atlas, player_anims[0].first};
-    const vec2 initial_pos{0.f, 0.f};
-    return {atlas_handle, initial_pos, std::move(player_anims), std::move(player_animator)};
-  };
-
-  auto assets = std::make_unique<assets::asset_bundle>();
-  const auto put_asset = [&](const std::string& name, const lua::package_cfg::asset_elem& asset) {
-    switch (asset.type) {
-      case assets::asset_type::sprite_atlas: {
-        chima::spritesheet sheet{chima, asset.path.c_str()};
-        auto atlas = assets::sprite_atlas::from_chima(sheet).value();
-        assets->emplace_asset<assets::sprite_atlas>(name, std::move(atlas));
-      } break;
-      default:
-        NTF_UNREACHABLE();
-    }
-  };
-
-  try {
-    for (const auto& [name, asset] : cfg->assets) {
-      logger::info("Loading asset \"{}\"", name);
-      put_asset(name, asset);
-    }
-    logger::info("Loading player \"{}\"", player.name);
-    const auto atlas_handle = assets->find_asset<assets::sprite_atlas>(player.sheet).value();
-    const auto& player_atlas = assets->get_asset(atlas_handle);
+namespace okuu {
 
-    auto scene = std::make_unique<stage::stage_scene>(make_player(atlas_handle, player_atlas),
-                                                      std::move(*renderer));
-    auto lua_env = lua::stage_env::load(stage.script.c_str(), *scene, *assets).value();
+static constexpr u32 CHECKPOINT_TICKS = GAME_UPS;
 
-    return {ntf::in_place, std::move(assets), std::move(scene), std::move(lua_env)};
-  } catch (const std::exception& ex) {
-    return {ntf::unexpect, ex.what()};
-  }
-}
+static fn engine_run(const char* record_path) {
+  auto _rh = okuu::render::init();
 
-void game_state::tick() {
-  auto task_wait_ticks = _scene->task_wait();
-  if (task_wait_ticks == 0) {
-    _lua_env.run_tasks();
-  } else {
-    _scene->task_wait(task_wait_ticks - 1);
+  // Recordings can be replayed later with okuu_headless --input
+  std::unique_ptr<stage::input_source> input = std::make_unique<stage::window_input>();
+  if (record_path) {
+    input = std::make_unique<stage::input_recorder>(std::move(input));
   }
-  _scene->tick();
-}
-
-void game_state::render(f64 dt, f64 alpha) {
-  _t += static_cast<f32>(dt);
-  okuu::render::render_back(_t);
-  _scene->render(dt, alpha, *_assets);
-}
-
-static fn engine_run() {
-  auto _rh = okuu::render::init();
 
   chima::context chima;
-  auto state = okuu::game_state::load_from_package("res/packages/test/config.lua", chima);
+  auto state = okuu::game_state::load_from_package("res/packages/test/config.lua", chima,
+                                                   std::move(input));
   if (!state.has_value()) {
     okuu::logger::error("Failed to load stage: {}", state.error());
     return;
   }
 
+  // Practice restarts, R goes back to the last checkpoint. Right after a restore the checkpoint
+  // takes a while to get ready again, the restart waits for it instead of stalling the tick.
+  bool restart_held = false;
+  bool restart_pending = false;
+
   auto loop = ntf::overload{
-    [&](double dt, double alpha) { state->render(dt, alpha); },
-    [&](u32) { state->tick(); },
+    [&](double dt, double alpha) {
+      OKUU_PROFILE_ZONE("engine::render");
+      state->render(dt, alpha);
+    },
+    [&](u32) {
+      OKUU_PROFILE_ZONE("engine::tick");
+      const bool restart =
+        render::window().poll_key(shogle::win_key::r) == shogle::win_action::press;
+      restart_pending = restart_pending || (restart && !restart_held);
+      restart_held = restart;
+      if (restart_pending && state->checkpoint_ready()) {
+        restart_pending = false;
+        auto tick = state->restore_checkpoint();
+        if (!tick.has_value()) {
+          logger::error("Failed to restore checkpoint: {}", tick.error());
+        }
+      }
+
+      state->tick();
+      // Not while a restart waits, it should land on the checkpoint before R was pressed
+      if (!restart_pending && state->ticks() % CHECKPOINT_TICKS == 0u) {
+        state->checkpoint();
+      }
+    },
   };
   shogle::render_loop(okuu::render::window(), okuu::render::shogle_ctx(), okuu::GAME_UPS, loop);
+
+  if (record_path) {
+    static_cast<stage::input_recorder&>(state->input()).save(record_path);
+  }
+  if (util::profiler::is_enabled()) {
+    util::profiler::dump("okuu_trace.json");
+  }
 }
 
 } // namespace okuu
 
-int main() {
+int main(int argc, char* argv[]) {
   ntf::logger::set_level(ntf::log_level::verbose);
+  const char* record_path = nullptr;
+  if (argc > 2 && std::strcmp(argv[1], "--record") == 0) {
+    record_path = argv[2];
+  }
   try {
-    okuu::engine_run();
+    okuu::engine_run(record_path);
   } catch (std::exception& ex) {
     ntf::logger::error("Caught {}", ex.what());
   } catch (...) {
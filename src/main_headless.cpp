@@ -0,0 +1,197 @@
+#include "./game.hpp"
+#include "./util/profiler.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+namespace okuu {
+
+namespace {
+
+struct headless_args {
+  std::string package{"res/packages/test/config.lua"};
+  u32 ticks{secs_to_ticks(60.f)};
+  ntf::optional<std::string> input_path;
+  ntf::optional<std::string> record_path;
+  ntf::optional<std::string> trace_path;
+  u32 snapshot_ticks{0u}; // Zero disables them
+};
+
+fn parse_args(int argc, char* argv[]) -> expect<headless_args> {
+  headless_args args;
+  for (int i = 1; i < argc; ++i) {
+    const auto next = [&]() -> const char* { return i + 1 < argc ? argv[++i] : nullptr; };
+    const char* arg = argv[i];
+    if (std::strcmp(arg, "--ticks") == 0) {
+      const char* val = next();
+      if (!val) {
+        return {ntf::unexpect, "Missing value for --ticks"};
+      }
+      args.ticks = static_cast<u32>(std::strtoul(val, nullptr, 10));
+    } else if (std::strcmp(arg, "--input") == 0) {
+      const char* val = next();
+      if (!val) {
+        return {ntf::unexpect, "Missing value for --input"};
+      }
+      args.input_path.emplace(val);
+    } else if (std::strcmp(arg, "--record") == 0) {
+      const char* val = next();
+      if (!val) {
+        return {ntf::unexpect, "Missing value for --record"};
+      }
+      args.record_path.emplace(val);
+    } else if (std::strcmp(arg, "--trace") == 0) {
+      const char* val = next();
+      if (!val) {
+        return {ntf::unexpect, "Missing value for --trace"};
+      }
+      args.trace_path.emplace(val);
+    } else if (std::strcmp(arg, "--snapshot-secs") == 0) {
+      const char* val = next();
+      if (!val) {
+        return {ntf::unexpect, "Missing value for --snapshot-secs"};
+      }
+      args.snapshot_ticks = secs_to_ticks(std::strtof(val, nullptr));
+    } else {
+      args.package = arg;
+    }
+  }
+  return {ntf::in_place, std::move(args)};
+}
+
+fn make_input(const headless_args& args) -> expect<std::unique_ptr<stage::input_source>> {
+  std::unique_ptr<stage::input_source> input;
+  if (args.input_path.has_value()) {
+    auto recorded = stage::recorded_input::load(*args.input_path);
+    if (!recorded.has_value()) {
+      return {ntf::unexpect, std::move(recorded.error())};
+    }
+    input = std::make_unique<stage::recorded_input>(std::move(*recorded));
+  } else {
+    // Nobody at the keyboard, the player just stands still
+    input = std::make_unique<stage::scripted_input>(std::vector<stage::scripted_input::entry>{});
+  }
+
+  if (args.record_path.has_value()) {
+    input = std::make_unique<stage::input_recorder>(std::move(input));
+  }
+  return {ntf::in_place, std::move(input)};
+}
+
+fn headless_run(const headless_args& args) {
+  auto input = make_input(args);
+  if (!input.has_value()) {
+    logger::error("Failed to load input: {}", input.error());
+    return;
+  }
+
+  chima::context chima;
+  auto state = game_state::load_from_package(args.package, chima, std::move(*input), true);
+  if (!state.has_value()) {
+    logger::error("Failed to load stage: {}", state.error());
+    return;
+  }
+
+  // No frame pacing, tick as fast as the simulation allows
+  using clock = std::chrono::steady_clock;
+  const auto secs_since = [](clock::time_point from) {
+    return std::chrono::duration<f64>(clock::now() - from).count();
+  };
+
+  // Checkpoints and snapshots both get taken, timed apart. Checkpoints are what the game uses for
+  // restarts, serialized snapshots are only needed to store the state somewhere.
+  stage::stage_snapshot snapshot;
+  u32 snapshot_count = 0u;
+  f64 snapshot_total = 0.0, snapshot_max = 0.0;
+  f64 checkpoint_total = 0.0, checkpoint_max = 0.0;
+  const auto start = clock::now();
+  for (u32 i = 0; i < args.ticks; ++i) {
+    OKUU_PROFILE_ZONE("engine::tick");
+    state->tick();
+    if (args.snapshot_ticks > 0u && state->ticks() % args.snapshot_ticks == 0u) {
+      const auto checkpoint_start = clock::now();
+      state->checkpoint();
+      const f64 checkpoint_time = secs_since(checkpoint_start);
+      checkpoint_total += checkpoint_time;
+      checkpoint_max = std::max(checkpoint_max, checkpoint_time);
+
+      const auto snap_start = clock::now();
+      snapshot = state->take_snapshot();
+      const f64 snap_time = secs_since(snap_start);
+      snapshot_total += snap_time;
+      snapshot_max = std::max(snapshot_max, snap_time);
+      ++snapshot_count;
+    }
+  }
+  const f64 elapsed = secs_since(start) - snapshot_total - checkpoint_total;
+
+  const f64 tps = elapsed > 0.0 ? static_cast<f64>(args.ticks) / elapsed : 0.0;
+  logger::info("Ran {} ticks in {:.3f}s ({:.1f} ticks/s, {:.1f}x realtime)", args.ticks, elapsed,
+               tps, tps / static_cast<f64>(GAME_UPS));
+  logger::info("Alive projectiles: {}", state->scene().get_projectiles().size());
+
+  if (snapshot_count > 0u) {
+    // Both have a 1ms budget, they run inside the tick
+    logger::info("Took {} checkpoints, {:.3f}ms avg, {:.3f}ms max (target 1ms)", snapshot_count,
+                 checkpoint_total * 1e3 / snapshot_count, checkpoint_max * 1e3);
+    logger::info("Took {} snapshots, {:.3f}ms avg, {:.3f}ms max, last one {} KiB with {}/{} "
+                 "pages shared",
+                 snapshot_count, snapshot_total * 1e3 / snapshot_count, snapshot_max * 1e3,
+                 snapshot.size() / 1024u, snapshot.shared_pages(), snapshot.page_count());
+
+    // The standby replays the last interval in the background, that part isn't on the tick
+    const auto ready_start = clock::now();
+    while (!state->checkpoint_ready()) {
+      std::this_thread::sleep_for(std::chrono::milliseconds{1});
+    }
+    logger::info("Checkpoint standby caught up after {:.3f}ms", secs_since(ready_start) * 1e3);
+
+    const auto checkpoint_start = clock::now();
+    auto restored = state->restore_checkpoint();
+    if (!restored.has_value()) {
+      logger::error("Failed to restore checkpoint: {}", restored.error());
+    } else {
+      logger::info("Restored checkpoint at tick {} in {:.3f}ms (target 1ms)", *restored,
+                   secs_since(checkpoint_start) * 1e3);
+    }
+  }
+
+  if (args.record_path.has_value()) {
+    auto& recorder = static_cast<stage::input_recorder&>(state->input());
+    if (recorder.save(*args.record_path)) {
+      logger::info("Saved {} ticks of input to \"{}\"", recorder.states().size(),
+                   *args.record_path);
+    }
+  }
+
+  if (args.trace_path.has_value()) {
+    if (!util::profiler::is_enabled()) {
+      logger::warning("Built without OKUU_ENABLE_PROFILER, the trace will be empty");
+    }
+    util::profiler::dump(*args.trace_path);
+  }
+}
+
+} // namespace
+
+} // namespace okuu
+
+int main(int argc, char* argv[]) {
+  ntf::logger::set_level(ntf::log_level::info);
+  auto args = okuu::parse_args(argc, argv);
+  if (!args.has_value()) {
+    ntf::logger::error("{}", args.error());
+    ntf::logger::info("Usage: okuu_headless [package] [--ticks N] [--input file] [--record file] "
+                      "[--trace file] [--snapshot-secs S]");
+    return 1;
+  }
+
+  try {
+    okuu::headless_run(*args);
+  } catch (std::exception& ex) {
+    ntf::logger::error("Caught {}", ex.what());
+  } catch (...) {
+    ntf::logger::error("Caught (...)");
+  }
+}
@@ -9,6 +9,7 @@ struct base_pipelines {
   shogle::pipeline viewport;
   shogle::pipeline sprite;
   shogle::pipeline back;
+  shogle::pipeline laser;
 };
 
 expect<base_pipelines> init_pipelines(shogle::context_view ctx);
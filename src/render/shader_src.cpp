@@ -87,6 +87,129 @@ void main() {
 
 )glsl";
 
+constexpr std::string_view vert_laser = R"glsl(
+#version 460 core
+
+layout (location = 0) in vec3 att_coords;
+layout (location = 1) in vec3 att_normals;
+layout (location = 2) in vec2 att_texcoords;
+
+out VS_OUT {
+  vec2 tex_coord;
+  flat int instance;
+} vs_out;
+
+struct laser_segment_data {
+  float prev_x, prev_y;
+  float start_x, start_y;
+  float end_x, end_y;
+  float next_x, next_y;
+  float width;
+  float u_start, u_end;
+  float uv_scale_x;
+  float uv_scale_y;
+  float uv_offset_x;
+  float uv_offset_y;
+  float color_r;
+  float color_g;
+  float color_b;
+  float color_a;
+  int sampler;
+  int ticks;
+};
+
+layout (std430, binding = 3) buffer laser_vert {
+  laser_segment_data data[];
+};
+
+uniform mat4 view;
+uniform mat4 proj;
+
+vec2 seg_normal(vec2 a, vec2 b) {
+  vec2 dir = b - a;
+  float len = length(dir);
+  return len > 0.0 ? vec2(-dir.y, dir.x)/len : vec2(0.0, 1.0);
+}
+
+// Averaged with the neighbour, so both segments place the shared corners at the same spot
+vec2 joint_normal(vec2 normal, vec2 other) {
+  vec2 sum = normal + other;
+  float len = length(sum);
+  return len > 0.001 ? sum/len : normal;
+}
+
+void main() {
+  laser_segment_data seg = data[gl_InstanceID];
+  vec2 prev = vec2(seg.prev_x, seg.prev_y);
+  vec2 start = vec2(seg.start_x, seg.start_y);
+  vec2 end = vec2(seg.end_x, seg.end_y);
+  vec2 next = vec2(seg.next_x, seg.next_y);
+
+  // The quad gets stretched from start to end along x, across the width along y
+  float t = att_texcoords.x;
+  vec2 normal = seg_normal(start, end);
+  vec2 side = t < 0.5 ? joint_normal(normal, seg_normal(prev, start))
+                      : joint_normal(normal, seg_normal(end, next));
+  vec2 pos = mix(start, end, t) + side*(att_texcoords.y - 0.5)*seg.width;
+
+  vs_out.tex_coord.x = mix(seg.u_start, seg.u_end, t)*seg.uv_scale_x + seg.uv_offset_x;
+  vs_out.tex_coord.y = att_texcoords.y*seg.uv_scale_y + seg.uv_offset_y;
+
+  gl_Position = proj * view * vec4(pos, 0.0f, 1.0f);
+  vs_out.instance = gl_InstanceID;
+}
+
+)glsl";
+
+constexpr std::string_view frag_laser = R"glsl(
+#version 460 core
+
+out vec4 frag_color;
+
+in VS_OUT {
+  vec2 tex_coord;
+  flat int instance;
+} fs_in;
+
+struct laser_segment_data {
+  float prev_x, prev_y;
+  float start_x, start_y;
+  float end_x, end_y;
+  float next_x, next_y;
+  float width;
+  float u_start, u_end;
+  float uv_scale_x;
+  float uv_scale_y;
+  float uv_offset_x;
+  float uv_offset_y;
+  float color_r;
+  float color_g;
+  float color_b;
+  float color_a;
+  int sampler;
+  int ticks;
+};
+
+layout (std430, binding = 3) buffer laser_vert {
+  laser_segment_data data[];
+};
+
+uniform sampler2D samplers[8];
+
+void main() {
+  laser_segment_data seg = data[fs_in.instance];
+  vec4 color = vec4(seg.color_r, seg.color_g, seg.color_b, seg.color_a);
+  vec4 out_color = color*texture(samplers[seg.sampler], fs_in.tex_coord);
+
+  if (out_color.a < 0.1) {
+    discard;
+  }
+
+  frag_color = out_color;
+}
+
+)glsl";
+
 constexpr std::string_view vert_common = R"glsl(
 #version 460 core
 
@@ -236,6 +359,9 @@ expect<base_pipelines> init_pipelines(shogle::context_view ctx) {
 
   auto frag_back_shader = shogle::fragment_shader::create(ctx, {frag_back}).value();
 
+  auto laser_vert_shader = shogle::vertex_shader::create(ctx, {vert_laser}).value();
+  auto laser_frag_shader = shogle::fragment_shader::create(ctx, {frag_laser}).value();
+
   auto pip_vp = make_pip(ctx, vert_common_shader, frag_viewport_shader, attribs);
   if (!pip_vp) {
     return {ntf::unexpect, std::move(pip_vp.error())};
@@ -251,7 +377,13 @@ expect<base_pipelines> init_pipelines(shogle::context_view ctx) {
     return {ntf::unexpect, std::move(pip_back.error())};
   }
 
-  return {ntf::in_place, std::move(*pip_vp), std::move(*pip_sprite), std::move(*pip_back)};
+  auto pip_laser = make_pip(ctx, laser_vert_shader, laser_frag_shader, attribs);
+  if (!pip_laser) {
+    return {ntf::unexpect, std::move(pip_laser.error())};
+  }
+
+  return {ntf::in_place, std::move(*pip_vp), std::move(*pip_sprite), std::move(*pip_back),
+          std::move(*pip_laser)};
 }
 
 } // namespace okuu::render
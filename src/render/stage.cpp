@@ -1,5 +1,6 @@
 #include "./stage.hpp"
 #include "./instance.hpp"
+#include "../util/profiler.hpp"
 #include <ntfstl/utility.hpp>
 
 namespace okuu::render {
@@ -92,12 +93,15 @@ void render_viewport(stage_viewport& viewport, shogle::framebuffer_view fb) {
   });
 }
 
-stage_renderer::stage_renderer(u32 instances, stage_viewport&& viewport,
+stage_renderer::stage_renderer(u32 instances, u32 laser_segments, stage_viewport&& viewport,
                                shogle::shader_storage_buffer&& sprite_vert_buffer,
-                               shogle::shader_storage_buffer&& sprite_frag_buffer) :
+                               shogle::shader_storage_buffer&& sprite_frag_buffer,
+                               shogle::shader_storage_buffer&& laser_buffer) :
     _viewport{std::move(viewport)}, _sprite_vert_buffer{std::move(sprite_vert_buffer)},
-    _sprite_frag_buffer{std::move(sprite_frag_buffer)}, _tex_binds{}, _sprite_buffer_binds{},
-    _active_texes{0u}, _max_instances{instances}, _sprite_instances{0} {
+    _sprite_frag_buffer{std::move(sprite_frag_buffer)}, _laser_buffer{std::move(laser_buffer)},
+    _tex_binds{}, _sprite_buffer_binds{}, _laser_buffer_bind{}, _active_texes{0u},
+    _max_instances{instances}, _sprite_instances{0}, _max_laser_segments{laser_segments},
+    _laser_segments{0u}, _dropped_instances{0u}, _warned_full{false} {
 
   auto& vert_bind = _sprite_buffer_binds[SHADER_VERTEX_BIND];
   vert_bind.buffer = _sprite_vert_buffer;
@@ -111,35 +115,57 @@ stage_renderer::stage_renderer(u32 instances, stage_viewport&& viewport,
   frag_bind.offset = 0u;
   frag_bind.size = _sprite_frag_buffer.size();
 
+  _laser_buffer_bind.buffer = _laser_buffer;
+  _laser_buffer_bind.binding = LASER_BUFFER_BINDING;
+  _laser_buffer_bind.offset = 0u;
+  _laser_buffer_bind.size = _laser_buffer.size();
+
   reset_instances();
 }
 
-expect<stage_renderer> stage_renderer::create(u32 instances) {
+expect<stage_renderer> stage_renderer::create(u32 instances, u32 laser_segments) {
   auto viewport = stage_viewport::create(600, 700, 640, 360).value();
   auto vert_buffer = create_ssbo(instances * sizeof(sprite_vertex_data)).value();
   auto frag_buffer = create_ssbo(instances * sizeof(sprite_fragment_data)).value();
-  return {ntf::in_place, instances, std::move(viewport), std::move(vert_buffer),
-          std::move(frag_buffer)};
+  auto laser_buffer = create_ssbo(laser_segments * sizeof(laser_segment_data)).value();
+  return {ntf::in_place,
+          instances,
+          laser_segments,
+          std::move(viewport),
+          std::move(vert_buffer),
+          std::move(frag_buffer),
+          std::move(laser_buffer)};
 }
 
-void stage_renderer::enqueue_sprite(const sprite_render_data& sprite_data) {
-  NTF_ASSERT(_sprite_instances < _max_instances); // fix this later
-
-  const auto setup_sprite_samplers = [&]() -> i32 {
-    u32 i = 0;
-    for (; i < _active_texes; ++i) {
-      auto& tex = _tex_binds[i];
-      NTF_ASSERT(tex.texture != nullptr);
-      if (tex.texture == sprite_data.texture.get()) {
-        return static_cast<i32>(i);
-      }
+i32 stage_renderer::_sampler_for(shogle::texture2d_view texture) {
+  u32 i = 0;
+  for (; i < _active_texes; ++i) {
+    auto& tex = _tex_binds[i];
+    NTF_ASSERT(tex.texture != nullptr);
+    if (tex.texture == texture.get()) {
+      return static_cast<i32>(i);
     }
+  }
 
-    NTF_ASSERT(i != _tex_binds.size(), "Over the texture binding limit :c");
-    _tex_binds[i].texture = sprite_data.texture;
-    ++_active_texes;
-    return static_cast<i32>(i);
-  };
+  NTF_ASSERT(i != _tex_binds.size(), "Over the texture binding limit :c");
+  _tex_binds[i].texture = texture;
+  ++_active_texes;
+  return static_cast<i32>(i);
+}
+
+void stage_renderer::_drop_instances(u32 count) {
+  if (!_warned_full) {
+    logger::warning("Stage instance buffers full, dropping what doesn't fit");
+    _warned_full = true;
+  }
+  _dropped_instances += count;
+}
+
+void stage_renderer::enqueue_sprite(const sprite_render_data& sprite_data) {
+  if (_sprite_instances >= _max_instances) {
+    _drop_instances(1u);
+    return;
+  }
 
   const sprite_vertex_data vert_data{
     .transform = sprite_data.transform,
@@ -157,7 +183,7 @@ void stage_renderer::enqueue_sprite(const sprite_render_data& sprite_data) {
     .color_g = sprite_data.color.g,
     .color_b = sprite_data.color.b,
     .color_a = sprite_data.color.a,
-    .sampler = setup_sprite_samplers(),
+    .sampler = _sampler_for(sprite_data.texture),
     .ticks = static_cast<i32>(sprite_data.ticks),
   };
   _sprite_frag_buffer.upload(frag_data, _sprite_instances * sizeof(frag_data));
@@ -165,11 +191,68 @@ void stage_renderer::enqueue_sprite(const sprite_render_data& sprite_data) {
   ++_sprite_instances;
 }
 
+void stage_renderer::enqueue_laser(const laser_render_data& laser_data) {
+  const auto& points = laser_data.points;
+  NTF_ASSERT(points.size() >= 2u);
+  const u32 segments = static_cast<u32>(points.size() - 1u);
+  if (_laser_segments + segments > _max_laser_segments) {
+    // A partial strip would look wrong, the whole laser goes
+    _drop_instances(segments);
+    return;
+  }
+
+  // The texture follows the length of the strip, so uneven trails don't squash it
+  f32 total = 0.f;
+  for (u32 i = 0; i < segments; ++i) {
+    total += glm::length(points[i + 1u] - points[i]);
+  }
+  const f32 inv_total = total > 0.f ? 1.f / total : 0.f;
+
+  const i32 sampler = _sampler_for(laser_data.texture);
+  f32 along = 0.f;
+  for (u32 i = 0; i < segments; ++i) {
+    const vec2 start = points[i];
+    const vec2 end = points[i + 1u];
+    // Both ends get a made up neighbour in line with the segment, so they stay square
+    const vec2 prev = i > 0u ? points[i - 1u] : (start * 2.f) - end;
+    const vec2 next = i + 1u < segments ? points[i + 2u] : (end * 2.f) - start;
+    const f32 len = glm::length(end - start);
+    const laser_segment_data seg_data{
+      .prev_x = prev.x,
+      .prev_y = prev.y,
+      .start_x = start.x,
+      .start_y = start.y,
+      .end_x = end.x,
+      .end_y = end.y,
+      .next_x = next.x,
+      .next_y = next.y,
+      .width = laser_data.width,
+      .u_start = along * inv_total,
+      .u_end = (along + len) * inv_total,
+      .uv_scale_x = laser_data.uvs.x_lin,
+      .uv_scale_y = laser_data.uvs.y_lin,
+      .uv_offset_x = laser_data.uvs.x_con,
+      .uv_offset_y = laser_data.uvs.y_con,
+      .color_r = laser_data.color.r,
+      .color_g = laser_data.color.g,
+      .color_b = laser_data.color.b,
+      .color_a = laser_data.color.a,
+      .sampler = sampler,
+      .ticks = static_cast<i32>(laser_data.ticks),
+    };
+    _laser_buffer.upload(seg_data, (_laser_segments + i) * sizeof(seg_data));
+    along += len;
+  }
+  _laser_segments += segments;
+}
+
 void stage_renderer::reset_instances() {
   // Reset texture bindings
   std::memset(_tex_binds.data(), 0, _tex_binds.size());
   _active_texes = 0u;
   _sprite_instances = 0u;
+  _laser_segments = 0u;
+  _dropped_instances = 0u;
 }
 
 ntf::cspan<shogle::texture_binding> stage_renderer::tex_binds() const {
@@ -183,28 +266,33 @@ ntf::cspan<shogle::shader_binding> stage_renderer::shader_binds() const {
   return {_sprite_buffer_binds.data(), _sprite_buffer_binds.size()};
 }
 
-void render_stage(stage_renderer& stage) {
-  NTF_ASSERT(g_renderer.has_value());
-  auto& quad = g_renderer->quad;
-  auto& pipeline = g_renderer->pips.sprite;
+namespace {
 
+// Writes MAX_SHADER_SAMPLERS consts to out
+void fill_sampler_consts(shogle::pipeline& pipeline, ntf::cspan<shogle::texture_binding> tex_binds,
+                         shogle::uniform_const* out) {
   const u32 sampler0 = pipeline.uniform_location("samplers[0]").value();
-  const u32 locs[stage_renderer::MAX_SHADER_SAMPLERS] = {
-    sampler0,     sampler0 + 1, sampler0 + 2, sampler0 + 3,
-    sampler0 + 4, sampler0 + 5, sampler0 + 6, sampler0 + 7,
-  };
-
-  shogle::uniform_const sampler_data[stage_renderer::MAX_SHADER_SAMPLERS];
-  auto tex_binds = stage.tex_binds();
   u32 i = 0;
   for (const auto& bind : tex_binds) {
-    sampler_data[i] = shogle::format_uniform_const(locs[i], (int)bind.sampler);
+    out[i] = shogle::format_uniform_const(sampler0 + i, (int)bind.sampler);
     ++i;
   }
   while (i < stage_renderer::MAX_SHADER_SAMPLERS) {
-    sampler_data[i] = shogle::format_uniform_const(locs[i], (int)0);
+    out[i] = shogle::format_uniform_const(sampler0 + i, (int)0);
     ++i;
   }
+}
+
+} // namespace
+
+void render_stage(stage_renderer& stage) {
+  NTF_ASSERT(g_renderer.has_value());
+  OKUU_PROFILE_ZONE("render::render_stage");
+  auto& quad = g_renderer->quad;
+  auto& pipeline = g_renderer->pips.sprite;
+
+  shogle::uniform_const sampler_data[stage_renderer::MAX_SHADER_SAMPLERS];
+  fill_sampler_consts(pipeline, stage.tex_binds(), sampler_data);
 
   auto& vp = stage.viewport();
   g_renderer->ctx.submit_render_command({
@@ -224,6 +312,36 @@ void render_stage(stage_renderer& stage) {
     .render_callback = {},
   });
 
+  // Every segment of every laser in one instanced draw, the camera goes through uniforms since
+  // it's the same for all of them
+  if (stage.laser_segments() > 0u) {
+    auto& laser_pipeline = g_renderer->pips.laser;
+    shogle::uniform_const laser_data[stage_renderer::MAX_SHADER_SAMPLERS + 2u];
+    fill_sampler_consts(laser_pipeline, stage.tex_binds(), laser_data);
+    const mat4 view = vp.view();
+    const mat4 proj = vp.proj();
+    laser_data[stage_renderer::MAX_SHADER_SAMPLERS] =
+      shogle::format_uniform_const(laser_pipeline.uniform_location("view").value(), view);
+    laser_data[stage_renderer::MAX_SHADER_SAMPLERS + 1u] =
+      shogle::format_uniform_const(laser_pipeline.uniform_location("proj").value(), proj);
+    g_renderer->ctx.submit_render_command({
+      .target = vp.framebuffer(),
+      .pipeline = laser_pipeline,
+      .buffers = quad.bindings(stage.laser_binds()),
+      .textures = stage.tex_binds(),
+      .consts = laser_data,
+      .opts =
+        {
+          .vertex_count = 6,
+          .vertex_offset = 0,
+          .index_offset = 0,
+          .instances = stage.laser_segments(),
+        },
+      .sort_group = 0,
+      .render_callback = {},
+    });
+  }
+
   stage.reset_instances();
 }
 
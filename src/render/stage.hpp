@@ -49,9 +49,14 @@ private:
     SHADER_BIND_COUNT,
   };
 
+  static constexpr u32 LASER_BUFFER_BINDING = 3u;
+
 public:
   static constexpr size_t MAX_SHADER_SAMPLERS = 8u;
   static constexpr u32 DEFAULT_STAGE_INSTANCES = 1024u;
+  // Enough for a screen full of bullets plus items and a whole cancel burst of particles
+  static constexpr u32 MAX_STAGE_INSTANCES = 65536u;
+  static constexpr u32 DEFAULT_LASER_SEGMENTS = 4096u;
 
   struct sprite_vertex_data {
     mat4 transform;
@@ -80,35 +85,84 @@ public:
     color4 color;
   };
 
+  // One instance per laser segment. The neighbouring points let the vertex shader join the
+  // segments, so the whole laser ends up as one strip.
+  struct laser_segment_data {
+    f32 prev_x, prev_y;
+    f32 start_x, start_y;
+    f32 end_x, end_y;
+    f32 next_x, next_y;
+    f32 width;
+    f32 u_start, u_end;
+    f32 uv_scale_x;
+    f32 uv_scale_y;
+    f32 uv_offset_x;
+    f32 uv_offset_y;
+    f32 color_r;
+    f32 color_g;
+    f32 color_b;
+    f32 color_a;
+    i32 sampler;
+    i32 ticks;
+  };
+
+  struct laser_render_data {
+    ntf::cspan<vec2> points; // At least two, the sprite gets stretched along all of them
+    f32 width;
+    shogle::texture2d_view texture;
+    u32 ticks;
+    sprite_uvs uvs;
+    color4 color;
+  };
+
 public:
-  stage_renderer(u32 instances, stage_viewport&& viewport,
+  stage_renderer(u32 instances, u32 laser_segments, stage_viewport&& viewport,
                  shogle::shader_storage_buffer&& sprite_vert_buffer,
-                 shogle::shader_storage_buffer&& sprite_frag_buffer);
+                 shogle::shader_storage_buffer&& sprite_frag_buffer,
+                 shogle::shader_storage_buffer&& laser_buffer);
 
 public:
-  static expect<stage_renderer> create(u32 instances = DEFAULT_STAGE_INSTANCES);
+  static expect<stage_renderer> create(u32 instances = DEFAULT_STAGE_INSTANCES,
+                                       u32 laser_segments = DEFAULT_LASER_SEGMENTS);
 
 public:
   stage_viewport& viewport() { return _viewport; }
 
   ntf::cspan<shogle::texture_binding> tex_binds() const;
   ntf::cspan<shogle::shader_binding> shader_binds() const;
+  ntf::cspan<shogle::shader_binding> laser_binds() const { return {&_laser_buffer_bind, 1u}; }
 
 public:
   u32 sprite_instances() const { return _sprite_instances; }
 
+  u32 laser_segments() const { return _laser_segments; }
+
+  // Instances that didn't fit since the last reset, they get dropped instead of drawn
+  u32 dropped_instances() const { return _dropped_instances; }
+
   void reset_instances();
   void enqueue_sprite(const sprite_render_data& sprite_data);
+  void enqueue_laser(const laser_render_data& laser_data);
+
+private:
+  i32 _sampler_for(shogle::texture2d_view texture);
+  void _drop_instances(u32 count);
 
 private:
   stage_viewport _viewport;
   shogle::shader_storage_buffer _sprite_vert_buffer;
   shogle::shader_storage_buffer _sprite_frag_buffer;
+  shogle::shader_storage_buffer _laser_buffer;
   std::array<shogle::texture_binding, MAX_SHADER_SAMPLERS> _tex_binds;
   std::array<shogle::shader_binding, SHADER_BIND_COUNT> _sprite_buffer_binds;
+  shogle::shader_binding _laser_buffer_bind;
   u32 _active_texes;
   u32 _max_instances;
   u32 _sprite_instances;
+  u32 _max_laser_segments;
+  u32 _laser_segments;
+  u32 _dropped_instances;
+  bool _warned_full;
 };
 
 void render_stage(stage_renderer& stage);
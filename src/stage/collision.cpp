@@ -0,0 +1,58 @@
+#include "./collision.hpp"
+
+namespace okuu::stage {
+
+uniform_grid::uniform_grid(vec2 min, vec2 max, real cell_size) :
+    _min{min}, _inv_cell{1.f / cell_size},
+    _cols{std::max(1u, static_cast<u32>(std::ceil((max.x - min.x) / cell_size)))},
+    _rows{std::max(1u, static_cast<u32>(std::ceil((max.y - min.y) / cell_size)))},
+    _max_radius{0.f}, _cell_start((_cols * _rows) + 1u, 0u) {}
+
+std::pair<u32, u32> uniform_grid::_cell_coords(real x, real y) const {
+  const auto clamp_coord = [](real v, u32 count) -> u32 {
+    if (!(v > 0.f)) { // Catches NaN too
+      return 0u;
+    }
+    const u32 c = static_cast<u32>(v);
+    return std::min(c, count - 1u);
+  };
+  return std::make_pair(clamp_coord((x - _min.x) * _inv_cell, _cols),
+                        clamp_coord((y - _min.y) * _inv_cell, _rows));
+}
+
+void uniform_grid::rebuild(const real* xs, const real* ys, const real* radius, u32 count) {
+  const u32 cells = _cols * _rows;
+  std::fill(_cell_start.begin(), _cell_start.end(), 0u);
+  _entries.resize(count);
+  _entity_cell.resize(count);
+
+  real max_radius = 0.f;
+  for (u32 i = 0; i < count; ++i) {
+    const auto [x, y] = _cell_coords(xs[i], ys[i]);
+    const u32 cell = (y * _cols) + x;
+    _entity_cell[i] = cell;
+    ++_cell_start[cell + 1u];
+    if (radius) {
+      max_radius = std::max(max_radius, radius[i]);
+    }
+  }
+  _max_radius = max_radius;
+
+  for (u32 i = 0; i < cells; ++i) {
+    _cell_start[i + 1u] += _cell_start[i];
+  }
+
+  // Scatter using the end of each cell run as a cursor, then walk it back to the start
+  for (u32 i = count; i > 0u; --i) {
+    const u32 idx = i - 1u;
+    const u32 cell = _entity_cell[idx];
+    _entries[--_cell_start[cell + 1u]] = idx;
+  }
+  // _cell_start[c + 1] now points to the start of cell c, shift it back into place
+  for (u32 i = 0; i < cells; ++i) {
+    _cell_start[i] = _cell_start[i + 1u];
+  }
+  _cell_start[cells] = count;
+}
+
+} // namespace okuu::stage
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "../core.hpp"
+
+#include <algorithm>
+
+namespace okuu::stage {
+
+// Uniform spatial grid, rebuilt from scratch every tick with a counting sort so each cell ends up
+// as a contiguous run of entity indices. Points outside of the grid bounds are clamped to the
+// border cells, so queries near the edges still see them.
+class uniform_grid {
+public:
+  uniform_grid(vec2 min, vec2 max, real cell_size);
+
+public:
+  // radius can be null, in which case every entity is treated as a point
+  void rebuild(const real* xs, const real* ys, const real* radius, u32 count);
+
+  // Calls func(u32 idx) for every entity in the cells overlapping the circle, padded with the
+  // biggest entity radius seen on the last rebuild. Candidates still need a narrow phase test.
+  template<typename F>
+  void query_circle(vec2 center, real radius, F&& func) const {
+    if (_entries.empty()) {
+      return;
+    }
+    const real pad = radius + _max_radius;
+    const auto [x0, y0] = _cell_coords(center.x - pad, center.y - pad);
+    const auto [x1, y1] = _cell_coords(center.x + pad, center.y + pad);
+    for (u32 y = y0; y <= y1; ++y) {
+      for (u32 x = x0; x <= x1; ++x) {
+        const u32 cell = (y * _cols) + x;
+        for (u32 i = _cell_start[cell]; i < _cell_start[cell + 1u]; ++i) {
+          std::invoke(func, _entries[i]);
+        }
+      }
+    }
+  }
+
+public:
+  u32 cols() const { return _cols; }
+
+  u32 rows() const { return _rows; }
+
+  real max_radius() const { return _max_radius; }
+
+private:
+  std::pair<u32, u32> _cell_coords(real x, real y) const;
+
+private:
+  vec2 _min;
+  real _inv_cell;
+  u32 _cols, _rows;
+  real _max_radius;
+  std::vector<u32> _cell_start;
+  std::vector<u32> _entries;
+  std::vector<u32> _entity_cell;
+};
+
+inline bool circles_overlap(vec2 a, real ra, vec2 b, real rb) {
+  const real dx = a.x - b.x;
+  const real dy = a.y - b.y;
+  const real r = ra + rb;
+  return (dx * dx) + (dy * dy) <= r * r;
+}
+
+// Capsule around the segment [a, b] against a circle, through the closest point of the segment
+inline bool capsule_circle_overlap(vec2 a, vec2 b, real ra, vec2 center, real rc) {
+  const real abx = b.x - a.x;
+  const real aby = b.y - a.y;
+  const real len2 = (abx * abx) + (aby * aby);
+  real t = 0.f;
+  if (len2 > 0.f) {
+    t = (((center.x - a.x) * abx) + ((center.y - a.y) * aby)) / len2;
+    t = std::clamp(t, 0.f, 1.f);
+  }
+  return circles_overlap({a.x + (abx * t), a.y + (aby * t)}, ra, center, rc);
+}
+
+} // namespace okuu::stage
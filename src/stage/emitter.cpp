@@ -0,0 +1,164 @@
+#include "./emitter.hpp"
+
+#include <numbers>
+
+namespace okuu::stage {
+
+namespace {
+
+real pattern_base_angle(const emitter_args& args) {
+  if (args.shape != emitter_shape::aimed) {
+    return args.angle;
+  }
+  const vec2 dir = args.target - args.proj.pos;
+  if (dir.x == 0.f && dir.y == 0.f) {
+    return args.angle;
+  }
+  return std::atan2(dir.y, dir.x) + args.angle;
+}
+
+} // namespace
+
+u32 emit_pattern(projectile_pool& pool, const emitter_args& args, util::rng_stream& rng) {
+  if (args.count == 0u || args.layers == 0u) {
+    return 0u;
+  }
+
+  // Rings don't repeat the first bullet at 2pi, spreads put one bullet on each end of the arc
+  const real base = pattern_base_angle(args);
+  real first = base;
+  real step = 0.f;
+  if (args.shape == emitter_shape::ring) {
+    step = 2.f * std::numbers::pi_v<real> / static_cast<real>(args.count);
+  } else if (args.count > 1u) {
+    first = base - (args.spread * .5f);
+    step = args.spread / static_cast<real>(args.count - 1u);
+  }
+
+  const bool eased = args.ret < 1.f;
+  const bool jitter = args.angle_jitter != 0.f || args.speed_jitter != 0.f;
+  projectile_args proj = args.proj;
+  for (u32 i = 0; i < args.count; ++i) {
+    const real base_ang = first + (step * static_cast<real>(i));
+    const vec2 base_dir{std::cos(base_ang), std::sin(base_ang)};
+    for (u32 layer = 0; layer < args.layers; ++layer) {
+      vec2 dir = base_dir;
+      real jitter_speed = 0.f;
+      if (jitter) {
+        const real ang = base_ang + rng.range(-args.angle_jitter, args.angle_jitter);
+        dir = {std::cos(ang), std::sin(ang)};
+        jitter_speed = rng.range(-args.speed_jitter, args.speed_jitter);
+      }
+      const real speed =
+        args.speed + (args.speed_step * static_cast<real>(layer)) + jitter_speed;
+      proj.vel = dir * speed;
+      if (eased) {
+        const real end_speed =
+          args.end_speed + (args.speed_step * static_cast<real>(layer)) + jitter_speed;
+        proj.movement = entity_movement::move_interpolated(proj.vel, dir * end_speed, args.ret);
+      } else {
+        proj.movement = entity_movement::move_linear(proj.vel);
+      }
+      pool.spawn(proj);
+    }
+  }
+  return args.count * args.layers;
+}
+
+pattern_emitter::pattern_emitter(periodic_emitter_args args) :
+    _args{args}, _wait{args.delay}, _fired{0u} {}
+
+void pattern_emitter::tick(projectile_pool& pool, vec2 player_pos, util::rng_stream& rng) {
+  if (is_done()) {
+    return;
+  }
+  if (_wait > 0u) {
+    --_wait;
+    return;
+  }
+
+  auto& pattern = _args.pattern;
+  if (pattern.shape == emitter_shape::aimed) {
+    pattern.target = player_pos;
+  }
+  emit_pattern(pool, pattern, rng);
+  pattern.angle += _args.rotation;
+  _wait = _args.period > 0u ? _args.period - 1u : 0u;
+  ++_fired;
+}
+
+void pattern_emitter::save(util::byte_writer& out) const {
+  const auto& pattern = _args.pattern;
+  const auto& proj = pattern.proj;
+  out.write(pattern.shape);
+  out.write(proj.pos);
+  out.write(proj.vel);
+  out.write(proj.scale);
+  out.write(proj.angular_speed);
+  out.write(proj.hitbox);
+  out.write(proj.cull_margin);
+  out.write(proj.sprite);
+  out.write(proj.movement);
+  out.write(proj.analytic);
+  out.write(proj.damage);
+  out.write(pattern.count);
+  out.write(pattern.layers);
+  out.write(pattern.angle);
+  out.write(pattern.spread);
+  out.write(pattern.speed);
+  out.write(pattern.speed_step);
+  out.write(pattern.end_speed);
+  out.write(pattern.ret);
+  out.write(pattern.target);
+  out.write(pattern.angle_jitter);
+  out.write(pattern.speed_jitter);
+  out.write(_args.delay);
+  out.write(_args.period);
+  out.write(_args.shots);
+  out.write(_args.rotation);
+  out.write(_wait);
+  out.write(_fired);
+}
+
+pattern_emitter pattern_emitter::load(util::byte_reader& in) {
+  // Same order as save(), braced init keeps it
+  pattern_emitter emitter{periodic_emitter_args{
+    .pattern =
+      emitter_args{
+        .shape = in.read<emitter_shape>(),
+        .proj =
+          projectile_args{
+            .pos = in.read<vec2>(),
+            .vel = in.read<vec2>(),
+            .scale = in.read<vec2>(),
+            .angular_speed = in.read<real>(),
+            .hitbox = in.read<real>(),
+            .cull_margin = in.read<real>(),
+            .sprite = in.read<entity_sprite>(),
+            .movement = in.read<entity_movement>(),
+            .analytic = in.read<bool>(),
+            .damage = in.read<real>(),
+          },
+        .count = in.read<u32>(),
+        .layers = in.read<u32>(),
+        .angle = in.read<real>(),
+        .spread = in.read<real>(),
+        .speed = in.read<real>(),
+        .speed_step = in.read<real>(),
+        .end_speed = in.read<real>(),
+        .ret = in.read<real>(),
+        .target = in.read<vec2>(),
+        .angle_jitter = in.read<real>(),
+        .speed_jitter = in.read<real>(),
+      },
+    .delay = in.read<u32>(),
+    .period = in.read<u32>(),
+    .shots = in.read<u32>(),
+    .rotation = in.read<real>(),
+  }};
+  in.read(emitter._wait);
+  in.read(emitter._fired);
+  return emitter;
+}
+
+} // namespace okuu::stage
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "./projectile.hpp"
+
+#include "../util/rng.hpp"
+
+namespace okuu::stage {
+
+enum class emitter_shape : u8 {
+  ring = 0, // count bullets evenly spaced around angle
+  spread,   // count bullets across an arc of `spread` radians centered on angle
+  aimed,    // spread centered on the direction to target, angle is an offset from it
+};
+
+// A whole bullet pattern, generated in one go without going through Lua once per bullet
+struct emitter_args {
+  emitter_shape shape;
+  projectile_args proj; // Template for every bullet, pos is the origin. Movement gets replaced.
+  u32 count;            // Bullets per layer
+  u32 layers;           // Stacked copies of the pattern, each one speed_step faster
+  real angle;           // Radians
+  real spread;
+  real speed;
+  real speed_step;
+  real end_speed; // Speed the bullets ease into, only when ret < 1
+  real ret;
+  vec2 target;
+  real angle_jitter; // Each bullet gets up to this much added or removed from its angle
+  real speed_jitter; // Same for the speed, the layer steps stay the same
+};
+
+// Spawns the pattern in the pool, returns how many bullets were spawned. The rng is only drawn
+// from when the pattern has some jitter.
+u32 emit_pattern(projectile_pool& pool, const emitter_args& args, util::rng_stream& rng);
+
+struct periodic_emitter_args {
+  emitter_args pattern;
+  u32 delay;     // Ticks before the first shot
+  u32 period;    // Ticks between shots
+  u32 shots;     // 0 to keep firing until killed
+  real rotation; // Added to the pattern angle after every shot
+};
+
+// Fires a pattern every few ticks, aimed patterns get re-aimed at the player on every shot
+class pattern_emitter {
+public:
+  using args_type = periodic_emitter_args;
+
+public:
+  pattern_emitter(periodic_emitter_args args);
+
+public:
+  void tick(projectile_pool& pool, vec2 player_pos, util::rng_stream& rng);
+
+  bool is_done() const { return _args.shots != 0u && _fired >= _args.shots; }
+
+  void save(util::byte_writer& out) const;
+  static pattern_emitter load(util::byte_reader& in);
+
+  vec2 pos() const { return _args.pattern.proj.pos; }
+
+  pattern_emitter& pos(real x, real y) {
+    _args.pattern.proj.pos = {x, y};
+    return *this;
+  }
+
+  pattern_emitter& angle(real angle) {
+    _args.pattern.angle = angle;
+    return *this;
+  }
+
+  u32 fired() const { return _fired; }
+
+private:
+  periodic_emitter_args _args;
+  u32 _wait;
+  u32 _fired;
+};
+
+} // namespace okuu::stage
@@ -0,0 +1,50 @@
+#include "./enemy.hpp"
+
+namespace okuu::stage {
+
+enemy_entity::enemy_entity(enemy_args args) :
+    _pos{args.pos}, _scale{args.scale}, _hp{args.hp}, _hitbox{args.hitbox},
+    _sprite{args.sprite}, _movement{args.movement} {}
+
+void enemy_entity::tick() {
+  _movement.next_pos(_pos);
+}
+
+bool enemy_entity::damage(real amount) {
+  if (is_dead()) {
+    return false;
+  }
+  _hp -= amount;
+  return is_dead();
+}
+
+mat4 enemy_entity::transform(const render::sprite_uvs& uvs) const {
+  shogle::transform2d<real> t{};
+  f32 ratio = uvs.x_lin / uvs.y_lin;
+  t.pos(_pos).scale(_scale.x * ratio, _scale.y);
+  mat4 mat = t.world();
+  return mat;
+}
+
+void enemy_entity::save(util::byte_writer& out) const {
+  out.write(_pos);
+  out.write(_scale);
+  out.write(_hp);
+  out.write(_hitbox);
+  out.write(_sprite);
+  out.write(_movement);
+}
+
+enemy_entity enemy_entity::load(util::byte_reader& in) {
+  // Same order as save(), braced init keeps it
+  return enemy_entity{enemy_args{
+    .pos = in.read<vec2>(),
+    .scale = in.read<vec2>(),
+    .hp = in.read<real>(),
+    .hitbox = in.read<real>(),
+    .sprite = in.read<entity_sprite>(),
+    .movement = in.read<entity_movement>(),
+  }};
+}
+
+} // namespace okuu::stage
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "./entity.hpp"
+
+namespace okuu::stage {
+
+struct enemy_args {
+  vec2 pos;
+  vec2 scale;
+  real hp;
+  real hitbox; // Against player shots
+  entity_sprite sprite;
+  entity_movement movement;
+};
+
+// Anything the player can shoot down besides bosses. Dead enemies stay in the list until the
+// scene reports them and removes them at the end of the shot pass.
+class enemy_entity {
+public:
+  using args_type = enemy_args;
+
+public:
+  enemy_entity(enemy_args args);
+
+public:
+  void tick();
+
+  // Returns true only on the hit that kills it
+  bool damage(real amount);
+
+  bool is_dead() const { return _hp <= 0.f; }
+
+  mat4 transform(const render::sprite_uvs& uvs) const;
+
+  void save(util::byte_writer& out) const;
+  static enemy_entity load(util::byte_reader& in);
+
+public:
+  vec2 pos() const { return _pos; }
+
+  enemy_entity& pos(real x, real y) {
+    _pos.x = x;
+    _pos.y = y;
+    return *this;
+  }
+
+  real hp() const { return _hp; }
+
+  enemy_entity& hp(real hp) {
+    _hp = hp;
+    return *this;
+  }
+
+  real hitbox() const { return _hitbox; }
+
+  entity_sprite sprite() const { return _sprite; }
+
+  enemy_entity& set_movement(entity_movement movement) {
+    _movement = movement;
+    return *this;
+  }
+
+private:
+  vec2 _pos;
+  vec2 _scale;
+  real _hp;
+  real _hitbox;
+  entity_sprite _sprite;
+  entity_movement _movement;
+};
+
+} // namespace okuu::stage
@@ -3,18 +3,52 @@
 namespace okuu::stage {
 
 entity_movement::entity_movement() noexcept :
-    _vel{}, _acc{}, _ret{}, _attr{}, _attr_p{}, _attr_exp{} {}
+    _vel{}, _acc{}, _ret{}, _attr{}, _attr_p{}, _attr_exp{}, _ext_kind{movement_kind::linear},
+    _params{}, _ticks{0u} {}
 
 entity_movement::entity_movement(vec2 vel, vec2 acc, real ret) noexcept :
-    _vel{vel.x, vel.y}, _acc{acc.x, acc.y}, _ret{ret}, _attr{}, _attr_p{}, _attr_exp{} {}
+    _vel{vel.x, vel.y}, _acc{acc.x, acc.y}, _ret{ret}, _attr{}, _attr_p{}, _attr_exp{},
+    _ext_kind{movement_kind::linear}, _params{}, _ticks{0u} {}
 
 entity_movement::entity_movement(vec2 vel, vec2 acc, real ret, vec2 attr, vec2 attr_p,
                                  real attr_exp) noexcept :
     _vel{vel.x, vel.y},
     _acc{acc.x, acc.y}, _ret{ret}, _attr{attr.x, attr.y}, _attr_p{attr_p.x, attr_p.y},
-    _attr_exp{attr_exp} {}
+    _attr_exp{attr_exp}, _ext_kind{movement_kind::linear}, _params{}, _ticks{0u} {}
 
 void entity_movement::next_pos(vec2& curr_pos) {
+  switch (_ext_kind) {
+    case movement_kind::orbit: {
+      curr_pos = orbit_step(_params.orbit);
+      return;
+    }
+    case movement_kind::wave: {
+      curr_pos += wave_offset(vel(), _params.wave, _ticks + 1u) -
+                  wave_offset(vel(), _params.wave, _ticks);
+      ++_ticks;
+      return;
+    }
+    case movement_kind::path: {
+      curr_pos += path_offset(_params.path, _ticks + 1u) - path_offset(_params.path, _ticks);
+      ++_ticks;
+      return;
+    }
+    case movement_kind::delayed: {
+      if (_ticks < _params.delay.ticks) {
+        ++_ticks;
+        return;
+      }
+      break;
+    }
+    case movement_kind::capped: {
+      curr_pos += vel();
+      const vec2 next = capped_vel(vel(), _params.capped);
+      vel(next.x, next.y);
+      return;
+    }
+    default: break;
+  }
+
   cmplx pos{curr_pos.x, curr_pos.y};
   pos += _vel;
   _vel = _acc + (_ret * _vel);
@@ -33,6 +67,19 @@ void entity_movement::next_pos(vec2& curr_pos) {
   curr_pos.y = pos.imag();
 }
 
+movement_kind entity_movement::kind() const {
+  if (_ext_kind != movement_kind::linear) {
+    return _ext_kind;
+  }
+  if (_attr != cmplx{}) {
+    return movement_kind::attractor;
+  }
+  if (_acc == cmplx{} && _ret == 1.f) {
+    return movement_kind::linear;
+  }
+  return movement_kind::interpolated;
+}
+
 entity_movement entity_movement::move_linear(vec2 vel) {
   return {vel, vec2{0.f}, 1.f};
 }
@@ -54,23 +101,59 @@ entity_movement entity_movement::move_towards(vec2 target, vec2 vel, vec2 attr,
   return {vel, vec2{0.f}, ret, attr, target, 1.f};
 }
 
-projectile_entity::projectile_entity(projectile_args args) :
-    _birth{0}, _ticks{0}, _pos{args.pos}, _scale{args.scale}, _rot{0.f},
-    _angular_speed{args.angular_speed}, _flags{0}, _movement{args.movement}, _sprite{args.sprite},
-    _state_handler{std::move(args.state_handler)} {}
+entity_movement entity_movement::move_orbit(vec2 center, real radius, real angle, real ang_vel,
+                                            real radial_vel) {
+  entity_movement move;
+  move._ext_kind = movement_kind::orbit;
+  move._params.orbit = {center.x, center.y, radius, angle, ang_vel, radial_vel,
+                        orbit_params::NO_PARENT};
+  return move;
+}
 
-void projectile_entity::tick() {
-  _movement.next_pos(_pos);
-  _rot += _angular_speed / (real)GAME_UPS;
-  ++_ticks;
+entity_movement entity_movement::move_orbit_parent(u64 parent, real radius, real angle,
+                                                   real ang_vel, real radial_vel) {
+  entity_movement move = move_orbit(vec2{0.f}, radius, angle, ang_vel, radial_vel);
+  move._params.orbit.parent = parent;
+  return move;
 }
 
-mat4 projectile_entity::transform(const render::sprite_uvs& uvs) const {
-  shogle::basic_transform<real, shogle::trs_transform<real, 2>, 2, true> t{};
-  f32 ratio = uvs.x_lin / uvs.y_lin;
-  t.pos(_pos).scale(_scale.x * ratio, _scale.y).rot(vec3{0.f, 0.f, _rot});
-  mat4 mat = t.world();
-  return mat;
+entity_movement entity_movement::move_wave(vec2 vel, real amp, real freq, real phase) {
+  entity_movement move{vel, vec2{0.f}, 1.f};
+  move._ext_kind = movement_kind::wave;
+  move._params.wave = {amp, freq, phase};
+  return move;
+}
+
+entity_movement entity_movement::move_path(path_curve curve, const std::array<vec2, 4>& points,
+                                           u32 duration) {
+  entity_movement move;
+  move._ext_kind = movement_kind::path;
+  auto& path = move._params.path;
+  for (u32 i = 0; i < 4u; ++i) {
+    path.x[i] = points[i].x;
+    path.y[i] = points[i].y;
+  }
+  path.duration = duration;
+  path.curve = curve;
+  return move;
+}
+
+entity_movement entity_movement::move_delayed(u32 ticks, entity_movement after) {
+  const movement_kind kind = after.kind();
+  if (kind != movement_kind::linear && kind != movement_kind::interpolated) {
+    return after;
+  }
+  entity_movement move{after.vel(), after.acc(), after.ret()};
+  move._ext_kind = movement_kind::delayed;
+  move._params.delay = {ticks};
+  return move;
+}
+
+entity_movement entity_movement::move_capped(vec2 vel, real accel, real cap) {
+  entity_movement move{vel, vec2{0.f}, 1.f};
+  move._ext_kind = movement_kind::capped;
+  move._params.capped = {accel, cap};
+  return move;
 }
 
 boss_entity::boss_entity() : _birth{0}, _ticks{0}, _pos{}, _movement{}, _flags{0}, _sprite{} {}
@@ -105,6 +188,24 @@ entity_sprite boss_entity::sprite() const {
   return *_sprite;
 }
 
+void boss_entity::save(util::byte_writer& out) const {
+  out.write(_birth);
+  out.write(_ticks);
+  out.write(_pos);
+  out.write(_movement);
+  out.write(_flags);
+  out.write(_sprite);
+}
+
+void boss_entity::load(util::byte_reader& in) {
+  in.read(_birth);
+  in.read(_ticks);
+  in.read(_pos);
+  in.read(_movement);
+  in.read(_flags);
+  in.read(_sprite);
+}
+
 sprite_entity::sprite_entity(sprite_args args) :
     _pos{args.pos}, _scale{args.scale}, _rot{args.rot}, _angular_speed{args.angular_speed},
     _sprite{args.sprite}, _movement{args.movement} {}
@@ -121,26 +222,46 @@ void sprite_entity::tick() {
   _movement.next_pos(_pos);
 }
 
-player_entity::player_entity(assets::atlas_handle atlas, vec2 pos, animation_data&& anims,
-                             assets::sprite_animator&& animator) :
+void sprite_entity::save(util::byte_writer& out) const {
+  out.write(_pos);
+  out.write(_scale);
+  out.write(_rot);
+  out.write(_angular_speed);
+  out.write(_sprite);
+  out.write(_movement);
+}
+
+sprite_entity sprite_entity::load(util::byte_reader& in) {
+  // Same order as save(), braced init keeps it
+  return sprite_entity{sprite_args{
+    .pos = in.read<vec2>(),
+    .scale = in.read<vec2>(),
+    .rot = in.read<real>(),
+    .angular_speed = in.read<real>(),
+    .sprite = in.read<entity_sprite>(),
+    .movement = in.read<entity_movement>(),
+  }};
+}
+
+player_entity::player_entity(assets::atlas_handle atlas, vec2 pos, real hitbox,
+                             animation_data&& anims, assets::sprite_animator&& animator) :
     _ticks{0},
-    _pos{pos}, _vel{}, _flags{0}, _animator{std::move(animator)}, _atlas{atlas},
+    _pos{pos}, _vel{}, _hitbox{hitbox}, _flags{0}, _animator{std::move(animator)}, _atlas{atlas},
     _anim_state{animation_state::IDLE}, _anims{std::move(anims)} {}
 
-void player_entity::tick() {
+void player_entity::tick(input_state input) {
   cmplx move_dir{0.f};
-  const auto& win = render::window();
 
   {
-    if (win.poll_key(shogle::win_key::a) == shogle::win_action::press) {
+    if (input & KEY_LEFT) {
       move_dir.real(-1.f);
-    } else if (win.poll_key(shogle::win_key::d) == shogle::win_action::press) {
+    } else if (input & KEY_RIGHT) {
       move_dir.real(1.f);
     }
 
-    if (win.poll_key(shogle::win_key::w) == shogle::win_action::press) {
+    if (input & KEY_UP) {
       move_dir.imag(-1.f);
-    } else if (win.poll_key(shogle::win_key::s) == shogle::win_action::press) {
+    } else if (input & KEY_DOWN) {
       move_dir.imag(1.f);
     }
 
@@ -154,7 +275,7 @@ void player_entity::tick() {
     vel.y = move_dir.imag();
 
     const real slow_speed = .66f;
-    if (win.poll_key(shogle::win_key::l) == shogle::win_action::press) {
+    if (input & KEY_FOCUS) {
       vel.x *= slow_speed;
       vel.y *= slow_speed;
     }
@@ -221,6 +342,24 @@ mat4 player_entity::transform(const render::sprite_uvs& uvs) const {
   return mat;
 }
 
+void player_entity::save(util::byte_writer& out) const {
+  out.write(_ticks);
+  out.write(_pos);
+  out.write(_vel);
+  out.write(_flags);
+  out.write(_anim_state);
+  _animator.save(out);
+}
+
+void player_entity::load(util::byte_reader& in) {
+  in.read(_ticks);
+  in.read(_pos);
+  in.read(_vel);
+  in.read(_flags);
+  in.read(_anim_state);
+  _animator.load(in);
+}
+
 entity_sprite player_entity::sprite() const {
   const auto [idx, uv_modifier] = _animator.frame();
   return {_atlas, idx, uv_modifier};
@@ -4,6 +4,9 @@
 #include "../lua/sol.hpp"
 
 #include "../assets/manager.hpp"
+#include "../util/serialize.hpp"
+#include "./input.hpp"
+#include "./movement.hpp"
 #include <shogle/shogle.hpp>
 
 namespace okuu::stage {
@@ -32,9 +35,26 @@ public:
   static entity_movement move_interplated_simple(vec2 vel, real boost);
   static entity_movement move_towards(vec2 target, vec2 vel, vec2 attr, real ret);
 
+  // Angles in radians, velocities per tick. The parent has to be a projectile handle, other
+  // entities orbit the center they were given.
+  static entity_movement move_orbit(vec2 center, real radius, real angle, real ang_vel,
+                                    real radial_vel = 0.f);
+  static entity_movement move_orbit_parent(u64 parent, real radius, real angle, real ang_vel,
+                                           real radial_vel = 0.f);
+  static entity_movement move_wave(vec2 vel, real amp, real freq, real phase = 0.f);
+  static entity_movement move_path(path_curve curve, const std::array<vec2, 4>& points,
+                                   u32 duration);
+  // Only linear and interpolated movements can be delayed, anything else starts right away
+  static entity_movement move_delayed(u32 ticks, entity_movement after);
+  static entity_movement move_capped(vec2 vel, real accel, real cap);
+
 public:
   void next_pos(vec2& prev_pos);
 
+  movement_kind kind() const;
+
+  const movement_params& params() const { return _params; }
+
 public:
   vec2 vel() const { return {_vel.real(), _vel.imag()}; }
 
@@ -52,12 +72,27 @@ public:
     return *this;
   }
 
+  real ret() const { return _ret; }
+
+  bool has_attractor() const { return _attr != cmplx{}; }
+
+  cmplx attr() const { return _attr; }
+
+  cmplx attr_pos() const { return _attr_p; }
+
+  real attr_exp() const { return _attr_exp; }
+
 private:
   cmplx _vel, _acc;
   real _ret;
 
   cmplx _attr, _attr_p;
   real _attr_exp;
+
+  // Anything but linear overrides the kind guessed from the fields above
+  movement_kind _ext_kind;
+  movement_params _params;
+  u32 _ticks; // For the closed form kinds
 };
 
 struct projectile_args {
@@ -65,56 +100,12 @@ struct projectile_args {
   vec2 vel;
   vec2 scale;
   real angular_speed;
+  real hitbox;
+  real cull_margin; // Extra distance outside the playfield before culling
   entity_sprite sprite;
   entity_movement movement;
-  ntf::optional<sol::coroutine> state_handler;
-};
-
-class projectile_entity {
-public:
-  using args_type = projectile_args;
-
-public:
-  projectile_entity(projectile_args args);
-
-public:
-  void tick();
-
-  mat4 transform(const render::sprite_uvs& uvs) const;
-
-  entity_sprite sprite() const { return _sprite; }
-
-  projectile_entity& movement(entity_movement movement) {
-    _movement = movement;
-    return *this;
-  }
-
-  projectile_entity& angular_speed(real speed) {
-    _angular_speed = speed;
-    return *this;
-  }
-
-  real angular_speed() const { return _angular_speed; }
-
-  vec2 pos() const { return _pos; }
-
-  projectile_entity& pos(f32 x, f32 y) {
-    _pos.x = x;
-    _pos.y = y;
-    return *this;
-  }
-
-private:
-  u32 _birth;
-  u32 _ticks;
-  vec2 _pos;
-  vec2 _scale;
-  real _rot;
-  real _angular_speed;
-  u32 _flags;
-  entity_movement _movement;
-  entity_sprite _sprite;
-  ntf::optional<sol::coroutine> _state_handler;
+  bool analytic; // Evaluate non attractor movements in closed form
+  real damage;   // Only read for player shots
 };
 
 struct boss_args {
@@ -137,6 +128,9 @@ public:
   boss_entity& setup(const boss_args& args);
   boss_entity& disable();
 
+  void save(util::byte_writer& out) const;
+  void load(util::byte_reader& in);
+
   bool is_active() const { return _flags & FLAG_ACTIVE; }
 
 public:
@@ -190,6 +184,9 @@ public:
   mat4 transform(const render::sprite_uvs& uvs) const;
   void tick();
 
+  void save(util::byte_writer& out) const;
+  static sprite_entity load(util::byte_reader& in);
+
   vec2 pos() const { return _pos; }
 
   sprite_entity& pos(real x, real y) {
@@ -236,16 +233,20 @@ public:
   using animation_data = std::array<anim_pair, ANIM_COUNT>;
 
 public:
-  player_entity(assets::atlas_handle atlas, vec2 pos, animation_data&& anims,
+  player_entity(assets::atlas_handle atlas, vec2 pos, real hitbox, animation_data&& anims,
                 assets::sprite_animator&& animator);
 
 public:
-  void tick();
+  void tick(input_state input);
 
   mat4 transform(const render::sprite_uvs& uvs) const;
 
   entity_sprite sprite() const;
 
+  // Only the state that changes while playing, the atlas and animations come from the package
+  void save(util::byte_writer& out) const;
+  void load(util::byte_reader& in);
+
   vec2 pos() const { return _pos; }
 
   player_entity& pos(real x, real y) {
@@ -254,10 +255,13 @@ public:
     return *this;
   }
 
+  real hitbox() const { return _hitbox; }
+
 private:
   u32 _ticks;
   vec2 _pos;
   vec2 _vel;
+  real _hitbox;
   u32 _flags;
   assets::sprite_animator _animator;
   assets::atlas_handle _atlas;
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "../core.hpp"
+#include "../util/serialize.hpp"
+
+namespace okuu::stage {
+
+// Maps stable u64 handles (generation in the upper 32 bits, slot in the lower 32) to dense
+// indices. Slots are recycled through a free list and bump their generation on release, so stale
+// handles stop validating.
+//
+// Slots are kept narrow enough for a handle to be packed in a light userdata (see lua/handle.hpp).
+// That encoding only has room for the low 16 bits of the generation, so it makes "short" handles,
+// flagged in the slot word and compared against the truncated generation. Generations never
+// wrap, a slot whose generation would overflow is retired instead of going back to the free list.
+class handle_table {
+public:
+  using handle_type = u64;
+
+  static constexpr u32 SLOT_BITS = 20u;
+  static constexpr u32 MAX_SLOTS = 1u << SLOT_BITS;
+  static constexpr u32 SLOT_MASK = MAX_SLOTS - 1u;
+  static constexpr u32 SHORT_GEN_BITS = 16u;
+  static constexpr u32 SHORT_GEN_MASK = (1u << SHORT_GEN_BITS) - 1u;
+
+private:
+  static constexpr u32 NULL_SLOT = std::numeric_limits<u32>::max();
+  static constexpr u32 RETIRED_GEN = std::numeric_limits<u32>::max();
+  static constexpr u32 SHORT_HANDLE_FLAG = 1u << 31u;
+
+  struct slot_entry {
+    u32 index; // Dense index when alive, next free slot when dead
+    u32 gen;
+  };
+
+public:
+  handle_table() = default;
+
+public:
+  static constexpr handle_type make_handle(u32 slot, u32 gen) {
+    return (static_cast<u64>(gen) << 32u) | static_cast<u64>(slot);
+  }
+
+  static constexpr handle_type make_short_handle(u32 slot, u32 gen) {
+    return make_handle(slot | SHORT_HANDLE_FLAG, gen & SHORT_GEN_MASK);
+  }
+
+  static constexpr u32 handle_slot(handle_type handle) {
+    return static_cast<u32>(handle) & SLOT_MASK;
+  }
+
+  static constexpr u32 handle_gen(handle_type handle) {
+    return static_cast<u32>(handle >> 32u);
+  }
+
+public:
+  u32 acquire(u32 index) {
+    u32 slot;
+    if (_free_slot != NULL_SLOT) {
+      slot = _free_slot;
+      _free_slot = _slots[slot].index;
+    } else {
+      slot = static_cast<u32>(_slots.size());
+      NTF_ASSERT(slot < MAX_SLOTS);
+      _slots.push_back({NULL_SLOT, 0u});
+    }
+    _slots[slot].index = index;
+    return slot;
+  }
+
+  void release(u32 slot) {
+    NTF_ASSERT(slot < _slots.size());
+    auto& entry = _slots[slot];
+    if (++entry.gen == RETIRED_GEN) {
+      entry.index = NULL_SLOT;
+      return;
+    }
+    entry.index = _free_slot;
+    _free_slot = slot;
+  }
+
+  bool is_valid(handle_type handle) const {
+    const u32 slot = handle_slot(handle);
+    if (slot >= _slots.size() || _slots[slot].gen == RETIRED_GEN) {
+      return false;
+    }
+    const bool is_short = (static_cast<u32>(handle) & SHORT_HANDLE_FLAG) != 0u;
+    const u32 gen = is_short ? _slots[slot].gen & SHORT_GEN_MASK : _slots[slot].gen;
+    return gen == handle_gen(handle);
+  }
+
+  void relocate(u32 slot, u32 index) { _slots[slot].index = index; }
+
+  u32 index(u32 slot) const { return _slots[slot].index; }
+
+  handle_type handle(u32 slot) const { return make_handle(slot, _slots[slot].gen); }
+
+  void save(util::byte_writer& out) const {
+    out.write(_slots);
+    out.write(_free_slot);
+  }
+
+  void load(util::byte_reader& in) {
+    in.read(_slots);
+    in.read(_free_slot);
+  }
+
+private:
+  std::vector<slot_entry> _slots;
+  u32 _free_slot{NULL_SLOT};
+};
+
+} // namespace okuu::stage
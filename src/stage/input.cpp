@@ -0,0 +1,81 @@
+#include "./input.hpp"
+#include "../render/common.hpp"
+
+#include <fstream>
+
+namespace okuu::stage {
+
+input_state window_input::poll([[maybe_unused]] u32 tick) {
+  const auto& win = render::window();
+  const auto pressed = [&](shogle::win_key key) {
+    return win.poll_key(key) == shogle::win_action::press;
+  };
+
+  input_state state = KEY_NONE;
+  state |= pressed(shogle::win_key::w) ? KEY_UP : KEY_NONE;
+  state |= pressed(shogle::win_key::s) ? KEY_DOWN : KEY_NONE;
+  state |= pressed(shogle::win_key::a) ? KEY_LEFT : KEY_NONE;
+  state |= pressed(shogle::win_key::d) ? KEY_RIGHT : KEY_NONE;
+  state |= pressed(shogle::win_key::l) ? KEY_FOCUS : KEY_NONE;
+  state |= pressed(shogle::win_key::j) ? KEY_SHOOT : KEY_NONE;
+  state |= pressed(shogle::win_key::k) ? KEY_BOMB : KEY_NONE;
+  return state;
+}
+
+scripted_input::scripted_input(std::vector<entry>&& entries) :
+    _entries{std::move(entries)}, _next{0u}, _state{KEY_NONE} {
+  NTF_ASSERT(std::is_sorted(_entries.begin(), _entries.end(),
+                            [](const entry& a, const entry& b) { return a.tick < b.tick; }));
+}
+
+input_state scripted_input::poll(u32 tick) {
+  while (_next < _entries.size() && _entries[_next].tick <= tick) {
+    _state = _entries[_next].state;
+    ++_next;
+  }
+  return _state;
+}
+
+recorded_input::recorded_input(std::vector<input_state>&& states) : _states{std::move(states)} {}
+
+expect<recorded_input> recorded_input::load(const std::string& path) {
+  std::ifstream file{path, std::ios::binary};
+  if (!file) {
+    return {ntf::unexpect, fmt::format("Failed to open input file \"{}\"", path)};
+  }
+  std::vector<input_state> states{std::istreambuf_iterator<char>{file},
+                                  std::istreambuf_iterator<char>{}};
+  return {ntf::in_place, std::move(states)};
+}
+
+input_state recorded_input::poll(u32 tick) {
+  return tick < _states.size() ? _states[tick] : KEY_NONE;
+}
+
+input_recorder::input_recorder(std::unique_ptr<input_source>&& source) :
+    _source{std::move(source)}, _states{} {
+  NTF_ASSERT(_source);
+}
+
+input_state input_recorder::poll(u32 tick) {
+  const input_state state = _source->poll(tick);
+  // Indexed by tick, so gaps and repeated polls still line up on playback
+  if (_states.size() <= tick) {
+    _states.resize(tick + 1u, KEY_NONE);
+  }
+  _states[tick] = state;
+  return state;
+}
+
+bool input_recorder::save(const std::string& path) const {
+  std::ofstream file{path, std::ios::binary};
+  if (!file) {
+    logger::error("Failed to open input file \"{}\"", path);
+    return false;
+  }
+  file.write(reinterpret_cast<const char*>(_states.data()),
+             static_cast<std::streamsize>(_states.size()));
+  return static_cast<bool>(file);
+}
+
+} // namespace okuu::stage
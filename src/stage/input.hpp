@@ -0,0 +1,94 @@
+#pragma once
+
+#include "../core.hpp"
+
+#include <memory>
+
+namespace okuu::stage {
+
+enum input_key : u8 {
+  KEY_NONE = 0,
+  KEY_UP = 1 << 0,
+  KEY_DOWN = 1 << 1,
+  KEY_LEFT = 1 << 2,
+  KEY_RIGHT = 1 << 3,
+  KEY_FOCUS = 1 << 4,
+  KEY_SHOOT = 1 << 5,
+  KEY_BOMB = 1 << 6,
+};
+
+// Bitmask of input_key, sampled once per tick
+using input_state = u8;
+
+// Where the player reads its input from. Sampled once at the start of every tick, so a recorded
+// sequence replays the exact same simulation.
+class input_source {
+public:
+  virtual ~input_source() = default;
+
+public:
+  virtual input_state poll(u32 tick) = 0;
+};
+
+// Live keyboard input, needs the window from render::init()
+class window_input final : public input_source {
+public:
+  input_state poll(u32 tick) override;
+};
+
+// Holds each state until the next entry, entries have to be sorted by tick
+class scripted_input final : public input_source {
+public:
+  struct entry {
+    u32 tick;
+    input_state state;
+  };
+
+public:
+  scripted_input(std::vector<entry>&& entries);
+
+public:
+  input_state poll(u32 tick) override;
+
+private:
+  std::vector<entry> _entries;
+  u32 _next;
+  input_state _state;
+};
+
+// One byte per tick, anything past the end reads as no input
+class recorded_input final : public input_source {
+public:
+  recorded_input(std::vector<input_state>&& states);
+
+public:
+  static expect<recorded_input> load(const std::string& path);
+
+public:
+  input_state poll(u32 tick) override;
+
+  u32 length() const { return static_cast<u32>(_states.size()); }
+
+private:
+  std::vector<input_state> _states;
+};
+
+// Forwards another source and keeps everything it returned, in the recorded_input format
+class input_recorder final : public input_source {
+public:
+  input_recorder(std::unique_ptr<input_source>&& source);
+
+public:
+  input_state poll(u32 tick) override;
+
+  // Returns false if the file couldn't be written
+  bool save(const std::string& path) const;
+
+  const std::vector<input_state>& states() const { return _states; }
+
+private:
+  std::unique_ptr<input_source> _source;
+  std::vector<input_state> _states;
+};
+
+} // namespace okuu::stage
@@ -0,0 +1,122 @@
+#include "./item.hpp"
+
+#include <algorithm>
+
+namespace okuu::stage {
+
+namespace {
+
+constexpr real ITEM_GRAVITY = .1f;
+constexpr real ITEM_MAX_FALL = 3.f;
+constexpr real ITEM_DRAG = .95f; // Horizontal, so scattered items end up falling straight
+
+// Items closer than this start flying towards the player
+constexpr real ITEM_MAGNET_RADIUS = 64.f;
+constexpr real ITEM_ATTRACT_SPEED = 12.f;
+
+} // namespace
+
+mat4 item_pool::view::transform(const render::sprite_uvs& uvs) const {
+  shogle::transform2d<real> t{};
+  const f32 ratio = uvs.x_lin / uvs.y_lin;
+  const real scale = _pool->_scale[_idx];
+  t.pos(pos()).scale(scale * ratio, scale);
+  mat4 mat = t.world();
+  return mat;
+}
+
+void item_pool::spawn(const item_args& args) {
+  _pos_x.push_back(args.pos.x);
+  _pos_y.push_back(args.pos.y);
+  _vel_x.push_back(args.vel.x);
+  _vel_y.push_back(args.vel.y);
+  _attracted.push_back(0u);
+  _kind.push_back(args.kind);
+  _value.push_back(args.value);
+  _scale.push_back(args.scale);
+  _sprite.push_back(args.sprite);
+}
+
+item_totals item_pool::tick(vec2 player_pos, real collect_radius) {
+  item_totals totals{};
+  const real magnet2 = ITEM_MAGNET_RADIUS * ITEM_MAGNET_RADIUS;
+  // Attracted items move a full step per tick, so they get collected once within a step of the
+  // player instead of overshooting it
+  const real reach = collect_radius + ITEM_ATTRACT_SPEED;
+  const real reach2 = reach * reach;
+
+  // Backwards, so the item swapped into a hole was already ticked
+  for (u32 i = size(); i > 0u; --i) {
+    const u32 idx = i - 1u;
+    const real dx = player_pos.x - _pos_x[idx];
+    const real dy = player_pos.y - _pos_y[idx];
+    const real dist2 = (dx * dx) + (dy * dy);
+    _attracted[idx] |= static_cast<u8>(dist2 <= magnet2);
+
+    if (_attracted[idx]) {
+      if (dist2 <= reach2) {
+        totals.value[static_cast<u32>(_kind[idx])] += _value[idx];
+        ++totals.count;
+        _remove_at(idx);
+        continue;
+      }
+      const real step = ITEM_ATTRACT_SPEED / std::sqrt(dist2);
+      _pos_x[idx] += dx * step;
+      _pos_y[idx] += dy * step;
+      continue;
+    }
+
+    _vel_x[idx] *= ITEM_DRAG;
+    _vel_y[idx] = std::min(_vel_y[idx] + ITEM_GRAVITY, ITEM_MAX_FALL);
+    _pos_x[idx] += _vel_x[idx];
+    _pos_y[idx] += _vel_y[idx];
+    if (_pos_y[idx] > _bounds.max_y) {
+      _remove_at(idx);
+    }
+  }
+  return totals;
+}
+
+void item_pool::attract_all() {
+  std::fill(_attracted.begin(), _attracted.end(), u8{1u});
+}
+
+u32 item_pool::clear() {
+  const u32 count = size();
+  _for_each_array([](auto& vec) { vec.clear(); });
+  return count;
+}
+
+void item_pool::save(util::byte_writer& out) const {
+  _for_each_array([&](const auto& vec) { out.write(vec); });
+}
+
+void item_pool::load(util::byte_reader& in) {
+  _for_each_array([&](auto& vec) { in.read(vec); });
+
+  // Same as projectiles, a truncated snapshot leaves the arrays out of sync
+  bool same_size = true;
+  _for_each_array([&](const auto& vec) { same_size = same_size && vec.size() == size(); });
+  const bool valid_kinds = std::all_of(_kind.begin(), _kind.end(), [](item_kind kind) {
+    return static_cast<u32>(kind) < ITEM_KIND_COUNT;
+  });
+  if (!in.ok() || !same_size || !valid_kinds) {
+    _for_each_array([](auto& vec) { vec.clear(); });
+  }
+}
+
+void item_pool::reserve(u32 count) {
+  _for_each_array([count](auto& vec) { vec.reserve(count); });
+}
+
+void item_pool::_remove_at(u32 idx) {
+  const u32 last = size() - 1u;
+  _for_each_array([&](auto& vec) {
+    if (idx != last) {
+      vec[idx] = vec[last];
+    }
+    vec.pop_back();
+  });
+}
+
+} // namespace okuu::stage
@@ -0,0 +1,143 @@
+#pragma once
+
+#include "./entity.hpp"
+
+namespace okuu::stage {
+
+enum class item_kind : u8 {
+  point = 0,
+  power,
+  life,
+  bomb,
+
+  count,
+};
+
+constexpr u32 ITEM_KIND_COUNT = static_cast<u32>(item_kind::count);
+
+struct item_args {
+  item_kind kind;
+  vec2 pos;
+  vec2 vel; // Initial velocity, gravity takes over from there
+  real value;
+  real scale;
+  entity_sprite sprite;
+};
+
+// Everything collected on a single tick, value is summed per kind
+struct item_totals {
+  std::array<real, ITEM_KIND_COUNT> value;
+  u32 count;
+};
+
+// Structure of arrays item storage, same idea as projectile_pool but without handles. Items are
+// never touched one by one after spawning, so kills just swap the last item into the hole.
+//
+// Items fall with gravity until the player gets close enough, or goes above the collect line,
+// then they fly towards the player until they get collected. The whole pool is moved and
+// checked against the player in a single pass.
+class item_pool {
+public:
+  using args_type = item_args;
+
+  // Lightweight view over a single dense entry, for the renderer
+  class view {
+  public:
+    view(const item_pool& pool, u32 idx) noexcept : _pool{&pool}, _idx{idx} {}
+
+  public:
+    vec2 pos() const { return {_pool->_pos_x[_idx], _pool->_pos_y[_idx]}; }
+
+    entity_sprite sprite() const { return _pool->_sprite[_idx]; }
+
+    mat4 transform(const render::sprite_uvs& uvs) const;
+
+  private:
+    const item_pool* _pool;
+    u32 _idx;
+  };
+
+public:
+  item_pool() = default;
+
+public:
+  void spawn(const item_args& args);
+
+  // Moves every item and collects the ones touching the player. Items falling below the bottom
+  // of the bounds are removed without counting them.
+  item_totals tick(vec2 player_pos, real collect_radius);
+
+  // Every item flies towards the player from now on, for screen clears and the collect line
+  void attract_all();
+
+  u32 clear();
+
+  void save(util::byte_writer& out) const;
+  void load(util::byte_reader& in);
+
+  void reserve(u32 count);
+
+  template<typename F>
+  void for_each(F&& func) const {
+    for (u32 i = 0; i < size(); ++i) {
+      std::invoke(func, view{*this, i});
+    }
+  }
+
+public:
+  u32 size() const { return static_cast<u32>(_pos_x.size()); }
+
+  const cull_bounds& bounds() const { return _bounds; }
+
+  item_pool& bounds(const cull_bounds& bounds) {
+    _bounds = bounds;
+    return *this;
+  }
+
+  ntf::cspan<real> pos_x() const { return {_pos_x.data(), _pos_x.size()}; }
+
+  ntf::cspan<real> pos_y() const { return {_pos_y.data(), _pos_y.size()}; }
+
+private:
+  void _remove_at(u32 idx);
+
+  template<typename F>
+  void _for_each_array(F&& func) {
+    func(_pos_x);
+    func(_pos_y);
+    func(_vel_x);
+    func(_vel_y);
+    func(_attracted);
+    func(_kind);
+    func(_value);
+    func(_scale);
+    func(_sprite);
+  }
+
+  template<typename F>
+  void _for_each_array(F&& func) const {
+    const_cast<item_pool*>(this)->_for_each_array(
+      [&](auto& vec) { std::invoke(func, std::as_const(vec)); });
+  }
+
+private:
+  // Hot, touched every tick
+  std::vector<real> _pos_x, _pos_y;
+  std::vector<real> _vel_x, _vel_y;
+  std::vector<u8> _attracted;
+
+  // Cold, only read on collection and rendering
+  std::vector<item_kind> _kind;
+  std::vector<real> _value;
+  std::vector<real> _scale;
+  std::vector<entity_sprite> _sprite;
+
+  cull_bounds _bounds{
+    -std::numeric_limits<real>::infinity(),
+    -std::numeric_limits<real>::infinity(),
+    std::numeric_limits<real>::infinity(),
+    std::numeric_limits<real>::infinity(),
+  };
+};
+
+} // namespace okuu::stage
@@ -0,0 +1,207 @@
+#include "./laser.hpp"
+
+namespace okuu::stage {
+
+namespace {
+
+bool is_outside(const cull_bounds& bounds, vec2 point, real margin) {
+  return point.x < bounds.min_x - margin || point.x > bounds.max_x + margin ||
+         point.y < bounds.min_y - margin || point.y > bounds.max_y + margin;
+}
+
+} // namespace
+
+laser_entity::laser_entity(laser_args args) :
+    _args{args}, _pos{args.pos}, _angle{args.angle}, _ticks{0u}, _trail{}, _trail_head{0u},
+    _trail_count{0u}, _box_min{}, _box_max{}, _done{false} {
+  if (_args.kind == laser_kind::curvy) {
+    _trail.resize(std::clamp(_args.trail, 2u, MAX_TRAIL));
+    _push_point(_pos);
+  }
+  _update_box();
+}
+
+laser_phase laser_entity::phase() const {
+  if (_ticks < _args.warning) {
+    return laser_phase::warning;
+  }
+  if (_args.duration == 0u || _ticks - _args.warning < _args.duration) {
+    return laser_phase::active;
+  }
+  return laser_phase::ending;
+}
+
+void laser_entity::tick(const cull_bounds& bounds) {
+  if (_done) {
+    return;
+  }
+  ++_ticks;
+  _args.movement.next_pos(_pos);
+
+  if (_args.kind == laser_kind::straight) {
+    _angle += _args.angular_speed;
+    _update_box();
+    // Same as the curvy ones, except both ends being outside isn't enough since a long laser can
+    // cross the whole playfield. The box already includes the width.
+    const bool outside = _box_max.x < bounds.min_x || _box_min.x > bounds.max_x ||
+                         _box_max.y < bounds.min_y || _box_min.y > bounds.max_y;
+    _done = outside || phase() == laser_phase::ending;
+    return;
+  }
+
+  // The head stops leaving points behind once the laser ends, so the tail catches up to it
+  if (phase() == laser_phase::ending) {
+    --_trail_count;
+  } else {
+    _push_point(_pos);
+  }
+  const real margin = _args.width * .5f;
+  bool outside = true;
+  for (u32 i = 0; i < _trail_count && outside; ++i) {
+    outside = is_outside(bounds, point(i), margin);
+  }
+  _done = outside;
+  _update_box();
+}
+
+bool laser_entity::hits(vec2 center, real radius) const {
+  if (phase() != laser_phase::active) {
+    return false;
+  }
+  if (center.x + radius < _box_min.x || center.x - radius > _box_max.x ||
+      center.y + radius < _box_min.y || center.y - radius > _box_max.y) {
+    return false;
+  }
+
+  const real laser_radius = _args.width * .5f;
+  const u32 count = point_count();
+  if (count == 0u) {
+    return false;
+  }
+  if (count == 1u) {
+    return circles_overlap(point(0u), laser_radius, center, radius);
+  }
+  vec2 prev = point(0u);
+  for (u32 i = 1; i < count; ++i) {
+    const vec2 curr = point(i);
+    if (capsule_circle_overlap(prev, curr, laser_radius, center, radius)) {
+      return true;
+    }
+    prev = curr;
+  }
+  return false;
+}
+
+laser_entity& laser_entity::pos(real x, real y) {
+  _pos = {x, y};
+  if (_args.kind == laser_kind::curvy && _trail_count > 0u) {
+    _trail[_trail_head] = _pos;
+  }
+  _update_box();
+  return *this;
+}
+
+laser_entity& laser_entity::angle(real angle) {
+  _angle = angle;
+  _update_box();
+  return *this;
+}
+
+laser_entity& laser_entity::length(real length) {
+  _args.length = length;
+  _update_box();
+  return *this;
+}
+
+vec2 laser_entity::point(u32 idx) const {
+  if (_args.kind == laser_kind::straight) {
+    if (idx == 0u) {
+      return _pos;
+    }
+    return _pos + (vec2{std::cos(_angle), std::sin(_angle)} * _args.length);
+  }
+  NTF_ASSERT(idx < _trail_count);
+  const u32 cap = static_cast<u32>(_trail.size());
+  return _trail[(_trail_head + cap + 1u - _trail_count + idx) % cap];
+}
+
+void laser_entity::_push_point(vec2 point) {
+  const u32 cap = static_cast<u32>(_trail.size());
+  _trail_head = (_trail_head + 1u) % cap;
+  _trail[_trail_head] = point;
+  _trail_count = std::min(_trail_count + 1u, cap);
+}
+
+void laser_entity::_update_box() {
+  const u32 count = point_count();
+  if (count == 0u) {
+    _box_min = _pos;
+    _box_max = _pos;
+    return;
+  }
+  _box_min = point(0u);
+  _box_max = _box_min;
+  for (u32 i = 1; i < count; ++i) {
+    const vec2 curr = point(i);
+    _box_min = {std::min(_box_min.x, curr.x), std::min(_box_min.y, curr.y)};
+    _box_max = {std::max(_box_max.x, curr.x), std::max(_box_max.y, curr.y)};
+  }
+  const real radius = _args.width * .5f;
+  _box_min -= vec2{radius, radius};
+  _box_max += vec2{radius, radius};
+}
+
+void laser_entity::save(util::byte_writer& out) const {
+  out.write(_args.kind);
+  out.write(_args.pos);
+  out.write(_args.angle);
+  out.write(_args.angular_speed);
+  out.write(_args.length);
+  out.write(_args.width);
+  out.write(_args.warning);
+  out.write(_args.duration);
+  out.write(_args.trail);
+  out.write(_args.movement);
+  out.write(_args.sprite);
+  out.write(_pos);
+  out.write(_angle);
+  out.write(_ticks);
+  out.write(_trail);
+  out.write(_trail_head);
+  out.write(_trail_count);
+  out.write(_done);
+}
+
+laser_entity laser_entity::load(util::byte_reader& in) {
+  // Same order as save(), braced init keeps it
+  laser_entity laser{laser_args{
+    .kind = in.read<laser_kind>(),
+    .pos = in.read<vec2>(),
+    .angle = in.read<real>(),
+    .angular_speed = in.read<real>(),
+    .length = in.read<real>(),
+    .width = in.read<real>(),
+    .warning = in.read<u32>(),
+    .duration = in.read<u32>(),
+    .trail = in.read<u32>(),
+    .movement = in.read<entity_movement>(),
+    .sprite = in.read<entity_sprite>(),
+  }};
+  in.read(laser._pos);
+  in.read(laser._angle);
+  in.read(laser._ticks);
+  in.read(laser._trail);
+  in.read(laser._trail_head);
+  in.read(laser._trail_count);
+  in.read(laser._done);
+  // Keep a truncated read from indexing out of the trail
+  if (laser._trail.empty() || laser._trail_head >= laser._trail.size() ||
+      laser._trail_count > laser._trail.size()) {
+    laser._trail_head = 0u;
+    laser._trail_count = 0u;
+  }
+  laser._update_box();
+  return laser;
+}
+
+} // namespace okuu::stage
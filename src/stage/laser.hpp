@@ -0,0 +1,99 @@
+#pragma once
+
+#include "./collision.hpp"
+#include "./entity.hpp"
+
+namespace okuu::stage {
+
+enum class laser_kind : u8 {
+  straight = 0, // Capsule from the origin along angle
+  curvy,        // Trail of the last positions the head went through
+};
+
+enum class laser_phase : u8 {
+  warning = 0, // Drawn thin, doesn't collide yet
+  active,
+  ending, // Straight lasers vanish, curvy ones pull their tail in until nothing is left
+};
+
+struct laser_args {
+  laser_kind kind;
+  vec2 pos;                 // Origin for straight lasers, head for curvy ones
+  real angle;               // Straight only, radians
+  real angular_speed;       // Straight only, radians per tick
+  real length;              // Straight only
+  real width;               // Collides as a capsule with half of it as radius
+  u32 warning;              // Ticks before it starts colliding
+  u32 duration;             // Active ticks, 0 to keep it around until killed or culled
+  u32 trail;                // Curvy only, trail points, clamped to [2, MAX_TRAIL]
+  entity_movement movement; // Moves pos
+  entity_sprite sprite;     // Stretched along the whole laser
+};
+
+class laser_entity {
+public:
+  using args_type = laser_args;
+
+  static constexpr u32 MAX_TRAIL = 256u;
+
+public:
+  laser_entity(laser_args args);
+
+public:
+  // Curvy lasers get removed once their whole trail is out of bounds
+  void tick(const cull_bounds& bounds);
+
+  // Only active lasers collide
+  bool hits(vec2 center, real radius) const;
+
+  laser_phase phase() const;
+
+  bool is_done() const { return _done; }
+
+  void save(util::byte_writer& out) const;
+  static laser_entity load(util::byte_reader& in);
+
+public:
+  laser_kind kind() const { return _args.kind; }
+
+  vec2 pos() const { return _pos; }
+
+  laser_entity& pos(real x, real y);
+
+  real angle() const { return _angle; }
+
+  laser_entity& angle(real angle);
+
+  laser_entity& length(real length);
+
+  real width() const { return _args.width; }
+
+  entity_sprite sprite() const { return _args.sprite; }
+
+  laser_entity& set_movement(entity_movement movement) {
+    _args.movement = movement;
+    return *this;
+  }
+
+  // Oldest to newest for curvy lasers, origin and end for straight ones
+  u32 point_count() const { return _args.kind == laser_kind::straight ? 2u : _trail_count; }
+
+  vec2 point(u32 idx) const;
+
+private:
+  void _push_point(vec2 point);
+  void _update_box();
+
+private:
+  laser_args _args;
+  vec2 _pos;
+  real _angle;
+  u32 _ticks;
+  std::vector<vec2> _trail; // Ring buffer, _trail_head is the newest point
+  u32 _trail_head;
+  u32 _trail_count;
+  vec2 _box_min, _box_max; // Padded with the radius, for a cheap reject before the segments
+  bool _done;
+};
+
+} // namespace okuu::stage
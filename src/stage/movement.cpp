@@ -0,0 +1,703 @@
+#include "./movement.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OKUU_MOVEMENT_X86 1
+#include <immintrin.h>
+#endif
+
+namespace okuu::stage {
+
+namespace {
+
+constexpr real ROT_DIV = static_cast<real>(GAME_UPS);
+
+u8 is_culled(const cull_bounds& bounds, real x, real y, real margin) {
+  return x > bounds.max_x + margin || x < bounds.min_x - margin || y > bounds.max_y + margin ||
+         y < bounds.min_y - margin;
+}
+
+void linear_scalar(const movement_batch& b, u32 start) {
+  for (u32 i = start; i < b.count; ++i) {
+    b.pos_x[i] += b.vel_x[i];
+    b.pos_y[i] += b.vel_y[i];
+    b.rot[i] += b.ang_speed[i] / ROT_DIV;
+    b.dead[i] = is_culled(b.bounds, b.pos_x[i], b.pos_y[i], b.margin[i]);
+  }
+}
+
+void interpolated_scalar(const movement_batch& b, u32 start) {
+  for (u32 i = start; i < b.count; ++i) {
+    b.pos_x[i] += b.vel_x[i];
+    b.pos_y[i] += b.vel_y[i];
+    b.vel_x[i] = b.acc_x[i] + (b.ret[i] * b.vel_x[i]);
+    b.vel_y[i] = b.acc_y[i] + (b.ret[i] * b.vel_y[i]);
+    b.rot[i] += b.ang_speed[i] / ROT_DIV;
+    b.dead[i] = is_culled(b.bounds, b.pos_x[i], b.pos_y[i], b.margin[i]);
+  }
+}
+
+void linear_scalar(const movement_batch& b) {
+  linear_scalar(b, 0u);
+}
+
+void interpolated_scalar(const movement_batch& b) {
+  interpolated_scalar(b, 0u);
+}
+
+// Velocity and acceleration factors of the position after `t` ticks, with rt = r^t
+std::pair<f64, f64> analytic_factors(f64 r, f64 t, f64 rt) {
+  // p(t) = p0 + v0*S + a*(t - S)/(1 - r), with S = (1 - r^t)/(1 - r)
+  // Done in double precision, (t - S)/(1 - r) cancels badly with retentions close to 1
+  if (r == 1.0) {
+    return std::make_pair(t, t * (t - 1.0) * .5);
+  }
+  const f64 inv = 1.0 / (1.0 - r);
+  const f64 sum = (1.0 - rt) * inv;
+  return std::make_pair(sum, (t - sum) * inv);
+}
+
+// r^t by squaring, computed from scratch on every evaluation so nothing carries over between
+// ticks. The vector kernels do the exact same multiplies per lane, unlike std::pow.
+f64 ret_pow(f64 r, u32 t) {
+  f64 out = 1.0;
+  for (; t > 0u; t >>= 1u) {
+    if (t & 1u) {
+      out *= r;
+    }
+    r *= r;
+  }
+  return out;
+}
+
+void analytic_scalar(const analytic_batch& b, u32 tick, u32 start) {
+  for (u32 i = start; i < b.count; ++i) {
+    const u32 ticks = tick - b.origin_tick[i];
+    const f64 r = static_cast<f64>(b.ret[i]);
+    const auto [vel_fac, acc_fac] =
+      analytic_factors(r, static_cast<f64>(ticks), ret_pow(r, ticks));
+    b.pos_x[i] =
+      static_cast<real>(b.origin_x[i] + (b.vel_x[i] * vel_fac) + (b.acc_x[i] * acc_fac));
+    b.pos_y[i] =
+      static_cast<real>(b.origin_y[i] + (b.vel_y[i] * vel_fac) + (b.acc_y[i] * acc_fac));
+    b.rot[i] = analytic_rot(b.origin_rot[i], b.ang_speed[i], ticks);
+  }
+}
+
+void analytic_scalar(const analytic_batch& b, u32 tick) {
+  analytic_scalar(b, tick, 0u);
+}
+
+#ifdef OKUU_MOVEMENT_X86
+void store_mask(u8* dead, int bits, u32 lanes) {
+  for (u32 k = 0; k < lanes; ++k) {
+    dead[k] = static_cast<u8>((bits >> k) & 1);
+  }
+}
+
+int cull_sse2(const cull_bounds& bounds, __m128 px, __m128 py, __m128 margin) {
+  const __m128 out_x =
+    _mm_or_ps(_mm_cmpgt_ps(px, _mm_add_ps(_mm_set1_ps(bounds.max_x), margin)),
+              _mm_cmplt_ps(px, _mm_sub_ps(_mm_set1_ps(bounds.min_x), margin)));
+  const __m128 out_y =
+    _mm_or_ps(_mm_cmpgt_ps(py, _mm_add_ps(_mm_set1_ps(bounds.max_y), margin)),
+              _mm_cmplt_ps(py, _mm_sub_ps(_mm_set1_ps(bounds.min_y), margin)));
+  return _mm_movemask_ps(_mm_or_ps(out_x, out_y));
+}
+
+__attribute__((target("avx2"))) int cull_avx2(const cull_bounds& bounds, __m256 px, __m256 py,
+                                              __m256 margin) {
+  const __m256 out_x = _mm256_or_ps(
+    _mm256_cmp_ps(px, _mm256_add_ps(_mm256_set1_ps(bounds.max_x), margin), _CMP_GT_OQ),
+    _mm256_cmp_ps(px, _mm256_sub_ps(_mm256_set1_ps(bounds.min_x), margin), _CMP_LT_OQ));
+  const __m256 out_y = _mm256_or_ps(
+    _mm256_cmp_ps(py, _mm256_add_ps(_mm256_set1_ps(bounds.max_y), margin), _CMP_GT_OQ),
+    _mm256_cmp_ps(py, _mm256_sub_ps(_mm256_set1_ps(bounds.min_y), margin), _CMP_LT_OQ));
+  return _mm256_movemask_ps(_mm256_or_ps(out_x, out_y));
+}
+
+void linear_sse2(const movement_batch& b) {
+  const __m128 div = _mm_set1_ps(ROT_DIV);
+  u32 i = 0;
+  for (; i + 4u <= b.count; i += 4u) {
+    const __m128 px = _mm_add_ps(_mm_loadu_ps(b.pos_x + i), _mm_loadu_ps(b.vel_x + i));
+    const __m128 py = _mm_add_ps(_mm_loadu_ps(b.pos_y + i), _mm_loadu_ps(b.vel_y + i));
+    const __m128 rot =
+      _mm_add_ps(_mm_loadu_ps(b.rot + i), _mm_div_ps(_mm_loadu_ps(b.ang_speed + i), div));
+    _mm_storeu_ps(b.pos_x + i, px);
+    _mm_storeu_ps(b.pos_y + i, py);
+    _mm_storeu_ps(b.rot + i, rot);
+    store_mask(b.dead + i, cull_sse2(b.bounds, px, py, _mm_loadu_ps(b.margin + i)), 4u);
+  }
+  linear_scalar(b, i);
+}
+
+void interpolated_sse2(const movement_batch& b) {
+  const __m128 div = _mm_set1_ps(ROT_DIV);
+  u32 i = 0;
+  for (; i + 4u <= b.count; i += 4u) {
+    const __m128 vx = _mm_loadu_ps(b.vel_x + i);
+    const __m128 vy = _mm_loadu_ps(b.vel_y + i);
+    const __m128 ret = _mm_loadu_ps(b.ret + i);
+    const __m128 px = _mm_add_ps(_mm_loadu_ps(b.pos_x + i), vx);
+    const __m128 py = _mm_add_ps(_mm_loadu_ps(b.pos_y + i), vy);
+    const __m128 nvx = _mm_add_ps(_mm_loadu_ps(b.acc_x + i), _mm_mul_ps(ret, vx));
+    const __m128 nvy = _mm_add_ps(_mm_loadu_ps(b.acc_y + i), _mm_mul_ps(ret, vy));
+    const __m128 rot =
+      _mm_add_ps(_mm_loadu_ps(b.rot + i), _mm_div_ps(_mm_loadu_ps(b.ang_speed + i), div));
+    _mm_storeu_ps(b.pos_x + i, px);
+    _mm_storeu_ps(b.pos_y + i, py);
+    _mm_storeu_ps(b.vel_x + i, nvx);
+    _mm_storeu_ps(b.vel_y + i, nvy);
+    _mm_storeu_ps(b.rot + i, rot);
+    store_mask(b.dead + i, cull_sse2(b.bounds, px, py, _mm_loadu_ps(b.margin + i)), 4u);
+  }
+  interpolated_scalar(b, i);
+}
+
+// No FMA here, a fused multiply-add would round differently than the scalar path
+__attribute__((target("avx2"))) void linear_avx2(const movement_batch& b) {
+  const __m256 div = _mm256_set1_ps(ROT_DIV);
+  u32 i = 0;
+  for (; i + 8u <= b.count; i += 8u) {
+    const __m256 px = _mm256_add_ps(_mm256_loadu_ps(b.pos_x + i), _mm256_loadu_ps(b.vel_x + i));
+    const __m256 py = _mm256_add_ps(_mm256_loadu_ps(b.pos_y + i), _mm256_loadu_ps(b.vel_y + i));
+    const __m256 rot = _mm256_add_ps(_mm256_loadu_ps(b.rot + i),
+                                     _mm256_div_ps(_mm256_loadu_ps(b.ang_speed + i), div));
+    _mm256_storeu_ps(b.pos_x + i, px);
+    _mm256_storeu_ps(b.pos_y + i, py);
+    _mm256_storeu_ps(b.rot + i, rot);
+    store_mask(b.dead + i, cull_avx2(b.bounds, px, py, _mm256_loadu_ps(b.margin + i)), 8u);
+  }
+  linear_scalar(b, i);
+}
+
+__attribute__((target("avx2"))) void interpolated_avx2(const movement_batch& b) {
+  const __m256 div = _mm256_set1_ps(ROT_DIV);
+  u32 i = 0;
+  for (; i + 8u <= b.count; i += 8u) {
+    const __m256 vx = _mm256_loadu_ps(b.vel_x + i);
+    const __m256 vy = _mm256_loadu_ps(b.vel_y + i);
+    const __m256 ret = _mm256_loadu_ps(b.ret + i);
+    const __m256 px = _mm256_add_ps(_mm256_loadu_ps(b.pos_x + i), vx);
+    const __m256 py = _mm256_add_ps(_mm256_loadu_ps(b.pos_y + i), vy);
+    const __m256 nvx = _mm256_add_ps(_mm256_loadu_ps(b.acc_x + i), _mm256_mul_ps(ret, vx));
+    const __m256 nvy = _mm256_add_ps(_mm256_loadu_ps(b.acc_y + i), _mm256_mul_ps(ret, vy));
+    const __m256 rot = _mm256_add_ps(_mm256_loadu_ps(b.rot + i),
+                                     _mm256_div_ps(_mm256_loadu_ps(b.ang_speed + i), div));
+    _mm256_storeu_ps(b.pos_x + i, px);
+    _mm256_storeu_ps(b.pos_y + i, py);
+    _mm256_storeu_ps(b.vel_x + i, nvx);
+    _mm256_storeu_ps(b.vel_y + i, nvy);
+    _mm256_storeu_ps(b.rot + i, rot);
+    store_mask(b.dead + i, cull_avx2(b.bounds, px, py, _mm256_loadu_ps(b.margin + i)), 8u);
+  }
+  interpolated_scalar(b, i);
+}
+
+// Same multiplies as ret_pow(), lanes that ran out of bits keep their result. Takes the ticks in
+// the low half of each 64 bit lane.
+__m128d ret_pow_sse2(__m128d r, __m128i t) {
+  const __m128i bit = _mm_set1_epi32(1);
+  __m128d out = _mm_set1_pd(1.0);
+  while (_mm_movemask_epi8(_mm_cmpeq_epi32(t, _mm_setzero_si128())) != 0xFFFF) {
+    const __m128i odd = _mm_cmpeq_epi32(_mm_and_si128(t, bit), bit);
+    const __m128d mask = _mm_castsi128_pd(_mm_shuffle_epi32(odd, _MM_SHUFFLE(2, 2, 0, 0)));
+    out = _mm_or_pd(_mm_and_pd(mask, _mm_mul_pd(out, r)), _mm_andnot_pd(mask, out));
+    r = _mm_mul_pd(r, r);
+    t = _mm_srli_epi64(t, 1);
+  }
+  return out;
+}
+
+__attribute__((target("avx2"))) __m256d ret_pow_avx2(__m256d r, __m128i ticks) {
+  const __m256i bit = _mm256_set1_epi64x(1);
+  __m256i t = _mm256_cvtepu32_epi64(ticks);
+  __m256d out = _mm256_set1_pd(1.0);
+  while (!_mm256_testz_si256(t, t)) {
+    const __m256i odd = _mm256_cmpeq_epi64(_mm256_and_si256(t, bit), bit);
+    out = _mm256_blendv_pd(out, _mm256_mul_pd(out, r), _mm256_castsi256_pd(odd));
+    r = _mm256_mul_pd(r, r);
+    t = _mm256_srli_epi64(t, 1);
+  }
+  return out;
+}
+
+// The factors are done in double precision like the scalar path, two (or four) lanes at a time.
+// Lanes with a retention of 1 get their factors blended in after the division.
+void analytic_sse2(const analytic_batch& b, u32 tick) {
+  const __m128 div = _mm_set1_ps(ROT_DIV);
+  const __m128i tick_v = _mm_set1_epi32(static_cast<int>(tick));
+  const __m128d one = _mm_set1_pd(1.0);
+  const __m128d half = _mm_set1_pd(.5);
+  u32 i = 0;
+  for (; i + 4u <= b.count; i += 4u) {
+    const __m128i ticks_i =
+      _mm_sub_epi32(tick_v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.origin_tick + i)));
+    const __m128 ret = _mm_loadu_ps(b.ret + i);
+    __m128d fac_v[2], fac_a[2];
+    for (u32 k = 0; k < 2u; ++k) {
+      // Lower and upper pairs of the four floats
+      const __m128 ret_k = k == 0u ? ret : _mm_movehl_ps(ret, ret);
+      const __m128i ticks_k = k == 0u ? ticks_i : _mm_srli_si128(ticks_i, 8);
+      const __m128d r = _mm_cvtps_pd(ret_k);
+      const __m128d t = _mm_cvtepi32_pd(ticks_k);
+      const __m128d rt = ret_pow_sse2(r, _mm_unpacklo_epi32(ticks_k, _mm_setzero_si128()));
+      const __m128d inv = _mm_div_pd(one, _mm_sub_pd(one, r));
+      const __m128d sum = _mm_mul_pd(_mm_sub_pd(one, rt), inv);
+      const __m128d acc = _mm_mul_pd(_mm_sub_pd(t, sum), inv);
+      const __m128d acc_one = _mm_mul_pd(_mm_mul_pd(t, _mm_sub_pd(t, one)), half);
+      const __m128d is_one = _mm_cmpeq_pd(r, one);
+      fac_v[k] = _mm_or_pd(_mm_and_pd(is_one, t), _mm_andnot_pd(is_one, sum));
+      fac_a[k] = _mm_or_pd(_mm_and_pd(is_one, acc_one), _mm_andnot_pd(is_one, acc));
+    }
+    const auto eval = [&](const real* origin, const real* vel, const real* acc) -> __m128 {
+      const __m128 o = _mm_loadu_ps(origin + i);
+      const __m128 v = _mm_loadu_ps(vel + i);
+      const __m128 a = _mm_loadu_ps(acc + i);
+      __m128d out[2];
+      for (u32 k = 0; k < 2u; ++k) {
+        const __m128d o_k = _mm_cvtps_pd(k == 0u ? o : _mm_movehl_ps(o, o));
+        const __m128d v_k = _mm_cvtps_pd(k == 0u ? v : _mm_movehl_ps(v, v));
+        const __m128d a_k = _mm_cvtps_pd(k == 0u ? a : _mm_movehl_ps(a, a));
+        out[k] = _mm_add_pd(_mm_add_pd(o_k, _mm_mul_pd(v_k, fac_v[k])), _mm_mul_pd(a_k, fac_a[k]));
+      }
+      return _mm_movelh_ps(_mm_cvtpd_ps(out[0]), _mm_cvtpd_ps(out[1]));
+    };
+    const __m128 px = eval(b.origin_x, b.vel_x, b.acc_x);
+    const __m128 py = eval(b.origin_y, b.vel_y, b.acc_y);
+    const __m128 rot = _mm_add_ps(
+      _mm_loadu_ps(b.origin_rot + i),
+      _mm_div_ps(_mm_mul_ps(_mm_loadu_ps(b.ang_speed + i), _mm_cvtepi32_ps(ticks_i)), div));
+    _mm_storeu_ps(b.pos_x + i, px);
+    _mm_storeu_ps(b.pos_y + i, py);
+    _mm_storeu_ps(b.rot + i, rot);
+  }
+  analytic_scalar(b, tick, i);
+}
+
+// Lambdas don't pick up the target attribute
+__attribute__((target("avx2"))) __m128 analytic_axis_avx2(const real* origin, const real* vel,
+                                                         const real* acc, __m256d fac_v,
+                                                         __m256d fac_a) {
+  const __m256d o = _mm256_cvtps_pd(_mm_loadu_ps(origin));
+  const __m256d v = _mm256_cvtps_pd(_mm_loadu_ps(vel));
+  const __m256d a = _mm256_cvtps_pd(_mm_loadu_ps(acc));
+  return _mm256_cvtpd_ps(
+    _mm256_add_pd(_mm256_add_pd(o, _mm256_mul_pd(v, fac_v)), _mm256_mul_pd(a, fac_a)));
+}
+
+__attribute__((target("avx2"))) void analytic_avx2(const analytic_batch& b, u32 tick) {
+  const __m128 div = _mm_set1_ps(ROT_DIV);
+  const __m128i tick_v = _mm_set1_epi32(static_cast<int>(tick));
+  const __m256d one = _mm256_set1_pd(1.0);
+  const __m256d half = _mm256_set1_pd(.5);
+  u32 i = 0;
+  for (; i + 4u <= b.count; i += 4u) {
+    const __m128i ticks_i =
+      _mm_sub_epi32(tick_v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(b.origin_tick + i)));
+    const __m256d r = _mm256_cvtps_pd(_mm_loadu_ps(b.ret + i));
+    const __m256d t = _mm256_cvtepi32_pd(ticks_i);
+    const __m256d rt = ret_pow_avx2(r, ticks_i);
+    const __m256d inv = _mm256_div_pd(one, _mm256_sub_pd(one, r));
+    const __m256d sum = _mm256_mul_pd(_mm256_sub_pd(one, rt), inv);
+    const __m256d acc = _mm256_mul_pd(_mm256_sub_pd(t, sum), inv);
+    const __m256d acc_one = _mm256_mul_pd(_mm256_mul_pd(t, _mm256_sub_pd(t, one)), half);
+    const __m256d is_one = _mm256_cmp_pd(r, one, _CMP_EQ_OQ);
+    const __m256d fac_v = _mm256_blendv_pd(sum, t, is_one);
+    const __m256d fac_a = _mm256_blendv_pd(acc, acc_one, is_one);
+    const __m128 px =
+      analytic_axis_avx2(b.origin_x + i, b.vel_x + i, b.acc_x + i, fac_v, fac_a);
+    const __m128 py =
+      analytic_axis_avx2(b.origin_y + i, b.vel_y + i, b.acc_y + i, fac_v, fac_a);
+    const __m128 rot = _mm_add_ps(
+      _mm_loadu_ps(b.origin_rot + i),
+      _mm_div_ps(_mm_mul_ps(_mm_loadu_ps(b.ang_speed + i), _mm_cvtepi32_ps(ticks_i)), div));
+    _mm_storeu_ps(b.pos_x + i, px);
+    _mm_storeu_ps(b.pos_y + i, py);
+    _mm_storeu_ps(b.rot + i, rot);
+  }
+  analytic_scalar(b, tick, i);
+}
+#endif
+
+constexpr movement_kernels scalar_kernels{
+  .linear = &linear_scalar,
+  .interpolated = &interpolated_scalar,
+  .analytic = &analytic_scalar,
+};
+
+#ifdef OKUU_MOVEMENT_X86
+constexpr movement_kernels sse2_kernels{
+  .linear = &linear_sse2,
+  .interpolated = &interpolated_sse2,
+  .analytic = &analytic_sse2,
+};
+
+constexpr movement_kernels avx2_kernels{
+  .linear = &linear_avx2,
+  .interpolated = &interpolated_avx2,
+  .analytic = &analytic_avx2,
+};
+#endif
+
+const movement_kernels& active_kernels() {
+  static const movement_kernels& kernels = get_movement_kernels(detect_simd_level());
+  return kernels;
+}
+
+} // namespace
+
+simd_level detect_simd_level() {
+#ifdef OKUU_MOVEMENT_X86
+  if (__builtin_cpu_supports("avx2")) {
+    return simd_level::avx2;
+  }
+  if (__builtin_cpu_supports("sse2")) {
+    return simd_level::sse2;
+  }
+#endif
+  return simd_level::scalar;
+}
+
+std::string_view simd_level_name(simd_level level) {
+  switch (level) {
+    case simd_level::scalar:
+      return "scalar";
+    case simd_level::sse2:
+      return "sse2";
+    case simd_level::avx2:
+      return "avx2";
+  }
+  NTF_UNREACHABLE();
+}
+
+const movement_kernels& get_movement_kernels(simd_level level) {
+#ifdef OKUU_MOVEMENT_X86
+  const auto supported = detect_simd_level();
+  if (level > supported) {
+    level = supported;
+  }
+  switch (level) {
+    case simd_level::avx2:
+      return avx2_kernels;
+    case simd_level::sse2:
+      return sse2_kernels;
+    default:
+      break;
+  }
+#else
+  NTF_UNUSED(level);
+#endif
+  return scalar_kernels;
+}
+
+void integrate_linear(const movement_batch& batch) {
+  active_kernels().linear(batch);
+}
+
+void integrate_interpolated(const movement_batch& batch) {
+  active_kernels().interpolated(batch);
+}
+
+void integrate_attractor(const movement_batch& batch, const attractor_data* attr) {
+  // The attractor only adds to the velocity after the interpolated step, using the new position.
+  // It's rare enough to keep it scalar, and uses cmplx to round the same way as next_pos
+  active_kernels().interpolated(batch);
+  for (u32 i = 0; i < batch.count; ++i) {
+    const auto& a = attr[i];
+    const cmplx pos{batch.pos_x[i], batch.pos_y[i]};
+    const cmplx av = a.attr_p - pos;
+    cmplx vel{batch.vel_x[i], batch.vel_y[i]};
+    if (a.attr_exp == 1) {
+      vel += a.attr * av;
+    } else {
+      real norm2 = (av.real() * av.real()) + (av.imag() * av.imag());
+      norm2 = std::pow(norm2, a.attr_exp - .5f);
+      vel += a.attr + (av * norm2);
+    }
+    batch.vel_x[i] = vel.real();
+    batch.vel_y[i] = vel.imag();
+  }
+}
+
+vec2 analytic_pos(vec2 origin, vec2 vel, vec2 acc, real ret, u32 ticks) {
+  const f64 t = static_cast<f64>(ticks);
+  const f64 r = static_cast<f64>(ret);
+  const auto [vel_fac, acc_fac] = analytic_factors(r, t, ret_pow(r, ticks));
+  return {
+    static_cast<real>(origin.x + (vel.x * vel_fac) + (acc.x * acc_fac)),
+    static_cast<real>(origin.y + (vel.y * vel_fac) + (acc.y * acc_fac)),
+  };
+}
+
+vec2 analytic_vel(vec2 vel, vec2 acc, real ret, u32 ticks) {
+  // v(t) = r^t*v0 + a*(1 - r^t)/(1 - r)
+  const f64 t = static_cast<f64>(ticks);
+  const f64 r = static_cast<f64>(ret);
+  f64 vel_fac, acc_fac;
+  if (r == 1.0) {
+    vel_fac = 1.0;
+    acc_fac = t;
+  } else {
+    vel_fac = ret_pow(r, ticks);
+    acc_fac = (1.0 - vel_fac) / (1.0 - r);
+  }
+  return {
+    static_cast<real>(vel.x * vel_fac + acc.x * acc_fac),
+    static_cast<real>(vel.y * vel_fac + acc.y * acc_fac),
+  };
+}
+
+real analytic_rot(real origin_rot, real ang_speed, u32 ticks) {
+  return origin_rot + (ang_speed * static_cast<real>(ticks) / ROT_DIV);
+}
+
+namespace {
+
+// First tick in [first, last] where `pred` holds, last + 1 if none. `pred` has to go from false to
+// true at most once over the range. Gallops forward before bisecting, most entries leave within a
+// few hundred ticks.
+template<typename F>
+u32 first_tick_where(u32 first, u32 last, F&& pred) {
+  u32 lo = first, hi = last + 1u;
+  for (u32 step = 1u; lo < hi; step *= 2u) {
+    const u32 probe = lo + std::min(step, hi - lo) - 1u;
+    if (pred(probe)) {
+      hi = probe;
+      break;
+    }
+    lo = probe + 1u;
+  }
+  while (lo < hi) {
+    const u32 mid = lo + ((hi - lo) / 2u);
+    if (pred(mid)) {
+      hi = mid;
+    } else {
+      lo = mid + 1u;
+    }
+  }
+  return lo;
+}
+
+// Rough tick the velocity crosses zero at, can be off by a tick or two
+u32 turn_guess(real vel, real acc, real ret) {
+  // v(t) = B + (v0 - B)*r^t with B = a/(1 - r), or v0 + a*t without retention
+  const f64 v0 = vel, a = acc, r = ret;
+  f64 t = 1.0;
+  if (r == 1.0) {
+    t = -v0 / a;
+  } else if (r > 0.0) {
+    const f64 b = a / (1.0 - r);
+    t = std::log(b / (b - v0)) / std::log(r);
+  }
+  if (!(t >= 0.0)) {
+    return 0u;
+  }
+  return t < static_cast<f64>(ANALYTIC_HORIZON) ? static_cast<u32>(t) : ANALYTIC_HORIZON;
+}
+
+// First tick in [1, limit] where a single axis ends up outside [lo, hi]. The per tick step is the
+// velocity, which is monotonic in t for retentions in [0, 1]. So the axis moves one way up to a
+// turning tick and the other way after it, and each side can be binary searched.
+u32 axis_cull_ticks(real origin, real vel, real acc, real ret, real lo, real hi, u32 limit) {
+  const auto pos_at = [&](u32 t) {
+    return analytic_pos({origin, 0.f}, {vel, 0.f}, {acc, 0.f}, ret, t).x;
+  };
+  const auto vel_at = [&](u32 t) { return analytic_vel({vel, 0.f}, {acc, 0.f}, ret, t).x; };
+  const auto sign = [](real x) { return (x > 0.f) - (x < 0.f); };
+
+  // Exit tick on a range where the position only goes one way
+  const auto side_exit = [&](u32 first, u32 last, int dir) -> u32 {
+    if (first > last) {
+      return ANALYTIC_NEVER;
+    }
+    const real start = pos_at(first);
+    if (start < lo || start > hi) {
+      return first;
+    }
+    u32 t = last + 1u;
+    if (dir > 0) {
+      t = first_tick_where(first, last, [&](u32 tick) { return pos_at(tick) > hi; });
+    } else if (dir < 0) {
+      t = first_tick_where(first, last, [&](u32 tick) { return pos_at(tick) < lo; });
+    }
+    return t > last ? ANALYTIC_NEVER : t;
+  };
+
+  int dir = sign(vel_at(0u));
+  if (dir == 0) {
+    dir = sign(vel_at(1u));
+  }
+  // Position after the last step that still went in the starting direction. The velocity is
+  // monotonic, if it doesn't point the other way at the limit it never did. Otherwise solving
+  // v(t) = 0 lands next to it and only the rounding needs checking.
+  const auto turned = [&](u32 t) { return dir != 0 && sign(vel_at(t)) == -dir; };
+  u32 turn = limit + 1u;
+  if (turned(limit)) {
+    const u32 guess = std::min(turn_guess(vel, acc, ret), limit);
+    if (!turned(guess)) {
+      turn = first_tick_where(guess + 1u, limit, turned);
+    } else if (guess == 0u || !turned(guess - 1u)) {
+      turn = guess;
+    } else {
+      turn = first_tick_where(0u, guess - 1u, turned);
+    }
+  }
+  const u32 before = side_exit(1u, std::min(turn, limit), dir);
+  if (before != ANALYTIC_NEVER) {
+    return before;
+  }
+  return side_exit(turn + 1u, limit, -dir);
+}
+
+} // namespace
+
+u32 analytic_cull_ticks(vec2 origin, vec2 vel, vec2 acc, real ret, const cull_bounds& bounds,
+                        real margin) {
+  NTF_ASSERT(ret >= 0.f && ret <= 1.f);
+  const u32 x = axis_cull_ticks(origin.x, vel.x, acc.x, ret, bounds.min_x - margin,
+                                bounds.max_x + margin, ANALYTIC_HORIZON);
+  // Only has to beat the other axis
+  const u32 y_limit = x == ANALYTIC_NEVER ? ANALYTIC_HORIZON : x - 1u;
+  const u32 y = axis_cull_ticks(origin.y, vel.y, acc.y, ret, bounds.min_y - margin,
+                                bounds.max_y + margin, y_limit);
+  return std::min(x, y);
+}
+
+void eval_analytic(const analytic_batch& batch, u32 tick) {
+  active_kernels().analytic(batch, tick);
+}
+
+vec2 wave_offset(vec2 vel, const wave_params& wave, u32 ticks) {
+  // The sine goes across the heading and starts at zero, so setting it doesn't snap the entity
+  const real t = static_cast<real>(ticks);
+  const real speed = std::sqrt((vel.x * vel.x) + (vel.y * vel.y));
+  const real side = speed > 0.f ? wave.amp * (std::sin((wave.freq * t) + wave.phase) -
+                                              std::sin(wave.phase)) / speed
+                                : 0.f;
+  return {(vel.x * t) - (vel.y * side), (vel.y * t) + (vel.x * side)};
+}
+
+namespace {
+
+vec2 path_point(const path_params& path, real u) {
+  const real u2 = u * u;
+  const real u3 = u2 * u;
+  const auto eval = [&](const real* p) -> real {
+    if (path.curve == path_curve::bezier) {
+      const real v = 1.f - u;
+      return (v * v * v * p[0]) + (3.f * v * v * u * p[1]) + (3.f * v * u2 * p[2]) + (u3 * p[3]);
+    }
+    return .5f * ((2.f * p[1]) + ((p[2] - p[0]) * u) +
+                  (((2.f * p[0]) - (5.f * p[1]) + (4.f * p[2]) - p[3]) * u2) +
+                  ((-p[0] + (3.f * p[1]) - (3.f * p[2]) + p[3]) * u3));
+  };
+  return {eval(path.x), eval(path.y)};
+}
+
+// Derivative at the end of the curve, per tick
+vec2 path_end_tangent(const path_params& path) {
+  const real dur = static_cast<real>(path.duration);
+  if (path.curve == path_curve::bezier) {
+    return {3.f * (path.x[3] - path.x[2]) / dur, 3.f * (path.y[3] - path.y[2]) / dur};
+  }
+  return {.5f * (path.x[3] - path.x[1]) / dur, .5f * (path.y[3] - path.y[1]) / dur};
+}
+
+} // namespace
+
+vec2 path_offset(const path_params& path, u32 ticks) {
+  if (path.duration == 0u) {
+    return {0.f, 0.f};
+  }
+  const vec2 start = path_point(path, 0.f);
+  if (ticks <= path.duration) {
+    const real u = static_cast<real>(ticks) / static_cast<real>(path.duration);
+    return path_point(path, u) - start;
+  }
+  const vec2 tangent = path_end_tangent(path);
+  const real extra = static_cast<real>(ticks - path.duration);
+  return path_point(path, 1.f) - start + (tangent * extra);
+}
+
+vec2 orbit_step(orbit_params& orbit) {
+  orbit.angle += orbit.ang_vel;
+  orbit.radius += orbit.radial_vel;
+  return {orbit.center_x + (orbit.radius * std::cos(orbit.angle)),
+          orbit.center_y + (orbit.radius * std::sin(orbit.angle))};
+}
+
+vec2 capped_vel(vec2 vel, const capped_params& capped) {
+  const real speed = std::sqrt((vel.x * vel.x) + (vel.y * vel.y));
+  if (speed <= 0.f) {
+    return vel;
+  }
+  const real next = capped.accel >= 0.f ? std::min(speed + capped.accel, capped.cap)
+                                        : std::max(speed + capped.accel, capped.cap);
+  return vel * (next / speed);
+}
+
+// The extended kinds are scalar, each one still runs in its own loop without branching on the kind
+
+void integrate_orbit(const extended_batch& batch) {
+  const auto& b = batch.base;
+  for (u32 i = 0; i < b.count; ++i) {
+    const vec2 pos = orbit_step(batch.params[i].orbit);
+    b.pos_x[i] = pos.x;
+    b.pos_y[i] = pos.y;
+    b.rot[i] += b.ang_speed[i] / ROT_DIV;
+    b.dead[i] = is_culled(b.bounds, pos.x, pos.y, b.margin[i]);
+  }
+}
+
+void eval_wave(const extended_batch& batch, u32 tick) {
+  const auto& b = batch.base;
+  for (u32 i = 0; i < b.count; ++i) {
+    const vec2 offset =
+      wave_offset({b.vel_x[i], b.vel_y[i]}, batch.params[i].wave, tick - batch.origin_tick[i]);
+    b.pos_x[i] = batch.origin_x[i] + offset.x;
+    b.pos_y[i] = batch.origin_y[i] + offset.y;
+    b.rot[i] += b.ang_speed[i] / ROT_DIV;
+    b.dead[i] = is_culled(b.bounds, b.pos_x[i], b.pos_y[i], b.margin[i]);
+  }
+}
+
+void eval_path(const extended_batch& batch, u32 tick) {
+  const auto& b = batch.base;
+  for (u32 i = 0; i < b.count; ++i) {
+    const vec2 offset = path_offset(batch.params[i].path, tick - batch.origin_tick[i]);
+    b.pos_x[i] = batch.origin_x[i] + offset.x;
+    b.pos_y[i] = batch.origin_y[i] + offset.y;
+    b.rot[i] += b.ang_speed[i] / ROT_DIV;
+    b.dead[i] = is_culled(b.bounds, b.pos_x[i], b.pos_y[i], b.margin[i]);
+  }
+}
+
+void integrate_delayed(const extended_batch& batch, u32 tick) {
+  const auto& b = batch.base;
+  for (u32 i = 0; i < b.count; ++i) {
+    if (tick - batch.origin_tick[i] > batch.params[i].delay.ticks) {
+      b.pos_x[i] += b.vel_x[i];
+      b.pos_y[i] += b.vel_y[i];
+      b.vel_x[i] = b.acc_x[i] + (b.ret[i] * b.vel_x[i]);
+      b.vel_y[i] = b.acc_y[i] + (b.ret[i] * b.vel_y[i]);
+    }
+    b.rot[i] += b.ang_speed[i] / ROT_DIV;
+    b.dead[i] = is_culled(b.bounds, b.pos_x[i], b.pos_y[i], b.margin[i]);
+  }
+}
+
+void integrate_capped(const extended_batch& batch) {
+  const auto& b = batch.base;
+  for (u32 i = 0; i < b.count; ++i) {
+    b.pos_x[i] += b.vel_x[i];
+    b.pos_y[i] += b.vel_y[i];
+    const vec2 vel = capped_vel({b.vel_x[i], b.vel_y[i]}, batch.params[i].capped);
+    b.vel_x[i] = vel.x;
+    b.vel_y[i] = vel.y;
+    b.rot[i] += b.ang_speed[i] / ROT_DIV;
+    b.dead[i] = is_culled(b.bounds, b.pos_x[i], b.pos_y[i], b.margin[i]);
+  }
+}
+
+} // namespace okuu::stage
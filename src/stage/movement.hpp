@@ -0,0 +1,188 @@
+#pragma once
+
+#include "../core.hpp"
+
+#include <limits>
+
+namespace okuu::stage {
+
+enum class movement_kind : u8 {
+  linear = 0,   // No acceleration, no retention
+  interpolated, // Generic velocity/acceleration/retention model
+  attractor,    // Interpolated plus a pull towards a point
+  analytic,     // Interpolated, evaluated in closed form from the origin state
+  orbit,        // Polar motion around a point or a parent projectile
+  wave,         // Straight line plus a sine offset across it, closed form
+  path,         // Cubic curve over a fixed number of ticks, closed form
+  delayed,      // Holds still for a while, then moves like interpolated
+  capped,       // Speeds up (or down) along its heading until reaching a cap
+
+  count,
+};
+
+constexpr u32 MOVEMENT_KIND_COUNT = static_cast<u32>(movement_kind::count);
+
+struct attractor_data {
+  cmplx attr;
+  cmplx attr_p;
+  real attr_exp;
+};
+
+enum class path_curve : u8 {
+  bezier = 0,  // From p0 to p3
+  catmull_rom, // From p1 to p2, p0 and p3 only shape the tangents
+};
+
+// Parameters for the kinds that don't fit the velocity model, only the member for the entry's kind
+// means anything. Curves and waves are offsets from the position the movement was set at.
+struct orbit_params {
+  static constexpr u64 NO_PARENT = std::numeric_limits<u64>::max();
+
+  real center_x, center_y;
+  real radius, angle;
+  real ang_vel, radial_vel;
+  u64 parent; // Projectile handle to follow, NO_PARENT for a fixed center
+};
+
+struct wave_params {
+  real amp, freq, phase;
+};
+
+struct path_params {
+  real x[4], y[4];
+  u32 duration; // Keeps going along the end tangent afterwards
+  path_curve curve;
+};
+
+struct delay_params {
+  u32 ticks;
+};
+
+struct capped_params {
+  real accel, cap;
+};
+
+union movement_params {
+  orbit_params orbit;
+  wave_params wave;
+  path_params path;
+  delay_params delay;
+  capped_params capped;
+};
+
+static_assert(std::is_trivially_copyable_v<movement_params>);
+
+// Entries end up dead when they are fully outside [min - margin, max + margin]
+struct cull_bounds {
+  real min_x, min_y;
+  real max_x, max_y;
+};
+
+// Pointers into structure of arrays entity storage, all of them with at least `count` elements.
+// Kernels write the dead mask for the new positions in the same pass.
+struct movement_batch {
+  real* pos_x;
+  real* pos_y;
+  real* vel_x;
+  real* vel_y;
+  const real* acc_x;
+  const real* acc_y;
+  const real* ret;
+  real* rot;
+  const real* ang_speed;
+  const real* margin;
+  u8* dead;
+  cull_bounds bounds;
+  u32 count;
+};
+
+// Closed form evaluation of the interpolated model. Positions are a geometric series in the
+// retention, so they only depend on the origin state and the ticks elapsed since then. There's no
+// dead mask, the tick an entry gets culled at is known in advance (see analytic_cull_ticks).
+struct analytic_batch {
+  real* pos_x;
+  real* pos_y;
+  real* rot;
+  const real* origin_x;
+  const real* origin_y;
+  const real* origin_rot;
+  const u32* origin_tick;
+  const real* vel_x;
+  const real* vel_y;
+  const real* acc_x;
+  const real* acc_y;
+  const real* ret;
+  const real* ang_speed;
+  u32 count;
+};
+
+// Kinds with their own parameters. Orbits and capped entries are integrated, waves and paths are
+// evaluated from the origin state like analytic entries.
+struct extended_batch {
+  movement_batch base;
+  const real* origin_x;
+  const real* origin_y;
+  const u32* origin_tick;
+  movement_params* params;
+};
+
+enum class simd_level : u8 {
+  scalar = 0,
+  sse2,
+  avx2,
+};
+
+struct movement_kernels {
+  void (*linear)(const movement_batch& batch);
+  void (*interpolated)(const movement_batch& batch);
+  void (*analytic)(const analytic_batch& batch, u32 tick);
+};
+
+// Kernels for a specific instruction set, falls back to the best supported one
+const movement_kernels& get_movement_kernels(simd_level level);
+
+simd_level detect_simd_level();
+std::string_view simd_level_name(simd_level level);
+
+// Runtime dispatched kernels. All of them produce the same results as entity_movement::next_pos
+void integrate_linear(const movement_batch& batch);
+void integrate_interpolated(const movement_batch& batch);
+void integrate_attractor(const movement_batch& batch, const attractor_data* attr);
+
+// Writes position and rotation at `tick` for every entry, any tick after the origin works. r^t is
+// computed from scratch each time like in analytic_pos(), so both agree and nothing carries over
+// between calls. Doesn't match next_pos bit by bit.
+void eval_analytic(const analytic_batch& batch, u32 tick);
+
+void integrate_orbit(const extended_batch& batch);
+void eval_wave(const extended_batch& batch, u32 tick);
+void eval_path(const extended_batch& batch, u32 tick);
+void integrate_delayed(const extended_batch& batch, u32 tick);
+void integrate_capped(const extended_batch& batch);
+
+// Offset from the origin after `ticks`, shared with entity_movement::next_pos
+vec2 wave_offset(vec2 vel, const wave_params& wave, u32 ticks);
+vec2 path_offset(const path_params& path, u32 ticks);
+
+// Advances the orbit state by a tick and returns the new position
+vec2 orbit_step(orbit_params& orbit);
+
+// New velocity after a capped acceleration step
+vec2 capped_vel(vec2 vel, const capped_params& capped);
+
+// Position, velocity and rotation after `ticks` steps of the interpolated model
+vec2 analytic_pos(vec2 origin, vec2 vel, vec2 acc, real ret, u32 ticks);
+vec2 analytic_vel(vec2 vel, vec2 acc, real ret, u32 ticks);
+real analytic_rot(real origin_rot, real ang_speed, u32 ticks);
+
+// Closed form entries past this many ticks since their origin are never culled
+constexpr u32 ANALYTIC_HORIZON = 1u << 24u;
+constexpr u32 ANALYTIC_NEVER = std::numeric_limits<u32>::max();
+
+// Ticks after the origin until the entry first ends up culled, the same tick the per tick kernels
+// would cull it at. ANALYTIC_NEVER if it stays inside up to the horizon. Only for retentions in
+// [0, 1], the position moves one way and then the other at most once per axis.
+u32 analytic_cull_ticks(vec2 origin, vec2 vel, vec2 acc, real ret, const cull_bounds& bounds,
+                        real margin);
+
+} // namespace okuu::stage
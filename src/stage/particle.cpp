@@ -0,0 +1,223 @@
+#include "./particle.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define OKUU_PARTICLE_X86 1
+#include <immintrin.h>
+#endif
+
+namespace okuu::stage {
+
+namespace {
+
+void update_scalar(const particle_batch& b, u32 start) {
+  for (u32 i = start; i < b.count; ++i) {
+    b.pos_x[i] += b.vel_x[i];
+    b.pos_y[i] += b.vel_y[i];
+    b.vel_x[i] *= b.drag[i];
+    b.vel_y[i] *= b.drag[i];
+    const real life = b.life[i] + b.life_step[i];
+    b.life[i] = life;
+    b.scale[i] = b.scale_start[i] + (b.scale_delta[i] * life);
+    b.alpha[i] = b.alpha_start[i] + (b.alpha_delta[i] * life);
+    b.dead[i] = static_cast<u8>(life >= 1.f);
+  }
+}
+
+void update_scalar(const particle_batch& b) {
+  update_scalar(b, 0u);
+}
+
+#ifdef OKUU_PARTICLE_X86
+void store_mask(u8* dead, int bits, u32 lanes) {
+  for (u32 k = 0; k < lanes; ++k) {
+    dead[k] = static_cast<u8>((bits >> k) & 1);
+  }
+}
+
+void update_sse2(const particle_batch& b) {
+  const __m128 one = _mm_set1_ps(1.f);
+  u32 i = 0;
+  for (; i + 4u <= b.count; i += 4u) {
+    const __m128 vx = _mm_loadu_ps(b.vel_x + i);
+    const __m128 vy = _mm_loadu_ps(b.vel_y + i);
+    const __m128 drag = _mm_loadu_ps(b.drag + i);
+    const __m128 life = _mm_add_ps(_mm_loadu_ps(b.life + i), _mm_loadu_ps(b.life_step + i));
+    _mm_storeu_ps(b.pos_x + i, _mm_add_ps(_mm_loadu_ps(b.pos_x + i), vx));
+    _mm_storeu_ps(b.pos_y + i, _mm_add_ps(_mm_loadu_ps(b.pos_y + i), vy));
+    _mm_storeu_ps(b.vel_x + i, _mm_mul_ps(vx, drag));
+    _mm_storeu_ps(b.vel_y + i, _mm_mul_ps(vy, drag));
+    _mm_storeu_ps(b.life + i, life);
+    _mm_storeu_ps(b.scale + i, _mm_add_ps(_mm_loadu_ps(b.scale_start + i),
+                                          _mm_mul_ps(_mm_loadu_ps(b.scale_delta + i), life)));
+    _mm_storeu_ps(b.alpha + i, _mm_add_ps(_mm_loadu_ps(b.alpha_start + i),
+                                          _mm_mul_ps(_mm_loadu_ps(b.alpha_delta + i), life)));
+    store_mask(b.dead + i, _mm_movemask_ps(_mm_cmpge_ps(life, one)), 4u);
+  }
+  update_scalar(b, i);
+}
+
+// Same as the movement kernels, no FMA so the results match the scalar path
+__attribute__((target("avx2"))) void update_avx2(const particle_batch& b) {
+  const __m256 one = _mm256_set1_ps(1.f);
+  u32 i = 0;
+  for (; i + 8u <= b.count; i += 8u) {
+    const __m256 vx = _mm256_loadu_ps(b.vel_x + i);
+    const __m256 vy = _mm256_loadu_ps(b.vel_y + i);
+    const __m256 drag = _mm256_loadu_ps(b.drag + i);
+    const __m256 life =
+      _mm256_add_ps(_mm256_loadu_ps(b.life + i), _mm256_loadu_ps(b.life_step + i));
+    _mm256_storeu_ps(b.pos_x + i, _mm256_add_ps(_mm256_loadu_ps(b.pos_x + i), vx));
+    _mm256_storeu_ps(b.pos_y + i, _mm256_add_ps(_mm256_loadu_ps(b.pos_y + i), vy));
+    _mm256_storeu_ps(b.vel_x + i, _mm256_mul_ps(vx, drag));
+    _mm256_storeu_ps(b.vel_y + i, _mm256_mul_ps(vy, drag));
+    _mm256_storeu_ps(b.life + i, life);
+    _mm256_storeu_ps(b.scale + i,
+                     _mm256_add_ps(_mm256_loadu_ps(b.scale_start + i),
+                                   _mm256_mul_ps(_mm256_loadu_ps(b.scale_delta + i), life)));
+    _mm256_storeu_ps(b.alpha + i,
+                     _mm256_add_ps(_mm256_loadu_ps(b.alpha_start + i),
+                                   _mm256_mul_ps(_mm256_loadu_ps(b.alpha_delta + i), life)));
+    store_mask(b.dead + i, _mm256_movemask_ps(_mm256_cmp_ps(life, one, _CMP_GE_OQ)), 8u);
+  }
+  update_scalar(b, i);
+}
+#endif
+
+using update_func = void (*)(const particle_batch&);
+
+update_func get_update(simd_level level) {
+#ifdef OKUU_PARTICLE_X86
+  const auto supported = detect_simd_level();
+  if (level > supported) {
+    level = supported;
+  }
+  switch (level) {
+    case simd_level::avx2:
+      return &update_avx2;
+    case simd_level::sse2:
+      return &update_sse2;
+    default:
+      break;
+  }
+#else
+  NTF_UNUSED(level);
+#endif
+  return &update_scalar;
+}
+
+} // namespace
+
+void update_particles(const particle_batch& batch) {
+  static const update_func update = get_update(detect_simd_level());
+  update(batch);
+}
+
+void update_particles(const particle_batch& batch, simd_level level) {
+  get_update(level)(batch);
+}
+
+auto particle_system::register_desc(const particle_desc& desc) -> desc_id {
+  const desc_id id = static_cast<desc_id>(_descs.size());
+  _descs.push_back(desc);
+  return id;
+}
+
+void particle_system::emit(desc_id desc, vec2 pos) {
+  NTF_ASSERT(is_valid(desc));
+  emit(desc, pos, _descs[desc].count);
+}
+
+void particle_system::emit(desc_id desc, vec2 pos, u32 count) {
+  NTF_ASSERT(is_valid(desc));
+  const particle_desc& data = _descs[desc];
+  const real life_step = 1.f / static_cast<real>(std::max(data.lifetime, 1u));
+  const real speed_range = data.speed_max - data.speed_min;
+  for (u32 i = 0; i < count; ++i) {
+    const real angle = data.angle + ((_next_random() - .5f) * data.spread);
+    const real speed = data.speed_min + (_next_random() * speed_range);
+    _pos_x.push_back(pos.x);
+    _pos_y.push_back(pos.y);
+    _vel_x.push_back(std::cos(angle) * speed);
+    _vel_y.push_back(std::sin(angle) * speed);
+    _life.push_back(0.f);
+    _scale.push_back(data.scale_start);
+    _alpha.push_back(data.alpha_start);
+    _life_step.push_back(life_step);
+    _drag.push_back(data.drag);
+    _scale_start.push_back(data.scale_start);
+    _scale_delta.push_back(data.scale_end - data.scale_start);
+    _alpha_start.push_back(data.alpha_start);
+    _alpha_delta.push_back(data.alpha_end - data.alpha_start);
+    _desc.push_back(desc);
+  }
+}
+
+void particle_system::tick() {
+  const u32 count = size();
+  if (count == 0u) {
+    return;
+  }
+  _dead.resize(count);
+  update_particles({
+    .pos_x = _pos_x.data(),
+    .pos_y = _pos_y.data(),
+    .vel_x = _vel_x.data(),
+    .vel_y = _vel_y.data(),
+    .life = _life.data(),
+    .scale = _scale.data(),
+    .alpha = _alpha.data(),
+    .life_step = _life_step.data(),
+    .drag = _drag.data(),
+    .scale_start = _scale_start.data(),
+    .scale_delta = _scale_delta.data(),
+    .alpha_start = _alpha_start.data(),
+    .alpha_delta = _alpha_delta.data(),
+    .dead = _dead.data(),
+    .count = count,
+  });
+
+  // Swap remove, backwards so the particle moved into a hole was already checked. Order doesn't
+  // matter for particles.
+  u32 last = count;
+  for (u32 i = count; i > 0u; --i) {
+    const u32 idx = i - 1u;
+    if (!_dead[idx]) {
+      continue;
+    }
+    --last;
+    if (idx != last) {
+      _for_each_array([&](auto& vec) { vec[idx] = vec[last]; });
+    }
+  }
+  if (last != count) {
+    _for_each_array([last](auto& vec) { vec.resize(last); });
+  }
+}
+
+u32 particle_system::clear() {
+  const u32 count = size();
+  _for_each_array([](auto& vec) { vec.clear(); });
+  return count;
+}
+
+void particle_system::reset() {
+  clear();
+  _descs.clear();
+}
+
+void particle_system::reserve(u32 count) {
+  _for_each_array([count](auto& vec) { vec.reserve(count); });
+  _dead.reserve(count);
+}
+
+real particle_system::_next_random() {
+  // xorshift32, plenty for scattering sparks
+  u32 x = _rng_state;
+  x ^= x << 13u;
+  x ^= x >> 17u;
+  x ^= x << 5u;
+  _rng_state = x;
+  return static_cast<real>(x >> 8u) * (1.f / 16777216.f);
+}
+
+} // namespace okuu::stage
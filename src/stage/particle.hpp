@@ -0,0 +1,131 @@
+#pragma once
+
+#include "./entity.hpp"
+
+namespace okuu::stage {
+
+// How a burst looks and behaves, registered once and referenced by id when emitting
+struct particle_desc {
+  u32 lifetime; // Ticks
+  u32 count;    // Particles per burst when emitting with the default count
+  real angle;   // Direction of the burst, radians
+  real spread;  // Full cone around angle, 2pi for a ring
+  real speed_min, speed_max;
+  real drag; // Velocity multiplier per tick
+  real scale_start, scale_end;
+  real alpha_start, alpha_end;
+  entity_sprite sprite;
+};
+
+// Pointers into the particle arrays for the update kernels, all of them with `count` elements
+struct particle_batch {
+  real* pos_x;
+  real* pos_y;
+  real* vel_x;
+  real* vel_y;
+  real* life; // From 0 to 1 over the particle lifetime
+  real* scale;
+  real* alpha;
+  const real* life_step;
+  const real* drag;
+  const real* scale_start;
+  const real* scale_delta;
+  const real* alpha_start;
+  const real* alpha_delta;
+  u8* dead;
+  u32 count;
+};
+
+// Fire and forget visual effects. Particles only exist in structure of arrays storage, without
+// handles, movements or Lua objects, and get removed in bulk once their lifetime runs out.
+//
+// Purely visual, they aren't part of stage snapshots and the spread doesn't use the stage rng.
+class particle_system {
+public:
+  using desc_id = u32;
+
+public:
+  particle_system() = default;
+
+public:
+  desc_id register_desc(const particle_desc& desc);
+
+  bool is_valid(desc_id desc) const { return desc < _descs.size(); }
+
+  const particle_desc& desc(desc_id desc) const { return _descs[desc]; }
+
+  // Emits desc.count particles, or `count` if given
+  void emit(desc_id desc, vec2 pos);
+  void emit(desc_id desc, vec2 pos, u32 count);
+
+  void tick();
+
+  u32 clear();
+
+  // Also forgets every desc, the ids handed out before become invalid
+  void reset();
+
+  void reserve(u32 count);
+
+public:
+  u32 size() const { return static_cast<u32>(_pos_x.size()); }
+
+  ntf::cspan<real> pos_x() const { return {_pos_x.data(), _pos_x.size()}; }
+
+  ntf::cspan<real> pos_y() const { return {_pos_y.data(), _pos_y.size()}; }
+
+  ntf::cspan<real> scale() const { return {_scale.data(), _scale.size()}; }
+
+  ntf::cspan<real> alpha() const { return {_alpha.data(), _alpha.size()}; }
+
+  ntf::cspan<desc_id> desc_ids() const { return {_desc.data(), _desc.size()}; }
+
+  u32 desc_count() const { return static_cast<u32>(_descs.size()); }
+
+private:
+  real _next_random();
+
+  template<typename F>
+  void _for_each_array(F&& func) {
+    func(_pos_x);
+    func(_pos_y);
+    func(_vel_x);
+    func(_vel_y);
+    func(_life);
+    func(_scale);
+    func(_alpha);
+    func(_life_step);
+    func(_drag);
+    func(_scale_start);
+    func(_scale_delta);
+    func(_alpha_start);
+    func(_alpha_delta);
+    func(_desc);
+  }
+
+private:
+  std::vector<particle_desc> _descs;
+
+  // Hot, written every tick
+  std::vector<real> _pos_x, _pos_y;
+  std::vector<real> _vel_x, _vel_y;
+  std::vector<real> _life;
+  std::vector<real> _scale;
+  std::vector<real> _alpha;
+
+  // Copied from the desc on emit, so the kernels don't need to look it up
+  std::vector<real> _life_step;
+  std::vector<real> _drag;
+  std::vector<real> _scale_start, _scale_delta;
+  std::vector<real> _alpha_start, _alpha_delta;
+  std::vector<desc_id> _desc;
+
+  std::vector<u8> _dead;
+  u32 _rng_state{0x9e3779b9u};
+};
+
+// Runtime dispatched like the movement kernels, writes the dead mask in the same pass
+void update_particles(const particle_batch& batch);
+void update_particles(const particle_batch& batch, simd_level level);
+
+} // namespace okuu::stage
@@ -0,0 +1,479 @@
+#include "./projectile.hpp"
+
+namespace okuu::stage {
+
+mat4 projectile_pool::view::transform(const render::sprite_uvs& uvs) const {
+  shogle::basic_transform<real, shogle::trs_transform<real, 2>, 2, true> t{};
+  const f32 ratio = uvs.x_lin / uvs.y_lin;
+  const vec2 scale = _pool->_scale[_idx];
+  t.pos(pos()).scale(scale.x * ratio, scale.y).rot(vec3{0.f, 0.f, _pool->rot_at(_idx)});
+  mat4 mat = t.world();
+  return mat;
+}
+
+auto projectile_pool::spawn(projectile_args args) -> entity_handle {
+  // Append to the last group first, then let _set_movement move it to the right one
+  const u32 idx = size();
+  const u32 slot = _handles.acquire(idx);
+  ++_kind_end.back();
+  bool grows = false;
+  _for_each_array([&](const auto& vec) { grows = grows || vec.size() == vec.capacity(); });
+  if (grows) {
+    ++_generation;
+  }
+
+  _pos_x.push_back(args.pos.x);
+  _pos_y.push_back(args.pos.y);
+  _vel_x.emplace_back();
+  _vel_y.emplace_back();
+  _acc_x.emplace_back();
+  _acc_y.emplace_back();
+  _ret.emplace_back();
+  _cull_tick.push_back(ANALYTIC_NEVER);
+  _rot.push_back(0.f);
+  _ang_speed.push_back(args.angular_speed);
+  _cull_margin.push_back(args.cull_margin);
+  _attr.emplace_back();
+  _params.emplace_back();
+  _origin_x.emplace_back();
+  _origin_y.emplace_back();
+  _origin_rot.emplace_back();
+  _origin_tick.emplace_back();
+  _scale.push_back(args.scale);
+  _hitbox.push_back(args.hitbox);
+  _damage.push_back(args.damage);
+  _sprite.push_back(args.sprite);
+  _flags.push_back(args.analytic ? FLAG_ANALYTIC : FLAG_NONE);
+  _ticks.push_back(0u);
+  _dense_slot.push_back(slot);
+  _set_movement(idx, args.movement);
+
+  return _handles.handle(slot);
+}
+
+void projectile_pool::kill(entity_handle handle) {
+  if (!is_alive(handle)) {
+    return;
+  }
+  _remove_at(_index_of(handle));
+}
+
+bool projectile_pool::is_alive(entity_handle handle) const {
+  if (!_handles.is_valid(handle)) {
+    return false;
+  }
+  const u32 slot = handle_table::handle_slot(handle);
+  const u32 idx = _handles.index(slot);
+  return idx < size() && _dense_slot[idx] == slot;
+}
+
+u32 projectile_pool::clear() {
+  const u32 count = size();
+  for (const u32 slot : _dense_slot) {
+    _handles.release(slot);
+  }
+  _for_each_array([](auto& vec) { vec.clear(); });
+  _kind_end.fill(0u);
+  ++_generation;
+  return count;
+}
+
+void projectile_pool::save(util::byte_writer& out) const {
+  _for_each_array([&](const auto& vec) { out.write(vec); });
+  _handles.save(out);
+  out.write(_kind_end);
+  out.write(_clock);
+  out.write(_analytic_stale);
+}
+
+void projectile_pool::load(util::byte_reader& in) {
+  _for_each_array([&](auto& vec) { in.read(vec); });
+  _handles.load(in);
+  in.read(_kind_end);
+  in.read(_clock);
+  in.read(_analytic_stale);
+  ++_generation;
+
+  // A truncated snapshot leaves the arrays out of sync, don't keep anything from it
+  bool same_size = true;
+  _for_each_array([&](const auto& vec) { same_size = same_size && vec.size() == size(); });
+  if (!in.ok() || !same_size || _kind_end.back() != size()) {
+    _for_each_array([](auto& vec) { vec.clear(); });
+    _handles = {};
+    _kind_end.fill(0u);
+  }
+}
+
+void projectile_pool::reserve(u32 count) {
+  bool grows = false;
+  _for_each_array([&](const auto& vec) { grows = grows || vec.capacity() < count; });
+  if (grows) {
+    ++_generation;
+  }
+  _for_each_array([count](auto& vec) { vec.reserve(count); });
+  _dead.reserve(count);
+}
+
+std::pair<u32, u32> projectile_pool::kind_range(movement_kind kind) const {
+  const u32 k = static_cast<u32>(kind);
+  const u32 begin = k == 0u ? 0u : _kind_end[k - 1u];
+  return std::make_pair(begin, _kind_end[k]);
+}
+
+void projectile_pool::begin_tick() {
+  _dead.resize(size());
+
+  // Parents get read here and not in tick_range, so every orbit sees the parent's position from
+  // the previous tick no matter how the ranges get split. Before the clock moves, analytic
+  // parents get evaluated at the previous tick too.
+  const auto [orbit_begin, orbit_end] = kind_range(movement_kind::orbit);
+  for (u32 i = orbit_begin; i < orbit_end; ++i) {
+    auto& orbit = _params[i].orbit;
+    if (orbit.parent == orbit_params::NO_PARENT || !is_alive(orbit.parent)) {
+      continue;
+    }
+    const vec2 center = pos(orbit.parent);
+    orbit.center_x = center.x;
+    orbit.center_y = center.y;
+  }
+  ++_clock;
+  _analytic_stale = true;
+}
+
+void projectile_pool::tick_range(u32 begin, u32 end) {
+  NTF_ASSERT(begin <= end && end <= size());
+  const auto clip = [&](movement_kind kind) -> std::pair<u32, u32> {
+    const auto [kind_begin, kind_end] = kind_range(kind);
+    const u32 first = std::max(begin, kind_begin);
+    const u32 last = std::min(end, kind_end);
+    return std::make_pair(first, std::max(first, last));
+  };
+
+  {
+    const auto [first, last] = clip(movement_kind::linear);
+    integrate_linear(_make_batch(first, last));
+  }
+  {
+    const auto [first, last] = clip(movement_kind::interpolated);
+    integrate_interpolated(_make_batch(first, last));
+  }
+  {
+    const auto [first, last] = clip(movement_kind::attractor);
+    integrate_attractor(_make_batch(first, last), _attr.data() + first);
+  }
+  {
+    // Nothing to integrate, positions wait until someone reads them
+    const auto [first, last] = clip(movement_kind::analytic);
+    for (u32 i = first; i < last; ++i) {
+      _dead[i] = _clock >= _cull_tick[i];
+    }
+  }
+  {
+    const auto [first, last] = clip(movement_kind::orbit);
+    integrate_orbit(_make_extended_batch(first, last));
+  }
+  {
+    const auto [first, last] = clip(movement_kind::wave);
+    eval_wave(_make_extended_batch(first, last), _clock);
+  }
+  {
+    const auto [first, last] = clip(movement_kind::path);
+    eval_path(_make_extended_batch(first, last), _clock);
+  }
+  {
+    const auto [first, last] = clip(movement_kind::delayed);
+    integrate_delayed(_make_extended_batch(first, last), _clock);
+  }
+  {
+    const auto [first, last] = clip(movement_kind::capped);
+    integrate_capped(_make_extended_batch(first, last));
+  }
+
+  for (u32 i = begin; i < end; ++i) {
+    ++_ticks[i];
+  }
+}
+
+u32 projectile_pool::end_tick() {
+  NTF_ASSERT(_dead.size() == size());
+  return clear_marked(_dead.data());
+}
+
+void projectile_pool::sync_analytic() {
+  if (!_analytic_stale) {
+    return;
+  }
+  const auto [first, last] = kind_range(movement_kind::analytic);
+  eval_analytic(_make_analytic_batch(first, last), _clock);
+  _analytic_stale = false;
+}
+
+u32 projectile_pool::clear_marked(const u8* mask) {
+  // Removing only moves entries at or after the removed index, so walking backwards never looks
+  // at a moved entry and the mask doesn't need to follow the swaps
+  u32 killed = 0u;
+  for (u32 i = size(); i > 0u; --i) {
+    const u32 idx = i - 1u;
+    if (mask[idx]) {
+      _remove_at(idx);
+      ++killed;
+    }
+  }
+  return killed;
+}
+
+vec2 projectile_pool::pos_at_tick(entity_handle handle, u32 tick) const {
+  const u32 idx = _index_of(handle);
+  if (!_is_analytic(idx)) {
+    return pos_at(idx);
+  }
+  NTF_ASSERT(tick >= _origin_tick[idx]);
+  return analytic_pos({_origin_x[idx], _origin_y[idx]}, {_vel_x[idx], _vel_y[idx]},
+                      {_acc_x[idx], _acc_y[idx]}, _ret[idx], tick - _origin_tick[idx]);
+}
+
+projectile_pool& projectile_pool::bounds(const cull_bounds& bounds) {
+  _bounds = bounds;
+  const auto [first, last] = kind_range(movement_kind::analytic);
+  for (u32 i = first; i < last; ++i) {
+    _cull_tick[i] = _analytic_cull_tick(i);
+  }
+  return *this;
+}
+
+projectile_pool& projectile_pool::pos(entity_handle handle, real x, real y) {
+  const u32 idx = _index_of(handle);
+  _rebase(idx);
+  // Curves keep going from the new position instead of snapping back to their start
+  const vec2 offset = _curve_offset(idx);
+  _pos_x[idx] = x;
+  _pos_y[idx] = y;
+  _origin_x[idx] = x - offset.x;
+  _origin_y[idx] = y - offset.y;
+  if (_is_analytic(idx)) {
+    _cull_tick[idx] = _analytic_cull_tick(idx);
+  }
+  return *this;
+}
+
+projectile_pool& projectile_pool::movement(entity_handle handle, entity_movement movement) {
+  _set_movement(_index_of(handle), movement);
+  return *this;
+}
+
+projectile_pool& projectile_pool::angular_speed(entity_handle handle, real speed) {
+  const u32 idx = _index_of(handle);
+  _rebase(idx);
+  _ang_speed[idx] = speed;
+  return *this;
+}
+
+auto projectile_pool::handle_at(u32 idx) const -> entity_handle {
+  NTF_ASSERT(idx < size());
+  return _handles.handle(_dense_slot[idx]);
+}
+
+u32 projectile_pool::_index_of(entity_handle handle) const {
+  NTF_ASSERT(is_alive(handle));
+  return _handles.index(handle_table::handle_slot(handle));
+}
+
+void projectile_pool::_remove_at(u32 idx) {
+  NTF_ASSERT(idx < size());
+  const u32 slot = _dense_slot[idx];
+
+  // Push the entry to the very end of the last group, then drop it
+  const u32 last = size() - 1u;
+  idx = _move_to_kind(idx, static_cast<movement_kind>(MOVEMENT_KIND_COUNT - 1u));
+  if (idx != last) {
+    _swap_entries(idx, last);
+  }
+  --_kind_end.back();
+  _for_each_array([](auto& vec) { vec.pop_back(); });
+  _handles.release(slot);
+  ++_generation;
+}
+
+void projectile_pool::_swap_entries(u32 a, u32 b) {
+  _for_each_array([a, b](auto& vec) {
+    using std::swap;
+    swap(vec[a], vec[b]);
+  });
+  _handles.relocate(_dense_slot[a], a);
+  _handles.relocate(_dense_slot[b], b);
+  ++_generation;
+}
+
+movement_kind projectile_pool::_kind_at(u32 idx) const {
+  u32 k = 0u;
+  while (k < MOVEMENT_KIND_COUNT && idx >= _kind_end[k]) {
+    ++k;
+  }
+  NTF_ASSERT(k < MOVEMENT_KIND_COUNT);
+  return static_cast<movement_kind>(k);
+}
+
+u32 projectile_pool::_move_to_kind(u32 idx, movement_kind kind) {
+  // Moving across groups takes one swap per group boundary crossed, each one keeps the groups
+  // contiguous by swapping with the last (or first) element of the current group
+  u32 curr = static_cast<u32>(_kind_at(idx));
+  const u32 target = static_cast<u32>(kind);
+  while (curr < target) {
+    const u32 last = _kind_end[curr] - 1u;
+    if (idx != last) {
+      _swap_entries(idx, last);
+    }
+    idx = last;
+    --_kind_end[curr];
+    ++curr;
+  }
+  while (curr > target) {
+    const u32 first = _kind_end[curr - 1u];
+    if (idx != first) {
+      _swap_entries(idx, first);
+    }
+    idx = first;
+    ++_kind_end[curr - 1u];
+    --curr;
+  }
+  return idx;
+}
+
+u32 projectile_pool::_set_movement(u32 idx, const entity_movement& movement) {
+  // Only the plain velocity model has a closed form, the rest ignore the flag. Retentions past 1
+  // or below 0 don't get solved for their cull tick either.
+  movement_kind kind = movement.kind();
+  if ((_flags[idx] & FLAG_ANALYTIC) &&
+      (kind == movement_kind::linear || kind == movement_kind::interpolated) &&
+      movement.ret() >= 0.f && movement.ret() <= 1.f) {
+    kind = movement_kind::analytic;
+  }
+  // Before moving it out of its group, it might be a stale analytic entry
+  const vec2 pos = pos_at(idx);
+  const real rot = rot_at(idx);
+  idx = _move_to_kind(idx, kind);
+  _pos_x[idx] = pos.x;
+  _pos_y[idx] = pos.y;
+  _rot[idx] = rot;
+  _origin_x[idx] = pos.x;
+  _origin_y[idx] = pos.y;
+  _origin_rot[idx] = rot;
+  _origin_tick[idx] = _clock;
+  const vec2 vel = movement.vel();
+  const vec2 acc = movement.acc();
+  _vel_x[idx] = vel.x;
+  _vel_y[idx] = vel.y;
+  _acc_x[idx] = acc.x;
+  _acc_y[idx] = acc.y;
+  _ret[idx] = movement.ret();
+  _attr[idx] = {movement.attr(), movement.attr_pos(), movement.attr_exp()};
+  _params[idx] = movement.params();
+  _cull_tick[idx] = kind == movement_kind::analytic ? _analytic_cull_tick(idx) : ANALYTIC_NEVER;
+  return idx;
+}
+
+void projectile_pool::_rebase(u32 idx) {
+  // Restart the closed form from the current state, so the caller can change it
+  if (!_is_analytic(idx)) {
+    return;
+  }
+  const vec2 pos = pos_at(idx);
+  const real rot = rot_at(idx);
+  const vec2 vel = analytic_vel({_vel_x[idx], _vel_y[idx]}, {_acc_x[idx], _acc_y[idx]}, _ret[idx],
+                                _clock - _origin_tick[idx]);
+  _vel_x[idx] = vel.x;
+  _vel_y[idx] = vel.y;
+  _pos_x[idx] = pos.x;
+  _pos_y[idx] = pos.y;
+  _rot[idx] = rot;
+  _origin_x[idx] = pos.x;
+  _origin_y[idx] = pos.y;
+  _origin_rot[idx] = rot;
+  _origin_tick[idx] = _clock;
+  _cull_tick[idx] = _analytic_cull_tick(idx);
+}
+
+bool projectile_pool::_is_analytic(u32 idx) const {
+  const auto [first, last] = kind_range(movement_kind::analytic);
+  return idx >= first && idx < last;
+}
+
+vec2 projectile_pool::_analytic_pos(u32 idx) const {
+  return analytic_pos({_origin_x[idx], _origin_y[idx]}, {_vel_x[idx], _vel_y[idx]},
+                      {_acc_x[idx], _acc_y[idx]}, _ret[idx], _clock - _origin_tick[idx]);
+}
+
+real projectile_pool::_analytic_rot(u32 idx) const {
+  return analytic_rot(_origin_rot[idx], _ang_speed[idx], _clock - _origin_tick[idx]);
+}
+
+u32 projectile_pool::_analytic_cull_tick(u32 idx) const {
+  const u32 ticks =
+    analytic_cull_ticks({_origin_x[idx], _origin_y[idx]}, {_vel_x[idx], _vel_y[idx]},
+                        {_acc_x[idx], _acc_y[idx]}, _ret[idx], _bounds, _cull_margin[idx]);
+  if (ticks == ANALYTIC_NEVER || ticks > ANALYTIC_NEVER - _origin_tick[idx]) {
+    return ANALYTIC_NEVER;
+  }
+  return _origin_tick[idx] + ticks;
+}
+
+movement_batch projectile_pool::_make_batch(u32 begin, u32 end) {
+  return {
+    .pos_x = _pos_x.data() + begin,
+    .pos_y = _pos_y.data() + begin,
+    .vel_x = _vel_x.data() + begin,
+    .vel_y = _vel_y.data() + begin,
+    .acc_x = _acc_x.data() + begin,
+    .acc_y = _acc_y.data() + begin,
+    .ret = _ret.data() + begin,
+    .rot = _rot.data() + begin,
+    .ang_speed = _ang_speed.data() + begin,
+    .margin = _cull_margin.data() + begin,
+    .dead = _dead.data() + begin,
+    .bounds = _bounds,
+    .count = end - begin,
+  };
+}
+
+analytic_batch projectile_pool::_make_analytic_batch(u32 begin, u32 end) {
+  return {
+    .pos_x = _pos_x.data() + begin,
+    .pos_y = _pos_y.data() + begin,
+    .rot = _rot.data() + begin,
+    .origin_x = _origin_x.data() + begin,
+    .origin_y = _origin_y.data() + begin,
+    .origin_rot = _origin_rot.data() + begin,
+    .origin_tick = _origin_tick.data() + begin,
+    .vel_x = _vel_x.data() + begin,
+    .vel_y = _vel_y.data() + begin,
+    .acc_x = _acc_x.data() + begin,
+    .acc_y = _acc_y.data() + begin,
+    .ret = _ret.data() + begin,
+    .ang_speed = _ang_speed.data() + begin,
+    .count = end - begin,
+  };
+}
+
+extended_batch projectile_pool::_make_extended_batch(u32 begin, u32 end) {
+  return {
+    .base = _make_batch(begin, end),
+    .origin_x = _origin_x.data() + begin,
+    .origin_y = _origin_y.data() + begin,
+    .origin_tick = _origin_tick.data() + begin,
+    .params = _params.data() + begin,
+  };
+}
+
+vec2 projectile_pool::_curve_offset(u32 idx) const {
+  const movement_kind kind = _kind_at(idx);
+  const u32 ticks = _clock - _origin_tick[idx];
+  if (kind == movement_kind::wave) {
+    return wave_offset({_vel_x[idx], _vel_y[idx]}, _params[idx].wave, ticks);
+  }
+  if (kind == movement_kind::path) {
+    return path_offset(_params[idx].path, ticks);
+  }
+  return {0.f, 0.f};
+}
+
+} // namespace okuu::stage
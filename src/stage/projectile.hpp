@@ -0,0 +1,283 @@
+#pragma once
+
+#include "./entity.hpp"
+#include "./handle_table.hpp"
+#include "./movement.hpp"
+
+namespace okuu::stage {
+
+// Structure of arrays projectile storage. Kinematic data touched every tick lives in its own
+// contiguous arrays, everything else (sprites, flags) is kept apart so the tick loop
+// doesn't drag it through cache.
+//
+// Entities are packed densely and grouped by movement kind, so each kind is integrated in its own
+// batch without branching per entity. Removing an entity fills the hole with the last element of
+// its group (and of every group after it), so dense indices are only stable until the next kill.
+// Handles go through an indirection table with a generation counter and keep the same u64
+// semantics as the old freelist handles.
+//
+// Analytic entries don't keep any integration state. The tick they get culled at is solved for
+// when their movement changes, so ticking them is a single compare. Their stored position and
+// rotation go stale on every tick until sync_analytic() evaluates the whole group at once,
+// pos_at() and rot_at() evaluate single entries on the spot meanwhile.
+//
+// Culling is done by the movement kernels themselves, they write a dead mask with the new
+// positions and end_tick() compacts the pool once.
+class projectile_pool {
+public:
+  using args_type = projectile_args;
+  using entity_handle = handle_table::handle_type;
+
+public:
+  // Lightweight view over a single dense entry, mostly for the renderer
+  class view {
+  public:
+    view(const projectile_pool& pool, u32 idx) noexcept : _pool{&pool}, _idx{idx} {}
+
+  public:
+    u32 index() const { return _idx; }
+
+    vec2 pos() const { return _pool->pos_at(_idx); }
+
+    real hitbox() const { return _pool->_hitbox[_idx]; }
+
+    entity_sprite sprite() const { return _pool->_sprite[_idx]; }
+
+    mat4 transform(const render::sprite_uvs& uvs) const;
+
+  private:
+    const projectile_pool* _pool;
+    u32 _idx;
+  };
+
+private:
+  enum proj_flags : u32 {
+    FLAG_NONE = 0,
+    FLAG_ANALYTIC = 1 << 0,
+    FLAG_GRAZED = 1 << 1, // Already counted by the player's graze, only once per projectile
+  };
+
+public:
+  projectile_pool() = default;
+
+public:
+  entity_handle spawn(projectile_args args);
+  void kill(entity_handle handle);
+  bool is_alive(entity_handle handle) const;
+  u32 clear();
+  void reserve(u32 count);
+
+  u32 tick() {
+    begin_tick();
+    tick_range(0u, size());
+    return end_tick();
+  }
+
+  // Advances the clock and prepares the dead mask, no spawns or kills until end_tick()
+  void begin_tick();
+
+  // Advances the dense range [begin, end), entries are independent so disjoint ranges can be
+  // ticked from different threads
+  void tick_range(u32 begin, u32 end);
+
+  // Removes the entries culled in this tick, returns how many
+  u32 end_tick();
+
+  // Writes the current position and rotation of every analytic entry, does nothing if they're
+  // already current. Needed before reading the raw position arrays.
+  void sync_analytic();
+
+  // Removes every entry with a non zero mask value. The mask is indexed by dense index.
+  u32 clear_marked(const u8* mask);
+
+  // Every entry, the handle table and the clock. Bounds are part of the stage config and stay.
+  void save(util::byte_writer& out) const;
+  void load(util::byte_reader& in);
+
+  template<typename F>
+  u32 clear_where(F&& func) {
+    u32 killed = 0u;
+    for (u32 i = size(); i > 0u; --i) {
+      const u32 idx = i - 1u;
+      if (std::invoke(func, view{*this, idx})) {
+        _remove_at(idx);
+        ++killed;
+      }
+    }
+    return killed;
+  }
+
+  template<typename F>
+  void for_each(F&& func) const {
+    for (u32 i = 0; i < size(); ++i) {
+      std::invoke(func, view{*this, i});
+    }
+  }
+
+public:
+  u32 size() const { return static_cast<u32>(_pos_x.size()); }
+
+  // Dense index range [first, second) for a movement kind
+  std::pair<u32, u32> kind_range(movement_kind kind) const;
+
+  vec2 pos_at(u32 idx) const {
+    if (_analytic_stale && _is_analytic(idx)) {
+      return _analytic_pos(idx);
+    }
+    return {_pos_x[idx], _pos_y[idx]};
+  }
+
+  real rot_at(u32 idx) const {
+    if (_analytic_stale && _is_analytic(idx)) {
+      return _analytic_rot(idx);
+    }
+    return _rot[idx];
+  }
+
+  vec2 pos(entity_handle handle) const { return pos_at(_index_of(handle)); }
+
+  // Marks the projectile as grazed, false if it already was
+  bool graze_at(u32 idx) {
+    if (_flags[idx] & FLAG_GRAZED) {
+      return false;
+    }
+    _flags[idx] |= FLAG_GRAZED;
+    return true;
+  }
+
+  // Exact position at any tick after the last movement change, for analytic entries. Same
+  // evaluation as sync_analytic(). Other entries only know their current position.
+  vec2 pos_at_tick(entity_handle handle, u32 tick) const;
+
+  u32 clock() const { return _clock; }
+
+  // Bumped whenever the arrays get reallocated or an entry changes its dense index, anything
+  // holding raw pointers or indices into the pool is stale once it changes. Not saved.
+  u32 generation() const { return _generation; }
+
+  const cull_bounds& bounds() const { return _bounds; }
+
+  projectile_pool& bounds(const cull_bounds& bounds);
+
+  projectile_pool& pos(entity_handle handle, real x, real y);
+
+  projectile_pool& movement(entity_handle handle, entity_movement movement);
+
+  real angular_speed(entity_handle handle) const { return _ang_speed[_index_of(handle)]; }
+
+  projectile_pool& angular_speed(entity_handle handle, real speed);
+
+  entity_sprite sprite(entity_handle handle) const { return _sprite[_index_of(handle)]; }
+
+  entity_handle handle_at(u32 idx) const;
+
+  // Analytic entries are only current after sync_analytic()
+  ntf::cspan<real> pos_x() const { return {_pos_x.data(), _pos_x.size()}; }
+
+  ntf::cspan<real> pos_y() const { return {_pos_y.data(), _pos_y.size()}; }
+
+  ntf::cspan<real> vel_x() const { return {_vel_x.data(), _vel_x.size()}; }
+
+  ntf::cspan<real> vel_y() const { return {_vel_y.data(), _vel_y.size()}; }
+
+  ntf::cspan<real> hitbox() const { return {_hitbox.data(), _hitbox.size()}; }
+
+  ntf::cspan<real> damage() const { return {_damage.data(), _damage.size()}; }
+
+private:
+  u32 _index_of(entity_handle handle) const;
+  void _remove_at(u32 idx);
+  void _swap_entries(u32 a, u32 b);
+  movement_kind _kind_at(u32 idx) const;
+  u32 _move_to_kind(u32 idx, movement_kind kind);
+  u32 _set_movement(u32 idx, const entity_movement& movement);
+  void _rebase(u32 idx);
+  bool _is_analytic(u32 idx) const;
+  vec2 _analytic_pos(u32 idx) const;
+  real _analytic_rot(u32 idx) const;
+  u32 _analytic_cull_tick(u32 idx) const;
+  movement_batch _make_batch(u32 begin, u32 end);
+  analytic_batch _make_analytic_batch(u32 begin, u32 end);
+  extended_batch _make_extended_batch(u32 begin, u32 end);
+  vec2 _curve_offset(u32 idx) const;
+
+  static constexpr cull_bounds NO_BOUNDS{
+    -std::numeric_limits<real>::infinity(),
+    -std::numeric_limits<real>::infinity(),
+    std::numeric_limits<real>::infinity(),
+    std::numeric_limits<real>::infinity(),
+  };
+
+  template<typename F>
+  void _for_each_array(F&& func) {
+    func(_pos_x);
+    func(_pos_y);
+    func(_vel_x);
+    func(_vel_y);
+    func(_acc_x);
+    func(_acc_y);
+    func(_ret);
+    func(_cull_tick);
+    func(_rot);
+    func(_ang_speed);
+    func(_cull_margin);
+    func(_attr);
+    func(_params);
+    func(_origin_x);
+    func(_origin_y);
+    func(_origin_rot);
+    func(_origin_tick);
+    func(_scale);
+    func(_hitbox);
+    func(_damage);
+    func(_sprite);
+    func(_flags);
+    func(_ticks);
+    func(_dense_slot);
+  }
+
+  template<typename F>
+  void _for_each_array(F&& func) const {
+    const_cast<projectile_pool*>(this)->_for_each_array(
+      [&](auto& vec) { std::invoke(func, std::as_const(vec)); });
+  }
+
+private:
+  // Hot, touched every tick
+  std::vector<real> _pos_x, _pos_y;
+  std::vector<real> _vel_x, _vel_y;
+  std::vector<real> _acc_x, _acc_y;
+  std::vector<real> _ret;
+  std::vector<u32> _cull_tick; // Clock analytic entries get culled at
+  std::vector<real> _rot;
+  std::vector<real> _ang_speed;
+  std::vector<real> _cull_margin;
+
+  // Cold
+  std::vector<attractor_data> _attr;
+  std::vector<movement_params> _params;
+  std::vector<real> _origin_x, _origin_y;
+  std::vector<real> _origin_rot;
+  std::vector<u32> _origin_tick;
+  std::vector<vec2> _scale;
+  std::vector<real> _hitbox;
+  std::vector<real> _damage;
+  std::vector<entity_sprite> _sprite;
+  std::vector<u32> _flags;
+  std::vector<u32> _ticks;
+
+  // Handle indirection
+  std::vector<u32> _dense_slot;
+  handle_table _handles;
+
+  // Exclusive end of each movement kind group
+  std::array<u32, MOVEMENT_KIND_COUNT> _kind_end{};
+  u32 _clock{0u};
+  u32 _generation{0u};
+  bool _analytic_stale{false};
+
+  cull_bounds _bounds{NO_BOUNDS};
+  std::vector<u8> _dead;
+};
+
+} // namespace okuu::stage
@@ -0,0 +1,74 @@
+#include "./snapshot.hpp"
+#include "./stage.hpp"
+
+#include "../util/profiler.hpp"
+
+namespace okuu::stage {
+
+namespace {
+
+// Reused between snapshots, per thread since the checkpoint standby restores from its own
+thread_local std::vector<u8> g_scratch;
+
+} // namespace
+
+stage_snapshot stage_snapshot::take(const stage_scene& scene, u32 tick,
+                                    const stage_snapshot* prev) {
+  OKUU_PROFILE_ZONE("stage::snapshot");
+  g_scratch.clear();
+  util::byte_writer out{g_scratch};
+  scene.save(out);
+
+  stage_snapshot snap;
+  snap._tick = tick;
+  snap._size = g_scratch.size();
+  const size_t page_count = (snap._size + PAGE_SIZE - 1u) / PAGE_SIZE;
+  snap._pages.reserve(page_count);
+  for (size_t i = 0; i < page_count; ++i) {
+    const size_t offset = i * PAGE_SIZE;
+    const size_t len = std::min(PAGE_SIZE, snap._size - offset);
+    const u8* data = g_scratch.data() + offset;
+
+    if (prev && i < prev->_pages.size()) {
+      const auto& old_page = prev->_pages[i];
+      if (old_page->size() == len && std::memcmp(old_page->data(), data, len) == 0) {
+        snap._pages.push_back(old_page);
+        ++snap._shared;
+        continue;
+      }
+    }
+    snap._pages.push_back(std::make_shared<const page>(data, data + len));
+  }
+  return snap;
+}
+
+bool stage_snapshot::restore(stage_scene& scene) const {
+  OKUU_PROFILE_ZONE("stage::restore");
+  _copy_to(g_scratch);
+  util::byte_reader in{g_scratch.data(), g_scratch.size()};
+  return scene.load(in);
+}
+
+bool stage_snapshot::same_as(const stage_snapshot& other) const {
+  if (_size != other._size) {
+    return false;
+  }
+  for (size_t i = 0; i < _pages.size(); ++i) {
+    const auto& a = _pages[i];
+    const auto& b = other._pages[i];
+    if (a != b && *a != *b) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void stage_snapshot::_copy_to(std::vector<u8>& out) const {
+  out.clear();
+  out.reserve(_size);
+  for (const auto& p : _pages) {
+    out.insert(out.end(), p->begin(), p->end());
+  }
+}
+
+} // namespace okuu::stage
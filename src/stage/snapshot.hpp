@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../core.hpp"
+
+#include <memory>
+
+namespace okuu::stage {
+
+class stage_scene;
+
+// Serialized stage_scene state, split in fixed size pages. Pages that didn't change since the
+// previous snapshot are shared with it instead of copied, so keeping one every second mostly costs
+// the serialization itself.
+class stage_snapshot {
+public:
+  static constexpr size_t PAGE_SIZE = 16384u;
+
+private:
+  using page = std::vector<u8>;
+
+public:
+  stage_snapshot() = default;
+
+public:
+  // `prev` can be any older snapshot, ideally the last one taken
+  static stage_snapshot take(const stage_scene& scene, u32 tick,
+                             const stage_snapshot* prev = nullptr);
+
+  // Fails on truncated or mismatched data, the scene is left in an unspecified but valid state
+  bool restore(stage_scene& scene) const;
+
+public:
+  u32 tick() const { return _tick; }
+
+  size_t size() const { return _size; }
+
+  u32 page_count() const { return static_cast<u32>(_pages.size()); }
+
+  // Pages reused from the previous snapshot
+  u32 shared_pages() const { return _shared; }
+
+  bool empty() const { return _pages.empty(); }
+
+  bool same_as(const stage_snapshot& other) const;
+
+private:
+  void _copy_to(std::vector<u8>& out) const;
+
+private:
+  std::vector<std::shared_ptr<const page>> _pages;
+  size_t _size{0u};
+  u32 _tick{0u};
+  u32 _shared{0u};
+};
+
+} // namespace okuu::stage
@@ -5,6 +5,7 @@
 
 #include "../render/instance.hpp"
 #include "../render/stage.hpp"
+#include "../util/profiler.hpp"
 #include <ntfstl/logger.hpp>
 
 namespace okuu::stage {
@@ -16,30 +17,73 @@ concept renderable_entity = requires(const T ent, const render::sprite_uvs& uvs)
   { ent.transform(uvs) } -> std::same_as<mat4>;
 };
 
+constexpr real COLLISION_CELL_SIZE = 32.f;
+
+// Enemies are few and big, coarser cells keep the rebuild cheap
+constexpr real ENEMY_CELL_SIZE = 64.f;
+
+// Small enough to spread a few thousand entities across workers, big enough to not be dominated
+// by the scheduling overhead
+constexpr u32 PROJECTILE_CHUNK_SIZE = 2048u;
+constexpr u32 SPRITE_CHUNK_SIZE = 256u;
+
+// Fraction of the width drawn while a laser is still a warning
+constexpr real LASER_WARNING_WIDTH = .1f;
+
+// Items get collected within this distance of the player's center
+constexpr real ITEM_COLLECT_RADIUS = 16.f;
+
+// Fraction of the playfield height from the top, the player above it collects every item
+constexpr real ITEM_COLLECT_LINE = .25f;
+
 } // namespace
 
-stage_scene::stage_scene(player_entity&& player, render::stage_renderer&& renderer) :
-    _renderer{std::move(renderer)}, _projs{}, _bosses{}, _boss_count{}, _player{std::move(player)},
-    _task_wait_ticks{0u}, _ticks{0u} {}
+stage_scene::stage_scene(const stage_config& config, player_entity&& player,
+                         ntf::optional<render::stage_renderer>&& renderer) :
+    _config{config}, _renderer{std::move(renderer)}, _projs{}, _shots{}, _items{}, _particles{},
+    _cancel_particles{ntf::nullopt}, _bosses{}, _boss_count{},
+    _player{std::move(player)},
+    _proj_grid{config.playfield_size * -.5f, config.playfield_size * .5f, COLLISION_CELL_SIZE},
+    _enemy_grid{config.playfield_size * -.5f, config.playfield_size * .5f, ENEMY_CELL_SIZE},
+    _player_hit{}, _laser_hit{}, _enemy_death{}, _graze{}, _graze_count{0u},
+    _item_collect{}, _hits{}, _enemy_x{}, _enemy_y{},
+    _enemy_hitbox{}, _shot_hits{}, _laser_points{}, _particle_sprites{},
+    _workers{config.workers}, _rng{config.seed}, _ticks{0u} {
+  const vec2 half = config.playfield_size * .5f;
+  const real margin = config.cull_margin;
+  const cull_bounds bounds{
+    .min_x = -half.x - margin,
+    .min_y = -half.y - margin,
+    .max_x = half.x + margin,
+    .max_y = half.y + margin,
+  };
+  _projs.bounds(bounds);
+  _shots.bounds(bounds);
+  _items.bounds(bounds);
+}
 
 void stage_scene::render(double dt, double alpha, assets::asset_bundle& assets) {
   // The scene has to render the following (in order):
   // - The background
   // - The boss(es)
   // - The player
+  // - The enemies
   // - The items
   // - The danmaku
   NTF_UNUSED(dt);
   NTF_UNUSED(alpha);
+  NTF_ASSERT(_renderer.has_value(), "Headless scenes can't render");
+  OKUU_PROFILE_ZONE("stage::render");
+  auto& renderer = *_renderer;
 
-  const auto render_sprite = [&]<renderable_entity Ent>(Ent& entity) {
+  const auto render_sprite = [&]<renderable_entity Ent>(const Ent& entity) {
     const auto [atlas_handle, sprite, uv_modifier] = entity.sprite();
     assets::sprite_atlas& atlas = assets.get_asset(atlas_handle);
 
     auto [tex, uvs] = atlas.render_data(sprite);
     uvs.x_lin *= uv_modifier.x;
     uvs.y_lin *= uv_modifier.y;
-    this->_renderer.enqueue_sprite({
+    renderer.enqueue_sprite({
       .transform = entity.transform(uvs),
       .texture = tex,
       .ticks = _ticks,
@@ -50,7 +94,53 @@ void stage_scene::render(double dt, double alpha, assets::asset_bundle& assets)
 
   _sprites.for_each([&](sprite_entity& spr) { render_sprite(spr); });
 
-  _projs.for_each([&](projectile_entity& proj) { render_sprite(proj); });
+  _enemies.for_each([&](const enemy_entity& enemy) { render_sprite(enemy); });
+
+  _items.for_each([&](item_pool::view item) { render_sprite(item); });
+
+  _shots.for_each([&](projectile_pool::view shot) { render_sprite(shot); });
+
+  _projs.for_each([&](projectile_pool::view proj) { render_sprite(proj); });
+
+  // Every laser goes out as a single strip, no matter how long its trail is
+  _lasers.for_each([&](const laser_entity& laser) {
+    const u32 count = laser.point_count();
+    if (count < 2u) {
+      return;
+    }
+    _laser_points.clear();
+    for (u32 i = 0; i < count; ++i) {
+      _laser_points.push_back(laser.point(i));
+    }
+    const auto [atlas_handle, sprite, uv_modifier] = laser.sprite();
+    auto [tex, uvs] = assets.get_asset(atlas_handle).render_data(sprite);
+    uvs.x_lin *= uv_modifier.x;
+    uvs.y_lin *= uv_modifier.y;
+    const bool warning = laser.phase() == laser_phase::warning;
+    renderer.enqueue_laser({
+      .points = {_laser_points.data(), _laser_points.size()},
+      .width = warning ? laser.width() * LASER_WARNING_WIDTH : laser.width(),
+      .texture = tex,
+      .ticks = _ticks,
+      .uvs = uvs,
+      .color = {1.f, 1.f, 1.f, warning ? .5f : 1.f},
+    });
+  });
+
+  // Appended straight from the particle arrays, the sprite lookup is done once per desc
+  {
+    const u32 desc_count = _particles.desc_count();
+    _particle_sprites.clear();
+    for (u32 i = 0; i < desc_count; ++i) {
+      const auto [atlas_handle, sprite, uv_modifier] = _particles.desc(i).sprite;
+      auto [tex, uvs] = assets.get_asset(atlas_handle).render_data(sprite);
+      uvs.x_lin *= uv_modifier.x;
+      uvs.y_lin *= uv_modifier.y;
+      _particle_sprites.emplace_back(tex, uvs);
+    }
+
+    enqueue_particles(renderer, _particles, _particle_sprites, _ticks);
+  }
 
   render_sprite(_player);
 
@@ -63,11 +153,12 @@ void stage_scene::render(double dt, double alpha, assets::asset_bundle& assets)
   }
 
   auto render_target = shogle::framebuffer::get_default(render::g_renderer->ctx);
-  render::render_stage(_renderer);
-  render::render_viewport(_renderer.viewport(), render_target);
+  render::render_stage(renderer);
+  render::render_viewport(renderer.viewport(), render_target);
 }
 
-void stage_scene::tick() {
+void stage_scene::tick(input_state input) {
+  OKUU_PROFILE_ZONE("stage::tick");
   for (u32 i = 0; i < _boss_count; ++i) {
     auto& boss = _bosses[i];
     if (!boss.is_active()) {
@@ -76,17 +167,319 @@ void stage_scene::tick() {
     boss.tick();
   }
 
-  _projs.for_each([&](projectile_entity& proj) { proj.tick(); });
-  _projs.clear_where([&](const projectile_entity& proj) {
-    auto pos = proj.pos();
-    return pos.x > 300 || pos.x < -300 || pos.y > 350 || pos.y < -350;
-  });
+  // Before moving anything, so emitted bullets take their first step this same tick like the
+  // ones spawned from Lua
+  {
+    const vec2 player_pos = _player.pos();
+    _emitters.for_each([&](pattern_emitter& emitter) { emitter.tick(_projs, player_pos, _rng); });
+    _emitters.clear_where([](const pattern_emitter& emitter) { return emitter.is_done(); });
+  }
 
-  _player.tick();
-  _sprites.for_each([&](sprite_entity& spr) { spr.tick(); });
+  // Every entity is updated independently and culling only marks, so the results don't depend on
+  // how the chunks get distributed between threads
+  {
+    OKUU_PROFILE_ZONE("stage::tick_projectiles");
+    _projs.begin_tick();
+    _workers.parallel_for(_projs.size(), PROJECTILE_CHUNK_SIZE, [&](u32 begin, u32 end) {
+      OKUU_PROFILE_ZONE("stage::projectile_chunk");
+      _projs.tick_range(begin, end);
+    });
+    _projs.end_tick();
+  }
+
+  {
+    OKUU_PROFILE_ZONE("stage::tick_lasers");
+    const auto& bounds = _projs.bounds();
+    _lasers.for_each([&](laser_entity& laser) { laser.tick(bounds); });
+    _lasers.clear_where([](const laser_entity& laser) { return laser.is_done(); });
+  }
+
+  {
+    OKUU_PROFILE_ZONE("stage::tick_enemies");
+    _enemies.for_each([](enemy_entity& enemy) { enemy.tick(); });
+    _shots.tick();
+    _check_shot_hits();
+  }
+
+  _player.tick(input);
+  {
+    OKUU_PROFILE_ZONE("stage::rebuild_grid");
+    // Every position goes into the grid anyway, so closed form entries get evaluated in one batch
+    _projs.sync_analytic();
+    _proj_grid.rebuild(_projs.pos_x().data(), _projs.pos_y().data(), _projs.hitbox().data(),
+                       _projs.size());
+  }
+  // Both passes read dense indices out of the grid, and Lua handlers can spawn or cancel
+  // projectiles. The graze event waits until the hit pass is done with it.
+  const u32 grazed = _check_grazes();
+  _check_player_hits();
+  if (grazed > 0u) {
+    // A single event with the count, bullet walls can graze hundreds per tick
+    _graze.trigger_event(grazed);
+  }
+  _collect_items();
+  _workers.parallel_for(_sprites.size(), SPRITE_CHUNK_SIZE, [&](u32 begin, u32 end) {
+    OKUU_PROFILE_ZONE("stage::sprite_chunk");
+    for (u32 i = begin; i < end; ++i) {
+      _sprites[i].tick();
+    }
+  });
+  {
+    OKUU_PROFILE_ZONE("stage::tick_particles");
+    _particles.tick();
+  }
   ++_ticks;
 }
 
+void enqueue_particles(render::stage_renderer& renderer, const particle_system& particles,
+                       const particle_sprites& sprites, u32 ticks) {
+  OKUU_PROFILE_ZONE("stage::enqueue_particles");
+  const auto pos_x = particles.pos_x();
+  const auto pos_y = particles.pos_y();
+  const auto scale = particles.scale();
+  const auto alpha = particles.alpha();
+  const auto desc = particles.desc_ids();
+  for (u32 i = 0; i < particles.size(); ++i) {
+    const auto& [tex, uvs] = sprites[desc[i]];
+    shogle::transform2d<real> t{};
+    t.pos(pos_x[i], pos_y[i]).scale(scale[i] * (uvs.x_lin / uvs.y_lin), scale[i]);
+    renderer.enqueue_sprite({
+      .transform = t.world(),
+      .texture = tex,
+      .ticks = ticks,
+      .uvs = uvs,
+      .color = {1.f, 1.f, 1.f, alpha[i]},
+    });
+  }
+}
+
+void stage_scene::reset_particles() {
+  _particles.reset();
+  _cancel_particles.reset();
+}
+
+ntf::optional<render::stage_renderer> stage_scene::release_renderer() {
+  ntf::optional<render::stage_renderer> renderer{std::move(_renderer)};
+  _renderer.reset();
+  return renderer;
+}
+
+void stage_scene::attach_renderer(ntf::optional<render::stage_renderer>&& renderer) {
+  _renderer = std::move(renderer);
+}
+
+void stage_scene::save(util::byte_writer& out) const {
+  out.write(_ticks);
+  _projs.save(out);
+  _sprites.save(out);
+  _emitters.save(out);
+  _lasers.save(out);
+  _enemies.save(out);
+  _shots.save(out);
+  _items.save(out);
+  out.write(_boss_count);
+  for (const auto& boss : _bosses) {
+    boss.save(out);
+  }
+  _player.save(out);
+  out.write(_graze_count);
+  _rng.save(out);
+}
+
+bool stage_scene::load(util::byte_reader& in) {
+  in.read(_ticks);
+  _projs.load(in);
+  _sprites.load(in);
+  _emitters.load(in);
+  _lasers.load(in);
+  _enemies.load(in);
+  _shots.load(in);
+  _items.load(in);
+  in.read(_boss_count);
+  for (auto& boss : _bosses) {
+    boss.load(in);
+  }
+  _player.load(in);
+  in.read(_graze_count);
+  _rng.load(in);
+  _hits.clear();
+  // Not part of the snapshot, and they belong to whatever was playing before
+  _particles.clear();
+  return in.ok() && in.at_end();
+}
+
+void stage_scene::_check_shot_hits() {
+  OKUU_PROFILE_ZONE("stage::shot_hits");
+  const u32 enemy_count = _enemies.size();
+  const u32 shot_count = _shots.size();
+  if (enemy_count == 0u || shot_count == 0u) {
+    return;
+  }
+
+  // Enemies get binned and each shot only looks at the cells around it, so the cost follows the
+  // shot count instead of shots times enemies
+  _enemy_x.resize(enemy_count);
+  _enemy_y.resize(enemy_count);
+  _enemy_hitbox.resize(enemy_count);
+  for (u32 i = 0; i < enemy_count; ++i) {
+    const vec2 pos = _enemies[i].pos();
+    _enemy_x[i] = pos.x;
+    _enemy_y[i] = pos.y;
+    _enemy_hitbox[i] = _enemies[i].hitbox();
+  }
+  _enemy_grid.rebuild(_enemy_x.data(), _enemy_y.data(), _enemy_hitbox.data(), enemy_count);
+
+  const auto shot_hitbox = _shots.hitbox();
+  const auto shot_damage = _shots.damage();
+  _shot_hits.assign(shot_count, 0u);
+  _hits.clear();
+  for (u32 i = 0; i < shot_count; ++i) {
+    const vec2 shot_pos = _shots.pos_at(i);
+    _enemy_grid.query_circle(shot_pos, shot_hitbox[i], [&](u32 idx) {
+      auto& enemy = _enemies[idx];
+      if (_shot_hits[i] || enemy.is_dead()) {
+        return;
+      }
+      if (!circles_overlap(shot_pos, shot_hitbox[i], {_enemy_x[idx], _enemy_y[idx]},
+                           _enemy_hitbox[idx])) {
+        return;
+      }
+      _shot_hits[i] = 1u;
+      if (enemy.damage(shot_damage[i])) {
+        _hits.push_back(_enemies.handle_at(idx));
+      }
+    });
+  }
+  _shots.clear_marked(_shot_hits.data());
+
+  // Same as player hits, handlers only get handles
+  for (const u64 handle : _hits) {
+    // Handlers can kill other enemies, those don't get a second death event
+    if (_enemies.is_alive(handle)) {
+      _enemy_death.trigger_event(handle);
+    }
+  }
+  for (const u64 handle : _hits) {
+    _enemies.kill(handle);
+  }
+}
+
+u32 stage_scene::cancel_projs() {
+  for (u32 i = 0; i < _projs.size(); ++i) {
+    _emit_cancel_particles(_projs.pos_at(i));
+  }
+  return _projs.clear();
+}
+
+u32 stage_scene::cancel_projs_circle(vec2 center, real radius) {
+  return _projs.clear_where([&](projectile_pool::view proj) {
+    const vec2 pos = proj.pos();
+    if (!circles_overlap(center, radius, pos, proj.hitbox())) {
+      return false;
+    }
+    _emit_cancel_particles(pos);
+    return true;
+  });
+}
+
+u32 stage_scene::cancel_projs_rect(vec2 min, vec2 max) {
+  return _projs.clear_where([&](projectile_pool::view proj) {
+    const vec2 pos = proj.pos();
+    if (pos.x < min.x || pos.x > max.x || pos.y < min.y || pos.y > max.y) {
+      return false;
+    }
+    _emit_cancel_particles(pos);
+    return true;
+  });
+}
+
+u32 stage_scene::convert_projs_circle(vec2 center, real radius, const item_args& args) {
+  return _projs.clear_where([&](projectile_pool::view proj) {
+    const vec2 pos = proj.pos();
+    if (!circles_overlap(center, radius, pos, proj.hitbox())) {
+      return false;
+    }
+    item_args item = args;
+    item.pos = pos;
+    _items.spawn(item);
+    _emit_cancel_particles(pos);
+    return true;
+  });
+}
+
+void stage_scene::_emit_cancel_particles(vec2 pos) {
+  if (_cancel_particles.has_value()) {
+    _particles.emit(*_cancel_particles, pos);
+  }
+}
+
+u32 stage_scene::_check_grazes() {
+  OKUU_PROFILE_ZONE("stage::grazes");
+  const vec2 player_pos = _player.pos();
+  const real graze_radius = _config.graze_radius;
+  const auto proj_hitbox = _projs.hitbox();
+  u32 grazed = 0u;
+  _proj_grid.query_circle(player_pos, graze_radius, [&](u32 idx) {
+    if (circles_overlap(player_pos, graze_radius, _projs.pos_at(idx), proj_hitbox[idx]) &&
+        _projs.graze_at(idx)) {
+      ++grazed;
+    }
+  });
+  _graze_count += grazed;
+  return grazed;
+}
+
+void stage_scene::_collect_items() {
+  OKUU_PROFILE_ZONE("stage::items");
+  const vec2 player_pos = _player.pos();
+  const real line = _config.playfield_size.y * (ITEM_COLLECT_LINE - .5f);
+  if (player_pos.y < line) {
+    _items.attract_all();
+  }
+  const item_totals totals = _items.tick(player_pos, ITEM_COLLECT_RADIUS);
+  if (totals.count > 0u) {
+    _item_collect.trigger_event(totals);
+  }
+}
+
+// Uses the grid from the graze pass, which doesn't run any handler
+void stage_scene::_check_player_hits() {
+  OKUU_PROFILE_ZONE("stage::player_hits");
+  const vec2 player_pos = _player.pos();
+  const real player_hitbox = _player.hitbox();
+  const auto proj_hitbox = _projs.hitbox();
+  _hits.clear();
+  _proj_grid.query_circle(player_pos, player_hitbox, [&](u32 idx) {
+    if (circles_overlap(player_pos, player_hitbox, _projs.pos_at(idx), proj_hitbox[idx])) {
+      _hits.push_back(_projs.handle_at(idx));
+    }
+  });
+
+  // Handlers might spawn or kill projectiles, so only touch the pool through handles from here
+  for (const u64 handle : _hits) {
+    // An earlier handler might have killed it already
+    if (_projs.is_alive(handle)) {
+      _player_hit.trigger_event(handle);
+    }
+  }
+  for (const u64 handle : _hits) {
+    _projs.kill(handle);
+  }
+
+  // Lasers are few but long, so they skip the grid and test their own segments
+  _hits.clear();
+  for (u32 i = 0; i < _lasers.size(); ++i) {
+    if (_lasers[i].hits(player_pos, player_hitbox)) {
+      _hits.push_back(_lasers.handle_at(i));
+    }
+  }
+  for (const u64 handle : _hits) {
+    if (_lasers.is_alive(handle)) {
+      _laser_hit.trigger_event(handle);
+    }
+  }
+}
+
 ntf::optional<u32> stage_scene::spawn_boss(const boss_args& args) {
   for (u32 i = 0; i < _boss_count; ++i) {
     auto& boss = _bosses[i];
@@ -1,8 +1,20 @@
 #pragma once
 
+#include "./collision.hpp"
+#include "./emitter.hpp"
+#include "./enemy.hpp"
 #include "./entity.hpp"
+#include "./handle_table.hpp"
+#include "./item.hpp"
+#include "./laser.hpp"
+#include "./particle.hpp"
+#include "./projectile.hpp"
 
 #include "../render/stage.hpp"
+#include "../util/event.hpp"
+#include "../util/rng.hpp"
+#include "../util/serialize.hpp"
+#include "../util/thread_pool.hpp"
 
 namespace okuu::stage {
 
@@ -14,89 +26,274 @@ namespace okuu::stage {
 //   requires(std::constructible_from<T, typename T::args_type>);
 // };
 
+// Densely packed entities with stable handles. Kills swap the last entity into the hole, so
+// iteration order is not preserved, but the storage can be split in index ranges.
 template<typename T>
 class entity_list {
 public:
   using args_type = typename T::args_type;
-  using entity_handle = u64;
+  using entity_handle = handle_table::handle_type;
 
 public:
   template<typename... Args>
   entity_handle spawn(Args&&... args) {
-    auto elem = _entities.emplace(std::forward<Args>(args)...);
-    return elem.as_u64();
+    const u32 idx = size();
+    _entities.emplace_back(std::forward<Args>(args)...);
+    const u32 slot = _handles.acquire(idx);
+    _dense_slot.push_back(slot);
+    return _handles.handle(slot);
   }
 
-  void kill(entity_handle handle) { _entities.remove(ntf::freelist_handle::from_u64(handle)); }
+  void kill(entity_handle handle) {
+    if (!is_alive(handle)) {
+      return;
+    }
+    _remove_at(_handles.index(handle_table::handle_slot(handle)));
+  }
 
-  bool is_alive(entity_handle handle) {
-    return _entities.is_valid(ntf::freelist_handle::from_u64(handle));
+  bool is_alive(entity_handle handle) const {
+    if (!_handles.is_valid(handle)) {
+      return false;
+    }
+    const u32 slot = handle_table::handle_slot(handle);
+    const u32 idx = _handles.index(slot);
+    return idx < size() && _dense_slot[idx] == slot;
   }
 
-  T& at(entity_handle handle) { return _entities[ntf::freelist_handle::from_u64(handle)]; }
+  T& at(entity_handle handle) {
+    NTF_ASSERT(is_alive(handle));
+    return _entities[_handles.index(handle_table::handle_slot(handle))];
+  }
 
   const T& at(entity_handle handle) const {
-    return _entities[ntf::freelist_handle::from_u64(handle)];
+    NTF_ASSERT(is_alive(handle));
+    return _entities[_handles.index(handle_table::handle_slot(handle))];
   }
 
+  u32 size() const { return static_cast<u32>(_entities.size()); }
+
+  T& operator[](u32 idx) { return _entities[idx]; }
+
+  entity_handle handle_at(u32 idx) const {
+    NTF_ASSERT(idx < size());
+    return _handles.handle(_dense_slot[idx]);
+  }
+
+  const T& operator[](u32 idx) const { return _entities[idx]; }
+
   template<typename F>
   void for_each(F&& func) {
-    for (auto& [ent, _] : _entities) {
+    for (auto& ent : _entities) {
       std::invoke(func, ent);
     }
   }
 
   template<typename F>
   void for_each(F&& func) const {
-    for (const auto& [ent, _] : _entities) {
+    for (const auto& ent : _entities) {
       std::invoke(func, ent);
     }
   }
 
   template<typename F>
   void clear_where(F&& func) {
-    _entities.remove_where(std::forward<F>(func));
+    for (u32 i = size(); i > 0u; --i) {
+      if (std::invoke(func, std::as_const(_entities[i - 1u]))) {
+        _remove_at(i - 1u);
+      }
+    }
+  }
+
+  // Entities go through T::save() and T::load(), handles stay valid across a save and load
+  void save(util::byte_writer& out) const {
+    out.write(_dense_slot);
+    _handles.save(out);
+    for (const auto& ent : _entities) {
+      ent.save(out);
+    }
+  }
+
+  void load(util::byte_reader& in) {
+    _entities.clear();
+    in.read(_dense_slot);
+    _handles.load(in);
+    _entities.reserve(_dense_slot.size());
+    for (u32 i = 0; i < _dense_slot.size() && in.ok(); ++i) {
+      _entities.push_back(T::load(in));
+    }
+  }
+
+private:
+  void _remove_at(u32 idx) {
+    const u32 slot = _dense_slot[idx];
+    const u32 last = size() - 1u;
+    if (idx != last) {
+      _entities[idx] = std::move(_entities[last]);
+      _dense_slot[idx] = _dense_slot[last];
+      _handles.relocate(_dense_slot[idx], idx);
+    }
+    _entities.pop_back();
+    _dense_slot.pop_back();
+    _handles.release(slot);
   }
 
 private:
-  ntf::freelist<T> _entities;
+  std::vector<T> _entities;
+  std::vector<u32> _dense_slot;
+  handle_table _handles;
+};
+
+// Texture and uvs for each particle desc, resolved once per frame
+using particle_sprites = std::vector<std::pair<shogle::texture2d_view, render::sprite_uvs>>;
+
+// Appends every live particle as a sprite instance
+void enqueue_particles(render::stage_renderer& renderer, const particle_system& particles,
+                       const particle_sprites& sprites, u32 ticks);
+
+struct stage_config {
+  vec2 playfield_size; // Centered on the origin
+  real cull_margin;    // Added to every projectile's own margin
+  real graze_radius;   // Around the player's center, projectiles inside it count as grazed
+  u64 seed;            // Same seed and inputs give the same run
+  u32 workers;         // Threads besides the ticking one, 0 runs everything inline
 };
 
 class stage_scene {
 public:
   static constexpr size_t MAX_BOSSES = 4u;
 
+  // Receives the handle of the projectile that hit the player, before it gets removed
+  using player_hit_event = util::event_handler<ntf::inplace_function<void(u64)>>;
+
+  // Receives the handle of an active laser touching the player, on every tick it keeps touching
+  using laser_hit_event = util::event_handler<ntf::inplace_function<void(u64)>>;
+
+  // Receives the handle of an enemy that ran out of hp, before it gets removed
+  using enemy_death_event = util::event_handler<ntf::inplace_function<void(u64)>>;
+
+  // Receives how many projectiles got grazed this tick, only on ticks with at least one
+  using graze_event = util::event_handler<ntf::inplace_function<void(u32)>>;
+
+  // Receives everything collected this tick, only on ticks with at least one item
+  using item_collect_event = util::event_handler<ntf::inplace_function<void(const item_totals&)>>;
+
 public:
-  stage_scene(player_entity&& player, render::stage_renderer&& renderer);
+  // Without a renderer the scene only simulates, render() can't be called
+  stage_scene(const stage_config& config, player_entity&& player,
+              ntf::optional<render::stage_renderer>&& renderer);
 
 public:
-  void tick();
+  void tick(input_state input);
   void render(double dt, double alpha, assets::asset_bundle& assets);
 
+  bool is_headless() const { return !_renderer.has_value(); }
+
+  // Hands the renderer over to another scene, this one is left headless
+  ntf::optional<render::stage_renderer> release_renderer();
+  void attach_renderer(ntf::optional<render::stage_renderer>&& renderer);
+
+  // Everything that changes while playing, see stage_snapshot. Lua state isn't included.
+  void save(util::byte_writer& out) const;
+  bool load(util::byte_reader& in);
+
 public:
-  entity_list<projectile_entity>& get_projectiles() { return _projs; }
+  projectile_pool& get_projectiles() { return _projs; }
 
   entity_list<sprite_entity>& get_sprites() { return _sprites; }
 
+  // Fired at the start of every tick, removed after their last shot
+  entity_list<pattern_emitter>& get_emitters() { return _emitters; }
+
+  entity_list<laser_entity>& get_lasers() { return _lasers; }
+
+  entity_list<enemy_entity>& get_enemies() { return _enemies; }
+
+  // Player shots, same storage as enemy bullets. Each one hits a single enemy and disappears.
+  projectile_pool& get_shots() { return _shots; }
+
+  item_pool& get_items() { return _items; }
+
+  particle_system& get_particles() { return _particles; }
+
+  // Burst emitted on every projectile removed by the bulk cancels below, nullopt for none
+  void cancel_particles(ntf::optional<particle_system::desc_id> desc) { _cancel_particles = desc; }
+
+  // Descs come from the stage script, they go away with it
+  void reset_particles();
+
+  // Bulk cancels, all of them return the number of removed projectiles
+  u32 cancel_projs();
+  u32 cancel_projs_circle(vec2 center, real radius);
+  u32 cancel_projs_rect(vec2 min, vec2 max);
+
+  // Cancels projectiles in a circle and spawns an item in their place. Positions are taken from
+  // each projectile.
+  u32 convert_projs_circle(vec2 center, real radius, const item_args& args);
+
   ntf::optional<u32> spawn_boss(const boss_args& args);
   void kill_boss(u32 slot);
   boss_entity& get_boss(u32 slot);
 
   player_entity& get_player() { return _player; }
 
-public:
-  void task_wait(u32 ticks) { _task_wait_ticks = ticks; }
+  player_hit_event& on_player_hit() { return _player_hit; }
+
+  laser_hit_event& on_laser_hit() { return _laser_hit; }
+
+  enemy_death_event& on_enemy_death() { return _enemy_death; }
+
+  graze_event& on_graze() { return _graze; }
 
-  u32 task_wait() const { return _task_wait_ticks; }
+  u32 graze_count() const { return _graze_count; }
+
+  item_collect_event& on_item_collect() { return _item_collect; }
+
+  const stage_config& config() const { return _config; }
+
+  // Drawn by native patterns, part of the snapshots
+  util::rng_stream& rng() { return _rng; }
+
+  // New stream that never overlaps with the scene one or any other split, for Lua tasks
+  util::rng_stream split_rng() { return _rng.split(); }
+
+private:
+  u32 _check_grazes(); // Only flags, returns the count for the graze event
+  void _check_player_hits();
+  void _collect_items();
+  void _emit_cancel_particles(vec2 pos);
+  void _check_shot_hits();
 
 private:
-  render::stage_renderer _renderer;
-  entity_list<projectile_entity> _projs;
+  stage_config _config;
+  ntf::optional<render::stage_renderer> _renderer;
+  projectile_pool _projs;
   entity_list<sprite_entity> _sprites;
+  entity_list<pattern_emitter> _emitters;
+  entity_list<laser_entity> _lasers;
+  entity_list<enemy_entity> _enemies;
+  projectile_pool _shots;
+  item_pool _items;
+  particle_system _particles;
+  ntf::optional<particle_system::desc_id> _cancel_particles;
   std::array<boss_entity, MAX_BOSSES> _bosses;
   u32 _boss_count;
   player_entity _player;
-  u32 _task_wait_ticks, _ticks;
+  uniform_grid _proj_grid;
+  uniform_grid _enemy_grid;
+  player_hit_event _player_hit;
+  laser_hit_event _laser_hit;
+  enemy_death_event _enemy_death;
+  graze_event _graze;
+  u32 _graze_count; // Total for the whole stage
+  item_collect_event _item_collect;
+  std::vector<u64> _hits;
+  std::vector<real> _enemy_x, _enemy_y, _enemy_hitbox;
+  std::vector<u8> _shot_hits;
+  std::vector<vec2> _laser_points;
+  particle_sprites _particle_sprites;
+  util::thread_pool _workers;
+  util::rng_stream _rng;
+  u32 _ticks;
 };
 
 } // namespace okuu::stage
@@ -1,94 +1,199 @@
 #pragma once
 
+#include "../core.hpp"
+
+#include <algorithm>
+#include <deque>
 #include <functional>
-#include <list>
 #include <string>
+#include <string_view>
 #include <unordered_map>
 
 namespace okuu::util {
 
+// Handlers live in a contiguous vector and get called in registration order. Removing one only
+// leaves a tombstone, the vector gets compacted once nothing is being dispatched. Handlers
+// registered while dispatching are held apart and only see the next trigger.
 template<typename F>
 class event_handler {
 public:
-  using event_iterator = std::list<F>::iterator;
+  using handler_id = u32;
+
+  static constexpr handler_id NULL_HANDLER = 0u;
+
+private:
+  struct entry {
+    F func;
+    handler_id id;
+    bool removed; // Tombstone, the id stays so the vector keeps sorted
+  };
 
 public:
   event_handler() = default;
 
 public:
   template<typename Func>
-  event_iterator register_event(Func&& func) {
-    return _events.emplace(_events.end(), std::forward<Func>(func));
+  handler_id register_event(Func&& func) {
+    const handler_id id = ++_last_id;
+    auto& entries = _dispatching > 0u ? _pending : _entries;
+    entries.push_back(entry{F{std::forward<Func>(func)}, id, false});
+    return id;
   }
 
   template<typename... Args>
   void trigger_event(Args&&... args) {
-    for (auto& event : _events) {
-      std::invoke(event, std::forward<Args>(args)...);
+    ++_dispatching;
+    const size_t count = _entries.size();
+    for (size_t i = 0; i < count; ++i) {
+      if (!_entries[i].removed) {
+        std::invoke(_entries[i].func, args...);
+      }
+    }
+    if (--_dispatching == 0u) {
+      _flush();
     }
   }
 
-  void unregister_event(event_iterator event) { _events.erase(event); }
+  void unregister_event(handler_id id) {
+    if (_remove_from(_entries, id)) {
+      ++_dead;
+      if (_dispatching == 0u) {
+        _flush();
+      }
+      return;
+    }
+    if (_remove_from(_pending, id)) {
+      ++_dead;
+    }
+  }
+
+  void clear_events() {
+    if (_dispatching == 0u) {
+      _entries.clear();
+      _pending.clear();
+      _dead = 0u;
+      return;
+    }
+    for (auto& ent : _entries) {
+      if (!ent.removed) {
+        ent.removed = true;
+        ++_dead;
+      }
+    }
+    _pending.clear();
+  }
+
+  u32 size() const { return static_cast<u32>(_entries.size() + _pending.size()) - _dead; }
+
+private:
+  // Ids only grow, so both vectors stay sorted
+  static bool _remove_from(std::vector<entry>& entries, handler_id id) {
+    auto it = std::lower_bound(entries.begin(), entries.end(), id,
+                               [](const entry& ent, handler_id val) { return ent.id < val; });
+    if (it == entries.end() || it->id != id || it->removed) {
+      return false;
+    }
+    it->removed = true;
+    return true;
+  }
 
-  void clear_events() { _events.clear(); }
+  void _flush() {
+    if (_dead > 0u) {
+      std::erase_if(_entries, [](const entry& ent) { return ent.removed; });
+      std::erase_if(_pending, [](const entry& ent) { return ent.removed; });
+      _dead = 0u;
+    }
+    if (!_pending.empty()) {
+      std::move(_pending.begin(), _pending.end(), std::back_inserter(_entries));
+      _pending.clear();
+    }
+  }
 
 private:
-  std::list<F> _events;
+  std::vector<entry> _entries;
+  std::vector<entry> _pending;
+  handler_id _last_id{NULL_HANDLER};
+  u32 _dead{0u};
+  u32 _dispatching{0u};
 };
 
+// Named events. Names get interned to integer ids the first time they show up, everything after
+// that goes through the id without hashing strings.
 template<typename F>
 class multi_event_handler {
 public:
-  using event_iterator = event_handler<F>::event_iterator;
+  using event_id = u32;
+  using handler_id = event_handler<F>::handler_id;
+
+private:
+  struct name_hash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view name) const { return std::hash<std::string_view>{}(name); }
+  };
 
 public:
   multi_event_handler() = default;
 
 public:
-  template<typename Func>
-  event_iterator register_event(const std::string& name, Func&& func) {
-    auto it = _events.find(name);
-    if (it == _events.end()) {
-      auto [it2, empl] = _events.try_emplace(std::move(name));
-      it = it2;
+  event_id intern(std::string_view name) {
+    auto it = _ids.find(name);
+    if (it != _ids.end()) {
+      return it->second;
+    }
+    const event_id id = static_cast<event_id>(_events.size());
+    _events.emplace_back();
+    _ids.emplace(std::string{name}, id);
+    return id;
+  }
+
+  ntf::optional<event_id> find(std::string_view name) const {
+    auto it = _ids.find(name);
+    if (it == _ids.end()) {
+      return {ntf::nullopt};
     }
-    NTF_ASSERT(it != _events.end());
-    return it->second.register_event(std::forward<Func>(func));
+    return {ntf::in_place, it->second};
+  }
+
+  bool is_valid(event_id event) const { return event < _events.size(); }
+
+  template<typename Func>
+  handler_id register_event(event_id event, Func&& func) {
+    NTF_ASSERT(is_valid(event));
+    return _events[event].register_event(std::forward<Func>(func));
   }
 
   template<typename... Args>
-  void trigger_event(const std::string& name, Args&&... args) {
-    auto it = _events.find(name);
-    if (it == _events.end()) {
+  void trigger_event(event_id event, Args&&... args) {
+    if (!is_valid(event)) {
       return;
     }
-    it->second.trigger_event(std::forward<Args>(args)...);
+    _events[event].trigger_event(std::forward<Args>(args)...);
   }
 
-  void unregister_event(const std::string& name, event_iterator event) {
-    auto it = _events.find(name);
-    if (it == _events.end()) {
+  void unregister_event(event_id event, handler_id handler) {
+    if (!is_valid(event)) {
       return;
     }
-    it->second.unregister_event(event);
+    _events[event].unregister_event(handler);
   }
 
-  void clear_events(const std::string& name) {
-    auto it = _events.find(name);
-    if (it == _events.end()) {
+  void clear_events(event_id event) {
+    if (!is_valid(event)) {
       return;
     }
-    it->second.clear_events();
+    _events[event].clear_events();
   }
 
   void clear_events() {
-    for (auto& [_, handler] : _events) {
+    for (auto& handler : _events) {
       handler.clear_events();
     }
   }
 
 private:
-  std::unordered_map<std::string, event_handler<F>> _events;
+  std::unordered_map<std::string, event_id, name_hash, std::equal_to<>> _ids;
+  std::deque<event_handler<F>> _events; // Handlers can intern new names while being dispatched
 };
 
 } // namespace okuu::util
@@ -0,0 +1,135 @@
+#include "./profiler.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace okuu::util {
+
+namespace {
+
+struct profile_event {
+  const char* name;
+  u64 begin_ns;
+  u64 end_ns;
+};
+
+struct thread_ring {
+  thread_ring(u32 tid_) :
+      tid{tid_}, events{std::make_unique<profile_event[]>(profiler::RING_SIZE)} {}
+
+  u32 tid;
+  std::unique_ptr<profile_event[]> events;
+  std::atomic<u64> head{0u};
+};
+
+// Rings outlive their threads, so zones from finished workers still make it to the dump. A
+// finished thread's ring goes back to the free list and the next new thread records over it,
+// otherwise every short lived thread would keep its own ring around forever.
+struct ring_registry {
+  std::mutex mtx;
+  std::vector<std::unique_ptr<thread_ring>> rings;
+  std::vector<thread_ring*> free_rings;
+};
+
+ring_registry& registry() {
+  static ring_registry reg;
+  return reg;
+}
+
+struct ring_owner {
+  ~ring_owner() noexcept {
+    if (!ring) {
+      return;
+    }
+    auto& reg = registry();
+    std::unique_lock lock{reg.mtx};
+    reg.free_rings.push_back(ring);
+  }
+
+  thread_ring* ring{nullptr};
+};
+
+thread_ring& local_ring() {
+  thread_local ring_owner owner;
+  if (!owner.ring) {
+    auto& reg = registry();
+    std::unique_lock lock{reg.mtx};
+    if (!reg.free_rings.empty()) {
+      // Keeps the old events and tid, they show up as the same thread in the dump
+      owner.ring = reg.free_rings.back();
+      reg.free_rings.pop_back();
+    } else {
+      const u32 tid = static_cast<u32>(reg.rings.size());
+      owner.ring = reg.rings.emplace_back(std::make_unique<thread_ring>(tid)).get();
+    }
+  }
+  return *owner.ring;
+}
+
+const auto g_epoch = std::chrono::steady_clock::now();
+
+} // namespace
+
+bool profiler::is_enabled() {
+#if defined(OKUU_ENABLE_PROFILER)
+  return true;
+#else
+  return false;
+#endif
+}
+
+u64 profiler::now_ns() {
+  const auto elapsed = std::chrono::steady_clock::now() - g_epoch;
+  return static_cast<u64>(std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+}
+
+void profiler::record(const char* name, u64 begin_ns, u64 end_ns) {
+  auto& ring = local_ring();
+  const u64 head = ring.head.load(std::memory_order_relaxed);
+  ring.events[head & (RING_SIZE - 1u)] = {name, begin_ns, end_ns};
+  ring.head.store(head + 1u, std::memory_order_release);
+}
+
+bool profiler::dump(const std::string& path) {
+  std::ofstream file{path};
+  if (!file) {
+    logger::error("Failed to open trace file \"{}\"", path);
+    return false;
+  }
+
+  auto& reg = registry();
+  std::unique_lock lock{reg.mtx};
+  u64 written = 0u;
+  file << "{\"traceEvents\":[\n";
+  const auto put_sep = [&]() {
+    if (written++ > 0u) {
+      file << ",\n";
+    }
+  };
+  for (const auto& ring : reg.rings) {
+    put_sep();
+    file << fmt::format("{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":{},"
+                        "\"args\":{{\"name\":\"thread{}\"}}}}",
+                        ring->tid, ring->tid);
+
+    const u64 head = ring->head.load(std::memory_order_acquire);
+    const u64 first = head > RING_SIZE ? head - RING_SIZE : 0u;
+    for (u64 i = first; i < head; ++i) {
+      const auto& ev = ring->events[i & (RING_SIZE - 1u)];
+      put_sep();
+      // Timestamps in microseconds
+      file << fmt::format("{{\"name\":\"{}\",\"ph\":\"X\",\"pid\":0,\"tid\":{},\"ts\":{:.3f},"
+                          "\"dur\":{:.3f}}}",
+                          ev.name, ring->tid, static_cast<f64>(ev.begin_ns) * 1e-3,
+                          static_cast<f64>(ev.end_ns - ev.begin_ns) * 1e-3);
+    }
+  }
+  file << "\n]}\n";
+  logger::info("Wrote {} trace events to \"{}\"", written, path);
+  return static_cast<bool>(file);
+}
+
+} // namespace okuu::util
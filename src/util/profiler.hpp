@@ -0,0 +1,50 @@
+#pragma once
+
+#include "../core.hpp"
+
+// Scoped zone for the Chrome trace profiler, the name has to be a string literal. Compiles to
+// nothing unless the build defines OKUU_ENABLE_PROFILER.
+#if defined(OKUU_ENABLE_PROFILER)
+#define OKUU_PROFILE_CONCAT_IMPL(a, b) a##b
+#define OKUU_PROFILE_CONCAT(a, b)      OKUU_PROFILE_CONCAT_IMPL(a, b)
+#define OKUU_PROFILE_ZONE(name) \
+  const ::okuu::util::profile_zone OKUU_PROFILE_CONCAT(_okuu_zone_, __LINE__) { name }
+#else
+#define OKUU_PROFILE_ZONE(name) ((void)0)
+#endif
+
+namespace okuu::util {
+
+// Zones get recorded in a ring buffer owned by the calling thread, so recording never locks. Only
+// the last RING_SIZE zones of each thread are kept.
+class profiler {
+public:
+  static constexpr u32 RING_SIZE = 1u << 16u;
+
+public:
+  static bool is_enabled();
+
+  // Nanoseconds since the profiler epoch
+  static u64 now_ns();
+  static void record(const char* name, u64 begin_ns, u64 end_ns);
+
+  // Writes every thread's buffer as Chrome trace event JSON (chrome://tracing, Perfetto). Safe to
+  // call while other threads record, zones overwritten meanwhile might show up garbled.
+  static bool dump(const std::string& path);
+};
+
+class profile_zone {
+public:
+  explicit profile_zone(const char* name) noexcept : _name{name}, _begin{profiler::now_ns()} {}
+
+  ~profile_zone() noexcept { profiler::record(_name, _begin, profiler::now_ns()); }
+
+  profile_zone(const profile_zone&) = delete;
+  profile_zone& operator=(const profile_zone&) = delete;
+
+private:
+  const char* _name;
+  u64 _begin;
+};
+
+} // namespace okuu::util
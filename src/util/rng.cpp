@@ -0,0 +1,204 @@
+#include "./rng.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+#if defined(__SSE2__)
+#define OKUU_RNG_SSE2 1
+#include <emmintrin.h>
+#endif
+
+namespace okuu::util {
+
+namespace {
+
+constexpr real U24_SCALE = 1.f / 16777216.f;
+
+constexpr std::array<u32, 4> JUMP_POLY{0x8764000bu, 0xf542d2d3u, 0x6fa035c3u, 0x77f2db5bu};
+
+u64 splitmix64(u64& state) {
+  u64 z = (state += 0x9e3779b97f4a7c15ull);
+  z = (z ^ (z >> 30u)) * 0xbf58476d1ce4e5b9ull;
+  z = (z ^ (z >> 27u)) * 0x94d049bb133111ebull;
+  return z ^ (z >> 31u);
+}
+
+void seed_state(u64& seed, u32* s0, u32* s1, u32* s2, u32* s3) {
+  const u64 a = splitmix64(seed);
+  const u64 b = splitmix64(seed);
+  *s0 = static_cast<u32>(a);
+  *s1 = static_cast<u32>(a >> 32u);
+  *s2 = static_cast<u32>(b);
+  *s3 = static_cast<u32>(b >> 32u);
+}
+
+u32 rotl(u32 x, u32 k) {
+  return (x << k) | (x >> (32u - k));
+}
+
+u32 xoshiro_next(u32& s0, u32& s1, u32& s2, u32& s3) {
+  const u32 result = rotl(s0 + s3, 7u) + s0;
+  const u32 t = s1 << 9u;
+  s2 ^= s0;
+  s3 ^= s1;
+  s1 ^= s2;
+  s0 ^= s3;
+  s2 ^= t;
+  s3 = rotl(s3, 11u);
+  return result;
+}
+
+void xoshiro_jump(u32& s0, u32& s1, u32& s2, u32& s3) {
+  u32 j0 = 0u, j1 = 0u, j2 = 0u, j3 = 0u;
+  for (const u32 poly : JUMP_POLY) {
+    for (u32 bit = 0; bit < 32u; ++bit) {
+      if (poly & (1u << bit)) {
+        j0 ^= s0;
+        j1 ^= s1;
+        j2 ^= s2;
+        j3 ^= s3;
+      }
+      xoshiro_next(s0, s1, s2, s3);
+    }
+  }
+  s0 = j0;
+  s1 = j1;
+  s2 = j2;
+  s3 = j3;
+}
+
+real to_uniform(u32 x) {
+  return static_cast<real>(x >> 8u) * U24_SCALE;
+}
+
+// Box-Muller over a pair of uniforms, 1 - u1 keeps the log away from zero
+std::pair<real, real> box_muller(real u1, real u2) {
+  const real radius = std::sqrt(-2.f * std::log(1.f - u1));
+  const real theta = 2.f * std::numbers::pi_v<real> * u2;
+  return {radius * std::cos(theta), radius * std::sin(theta)};
+}
+
+// One uniform per lane, written to out[0..BULK_LANES)
+void lanes_next(u32* lanes, real* out) {
+#ifdef OKUU_RNG_SSE2
+  const auto rotl_sse2 = [](__m128i x, int k) {
+    return _mm_or_si128(_mm_slli_epi32(x, k), _mm_srli_epi32(x, 32 - k));
+  };
+  auto* ptr = reinterpret_cast<__m128i*>(lanes);
+  __m128i s0 = _mm_load_si128(ptr + 0);
+  __m128i s1 = _mm_load_si128(ptr + 1);
+  __m128i s2 = _mm_load_si128(ptr + 2);
+  __m128i s3 = _mm_load_si128(ptr + 3);
+  const __m128i result = _mm_add_epi32(rotl_sse2(_mm_add_epi32(s0, s3), 7), s0);
+  const __m128i t = _mm_slli_epi32(s1, 9);
+  s2 = _mm_xor_si128(s2, s0);
+  s3 = _mm_xor_si128(s3, s1);
+  s1 = _mm_xor_si128(s1, s2);
+  s0 = _mm_xor_si128(s0, s3);
+  s2 = _mm_xor_si128(s2, t);
+  s3 = rotl_sse2(s3, 11);
+  _mm_store_si128(ptr + 0, s0);
+  _mm_store_si128(ptr + 1, s1);
+  _mm_store_si128(ptr + 2, s2);
+  _mm_store_si128(ptr + 3, s3);
+  // Exact conversion, same as to_uniform()
+  const __m128 vals = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(result, 8)),
+                                 _mm_set1_ps(U24_SCALE));
+  _mm_storeu_ps(out, vals);
+#else
+  constexpr u32 N = rng_stream::BULK_LANES;
+  for (u32 l = 0; l < N; ++l) {
+    out[l] = to_uniform(xoshiro_next(lanes[l], lanes[N + l], lanes[(2u * N) + l],
+                                     lanes[(3u * N) + l]));
+  }
+#endif
+}
+
+} // namespace
+
+rng_stream::rng_stream(u64 seed) : _state{}, _lanes{} {
+  seed_state(seed, &_state[0], &_state[1], &_state[2], &_state[3]);
+  constexpr u32 N = BULK_LANES;
+  for (u32 l = 0; l < N; ++l) {
+    seed_state(seed, &_lanes[l], &_lanes[N + l], &_lanes[(2u * N) + l], &_lanes[(3u * N) + l]);
+  }
+}
+
+u32 rng_stream::next_u32() {
+  return xoshiro_next(_state[0], _state[1], _state[2], _state[3]);
+}
+
+real rng_stream::uniform() {
+  return to_uniform(next_u32());
+}
+
+i32 rng_stream::int_range(i32 min, i32 max) {
+  if (min > max) {
+    std::swap(min, max);
+  }
+  const u64 span = static_cast<u64>(static_cast<i64>(max) - static_cast<i64>(min)) + 1u;
+  const u64 offset = (static_cast<u64>(next_u32()) * span) >> 32u;
+  return static_cast<i32>(static_cast<i64>(min) + static_cast<i64>(offset));
+}
+
+real rng_stream::normal() {
+  const real u1 = uniform();
+  const real u2 = uniform();
+  return box_muller(u1, u2).first;
+}
+
+rng_stream rng_stream::split() {
+  rng_stream other = *this;
+  _jump();
+  return other;
+}
+
+void rng_stream::fill_uniform(real* out, u32 count) {
+  constexpr u32 N = BULK_LANES;
+  u32 i = 0;
+  for (; i + N <= count; i += N) {
+    lanes_next(_lanes.data(), out + i);
+  }
+  if (i < count) {
+    // The lanes advance as a whole, the leftover values get dropped
+    std::array<real, N> tail;
+    lanes_next(_lanes.data(), tail.data());
+    std::copy_n(tail.begin(), count - i, out + i);
+  }
+}
+
+void rng_stream::fill_normal(real* out, u32 count) {
+  fill_uniform(out, count);
+  u32 i = 0;
+  for (; i + 2u <= count; i += 2u) {
+    const auto [a, b] = box_muller(out[i], out[i + 1u]);
+    out[i] = a;
+    out[i + 1u] = b;
+  }
+  if (i < count) {
+    std::array<real, BULK_LANES> extra;
+    lanes_next(_lanes.data(), extra.data());
+    out[i] = box_muller(out[i], extra[0]).first;
+  }
+}
+
+void rng_stream::save(byte_writer& out) const {
+  out.write(_state);
+  out.write(_lanes);
+}
+
+void rng_stream::load(byte_reader& in) {
+  in.read(_state);
+  in.read(_lanes);
+}
+
+void rng_stream::_jump() {
+  xoshiro_jump(_state[0], _state[1], _state[2], _state[3]);
+  constexpr u32 N = BULK_LANES;
+  for (u32 l = 0; l < N; ++l) {
+    xoshiro_jump(_lanes[l], _lanes[N + l], _lanes[(2u * N) + l], _lanes[(3u * N) + l]);
+  }
+}
+
+} // namespace okuu::util
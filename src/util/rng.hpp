@@ -0,0 +1,54 @@
+#pragma once
+
+#include "../core.hpp"
+#include "./serialize.hpp"
+
+#include <array>
+
+namespace okuu::util {
+
+// xoshiro128++ streams, seeded through splitmix64 so nearby seeds still give unrelated sequences.
+// Every stream also carries four extra lanes for the bulk fills, which get advanced together with
+// SSE2 when available. The scalar fallback walks the lanes in the same order, so the output only
+// depends on the seed and never on the machine.
+class rng_stream {
+public:
+  static constexpr u32 BULK_LANES = 4u;
+
+public:
+  explicit rng_stream(u64 seed = 0u);
+
+public:
+  u32 next_u32();
+
+  // [0, 1), 24 bits of precision
+  real uniform();
+
+  real range(real min, real max) { return min + ((max - min) * uniform()); }
+
+  // [min, max], both ends included
+  i32 int_range(i32 min, i32 max);
+
+  // Standard normal through Box-Muller
+  real normal();
+
+  // Returns a copy of this stream and moves this one 2^64 draws ahead, so both can be used
+  // without ever overlapping
+  rng_stream split();
+
+  // Only draw from the bulk lanes, scalar draws aren't affected
+  void fill_uniform(real* out, u32 count);
+  void fill_normal(real* out, u32 count);
+
+  void save(byte_writer& out) const;
+  void load(byte_reader& in);
+
+private:
+  void _jump();
+
+private:
+  std::array<u32, 4> _state;
+  alignas(16) std::array<u32, 4 * BULK_LANES> _lanes; // s0 for every lane, then s1, s2 and s3
+};
+
+} // namespace okuu::util
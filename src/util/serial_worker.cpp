@@ -0,0 +1,60 @@
+#include "./serial_worker.hpp"
+
+namespace okuu::util {
+
+serial_worker::serial_worker() :
+    _jobs{}, _busy{false}, _stop{false}, _thread{[this]() { _worker_loop(); }} {}
+
+serial_worker::~serial_worker() noexcept {
+  {
+    std::unique_lock lock{_mtx};
+    _stop = true;
+  }
+  _job_cv.notify_all();
+  _thread.join();
+}
+
+void serial_worker::_push(std::unique_ptr<job_base> job) {
+  {
+    std::unique_lock lock{_mtx};
+    _jobs.emplace_back(std::move(job));
+  }
+  _job_cv.notify_one();
+}
+
+void serial_worker::wait() {
+  std::unique_lock lock{_mtx};
+  _idle_cv.wait(lock, [this]() { return _jobs.empty() && !_busy; });
+}
+
+bool serial_worker::idle() const {
+  std::unique_lock lock{_mtx};
+  return _jobs.empty() && !_busy;
+}
+
+void serial_worker::_worker_loop() {
+  for (;;) {
+    std::unique_ptr<job_base> job;
+    {
+      std::unique_lock lock{_mtx};
+      _job_cv.wait(lock, [this]() { return _stop || !_jobs.empty(); });
+      if (_jobs.empty()) {
+        return; // Only once stopped, queued jobs still run
+      }
+      job = std::move(_jobs.front());
+      _jobs.pop_front();
+      _busy = true;
+    }
+
+    job->run();
+    job.reset(); // Whatever it captured goes away on this thread too
+
+    {
+      std::unique_lock lock{_mtx};
+      _busy = false;
+    }
+    _idle_cv.notify_all();
+  }
+}
+
+} // namespace okuu::util
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "../core.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace okuu::util {
+
+// One background thread running jobs in the order they were pushed, for work that has to stay
+// off the main thread but can't be split like thread_pool jobs. Jobs can be move only.
+class serial_worker {
+private:
+  struct job_base {
+    virtual ~job_base() = default;
+    virtual void run() = 0;
+  };
+
+  template<typename F>
+  struct job_impl final : public job_base {
+    template<typename U>
+    explicit job_impl(U&& f) : func{std::forward<U>(f)} {}
+
+    void run() override { std::invoke(func); }
+
+    F func;
+  };
+
+public:
+  serial_worker();
+  ~serial_worker() noexcept; // Runs whatever is still queued first
+
+  serial_worker(const serial_worker&) = delete;
+  serial_worker& operator=(const serial_worker&) = delete;
+
+public:
+  template<typename F>
+  void push(F&& func) {
+    _push(std::make_unique<job_impl<std::decay_t<F>>>(std::forward<F>(func)));
+  }
+
+  // Blocks until every job pushed so far is done
+  void wait();
+
+  bool idle() const;
+
+private:
+  void _push(std::unique_ptr<job_base> job);
+  void _worker_loop();
+
+private:
+  mutable std::mutex _mtx;
+  std::condition_variable _job_cv;
+  std::condition_variable _idle_cv;
+  std::deque<std::unique_ptr<job_base>> _jobs;
+  bool _busy;
+  bool _stop;
+  std::thread _thread; // Last, starts after everything it reads
+};
+
+} // namespace okuu::util
@@ -0,0 +1,169 @@
+#pragma once
+
+#include "../core.hpp"
+
+#include <array>
+#include <bit>
+#include <cstring>
+#include <tuple>
+
+namespace okuu::util {
+
+namespace impl {
+
+template<typename T>
+struct is_compound_value : std::false_type {};
+
+template<typename... Ts>
+struct is_compound_value<std::tuple<Ts...>> : std::true_type {};
+
+template<typename T>
+struct is_compound_value<ntf::optional<T>> : std::true_type {};
+
+template<typename T>
+struct is_compound_value<std::vector<T>> : std::true_type {};
+
+} // namespace impl
+
+// Written as raw bytes, containers get written element by element even when trivially copyable so
+// both sides agree on the layout
+template<typename T>
+concept byte_copyable = std::is_trivially_copyable_v<T> && !impl::is_compound_value<T>::value;
+
+// Appends values as raw bytes in host layout. Only meant for in-memory snapshots, the output
+// isn't portable between builds.
+class byte_writer {
+public:
+  explicit byte_writer(std::vector<u8>& out) noexcept : _out{&out} {}
+
+public:
+  void write_bytes(const void* data, size_t size) {
+    const size_t offset = _out->size();
+    _out->resize(offset + size);
+    if (size > 0u) {
+      std::memcpy(_out->data() + offset, data, size);
+    }
+  }
+
+  template<byte_copyable T>
+  void write(const T& value) {
+    write_bytes(&value, sizeof(T));
+  }
+
+  template<typename... Ts>
+  void write(const std::tuple<Ts...>& value) {
+    std::apply([this](const auto&... elems) { (write(elems), ...); }, value);
+  }
+
+  template<typename T>
+  void write(const ntf::optional<T>& value) {
+    write<u8>(value.has_value());
+    if (value.has_value()) {
+      write(*value);
+    }
+  }
+
+  template<typename T>
+  void write(const std::vector<T>& vec) {
+    write<u32>(static_cast<u32>(vec.size()));
+    if constexpr (byte_copyable<T>) {
+      write_bytes(vec.data(), vec.size() * sizeof(T));
+    } else {
+      for (const auto& elem : vec) {
+        write(elem);
+      }
+    }
+  }
+
+  size_t size() const { return _out->size(); }
+
+private:
+  std::vector<u8>* _out;
+};
+
+// Reads back what byte_writer wrote. Running past the end doesn't throw, it flags the reader and
+// returns zeroed values, so check ok() once everything has been read.
+class byte_reader {
+public:
+  byte_reader(const u8* data, size_t size) noexcept : _data{data}, _size{size}, _pos{0u} {}
+
+public:
+  bool read_bytes(void* dst, size_t size) {
+    if (size > _size - _pos) {
+      _pos = _size;
+      _failed = true;
+      std::memset(dst, 0, size);
+      return false;
+    }
+    if (size > 0u) {
+      std::memcpy(dst, _data + _pos, size);
+    }
+    _pos += size;
+    return true;
+  }
+
+  template<typename T>
+  T read() {
+    if constexpr (byte_copyable<T>) {
+      std::array<std::byte, sizeof(T)> bytes;
+      read_bytes(bytes.data(), bytes.size());
+      return std::bit_cast<T>(bytes);
+    } else {
+      return _read_compound(static_cast<T*>(nullptr));
+    }
+  }
+
+  template<typename T>
+  void read(T& value) {
+    value = read<T>();
+  }
+
+  bool ok() const { return !_failed; }
+
+  bool at_end() const { return _pos == _size; }
+
+private:
+  template<typename... Ts>
+  std::tuple<Ts...> _read_compound(std::tuple<Ts...>*) {
+    // Braced init evaluates in order
+    return std::tuple<Ts...>{read<Ts>()...};
+  }
+
+  template<typename T>
+  ntf::optional<T> _read_compound(ntf::optional<T>*) {
+    if (read<u8>() == 0u) {
+      return {ntf::nullopt};
+    }
+    return ntf::optional<T>{ntf::in_place, read<T>()};
+  }
+
+  template<typename T>
+  std::vector<T> _read_compound(std::vector<T>*) {
+    const u32 count = read<u32>();
+    std::vector<T> vec;
+    if (count > _size - _pos) {
+      // Every element takes at least a byte, don't allocate for garbage counts
+      _pos = _size;
+      _failed = true;
+      return vec;
+    }
+    if constexpr (byte_copyable<T> && std::is_default_constructible_v<T>) {
+      vec.resize(count);
+      read_bytes(vec.data(), count * sizeof(T));
+    } else {
+      vec.reserve(count);
+      for (u32 i = 0; i < count && ok(); ++i) {
+        vec.push_back(read<T>());
+      }
+    }
+    return vec;
+  }
+
+private:
+  const u8* _data;
+  size_t _size;
+  size_t _pos;
+  bool _failed{false};
+};
+
+} // namespace okuu::util
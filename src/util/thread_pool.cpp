@@ -0,0 +1,92 @@
+#include "./thread_pool.hpp"
+
+namespace okuu::util {
+
+thread_pool::thread_pool(u32 workers) :
+    _workers{}, _callback{nullptr}, _user{nullptr}, _count{0u}, _chunk_size{0u}, _chunks{0u},
+    _next_chunk{0u}, _done_chunks{0u}, _active{0u}, _job_id{0u}, _stop{false} {
+  _workers.reserve(workers);
+  for (u32 i = 0; i < workers; ++i) {
+    _workers.emplace_back([this]() { _worker_loop(); });
+  }
+}
+
+thread_pool::~thread_pool() noexcept {
+  {
+    std::unique_lock lock{_mtx};
+    _stop = true;
+  }
+  _job_cv.notify_all();
+  for (auto& worker : _workers) {
+    worker.join();
+  }
+}
+
+u32 thread_pool::default_workers() {
+  const u32 hw_threads = std::thread::hardware_concurrency();
+  return hw_threads > 1u ? hw_threads - 1u : 0u;
+}
+
+void thread_pool::_run(job_callback callback, void* user, u32 count, u32 chunk_size) {
+  {
+    // Workers read the job without locking, so wait until the ones from the last job have left
+    std::unique_lock lock{_mtx};
+    _done_cv.wait(lock, [this]() { return _active == 0u; });
+    _callback = callback;
+    _user = user;
+    _count = count;
+    _chunk_size = chunk_size;
+    _chunks = (count + chunk_size - 1u) / chunk_size;
+    _done_chunks.store(0u);
+    _next_chunk.store(0u);
+    ++_job_id;
+  }
+  _job_cv.notify_all();
+
+  _run_chunks();
+
+  std::unique_lock lock{_mtx};
+  _done_cv.wait(lock, [this]() { return _done_chunks.load() == _chunks; });
+}
+
+void thread_pool::_run_chunks() {
+  for (;;) {
+    const u32 chunk = _next_chunk.fetch_add(1u);
+    if (chunk >= _chunks) {
+      return;
+    }
+    const u32 begin = chunk * _chunk_size;
+    const u32 end = std::min(begin + _chunk_size, _count);
+    _callback(_user, begin, end);
+
+    if (_done_chunks.fetch_add(1u) + 1u == _chunks) {
+      std::unique_lock lock{_mtx};
+      _done_cv.notify_all();
+    }
+  }
+}
+
+void thread_pool::_worker_loop() {
+  u64 last_job = 0u;
+  for (;;) {
+    {
+      std::unique_lock lock{_mtx};
+      _job_cv.wait(lock, [&]() { return _stop || _job_id != last_job; });
+      if (_stop) {
+        return;
+      }
+      last_job = _job_id;
+      ++_active;
+    }
+
+    _run_chunks();
+
+    {
+      std::unique_lock lock{_mtx};
+      --_active;
+    }
+    _done_cv.notify_all();
+  }
+}
+
+} // namespace okuu::util
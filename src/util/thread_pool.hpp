@@ -0,0 +1,73 @@
+#pragma once
+
+#include "../core.hpp"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace okuu::util {
+
+// Fixed set of worker threads for data parallel loops. The calling thread also takes chunks, so
+// a pool with zero workers just runs everything inline.
+class thread_pool {
+private:
+  using job_callback = void (*)(void* user, u32 begin, u32 end);
+
+public:
+  explicit thread_pool(u32 workers = default_workers());
+  ~thread_pool() noexcept;
+
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+public:
+  static u32 default_workers();
+
+public:
+  // Splits [0, count) in chunks of chunk_size and calls func(begin, end) for each one, blocking
+  // until all of them are done. Chunk boundaries only depend on count and chunk_size.
+  template<typename F>
+  void parallel_for(u32 count, u32 chunk_size, F&& func) {
+    NTF_ASSERT(chunk_size > 0u);
+    if (count == 0u) {
+      return;
+    }
+    if (count <= chunk_size || _workers.empty()) {
+      std::invoke(func, 0u, count);
+      return;
+    }
+
+    using func_type = std::remove_reference_t<F>;
+    const auto callback = [](void* user, u32 begin, u32 end) {
+      std::invoke(*static_cast<func_type*>(user), begin, end);
+    };
+    void* user = const_cast<void*>(static_cast<const void*>(std::addressof(func)));
+    _run(callback, user, count, chunk_size);
+  }
+
+  u32 thread_count() const { return static_cast<u32>(_workers.size()) + 1u; }
+
+private:
+  void _run(job_callback callback, void* user, u32 count, u32 chunk_size);
+  void _run_chunks();
+  void _worker_loop();
+
+private:
+  std::vector<std::thread> _workers;
+  std::mutex _mtx;
+  std::condition_variable _job_cv;
+  std::condition_variable _done_cv;
+
+  job_callback _callback;
+  void* _user;
+  u32 _count, _chunk_size, _chunks;
+  std::atomic<u32> _next_chunk;
+  std::atomic<u32> _done_chunks;
+  u32 _active;
+  u64 _job_id;
+  bool _stop;
+};
+
+} // namespace okuu::util
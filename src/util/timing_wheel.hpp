@@ -0,0 +1,164 @@
+#pragma once
+
+#include "../core.hpp"
+
+#include <array>
+#include <utility>
+
+namespace okuu::util {
+
+// Hierarchical timing wheel, 4 levels of 64 slots each. Scheduling and cancelling are O(1),
+// advancing only touches the slot due this tick, plus a cascade from an upper level once every 64
+// ticks. Delays are clamped to 64^4 - 1 ticks (about 77 hours at 60 UPS).
+template<typename T>
+class timing_wheel {
+public:
+  using timer_id = u64;
+
+  static constexpr u32 LEVEL_BITS = 6u;
+  static constexpr u32 LEVEL_SIZE = 1u << LEVEL_BITS;
+  static constexpr u32 LEVEL_COUNT = 4u;
+  static constexpr u32 MAX_DELAY = (1u << (LEVEL_BITS * LEVEL_COUNT)) - 1u;
+
+private:
+  static constexpr u32 NULL_NODE = std::numeric_limits<u32>::max();
+
+  struct node {
+    ntf::optional<T> value;
+    u32 expires;
+    u32 prev, next; // Next free node when dead
+    u32 bucket;
+    u32 gen;
+  };
+
+public:
+  timing_wheel() { _buckets.fill(NULL_NODE); }
+
+public:
+  // Fires after `delay` calls to advance(), at least one
+  template<typename... Args>
+  timer_id schedule(u32 delay, Args&&... args) {
+    const u32 idx = _alloc_node();
+    auto& n = _nodes[idx];
+    n.value.emplace(std::forward<Args>(args)...);
+    n.expires = _now + std::clamp(delay, 1u, MAX_DELAY);
+    _link(idx);
+    ++_size;
+    return (static_cast<u64>(n.gen) << 32u) | static_cast<u64>(idx);
+  }
+
+  bool is_pending(timer_id id) const {
+    const u32 idx = static_cast<u32>(id & 0xFFFFFFFF);
+    return idx < _nodes.size() && _nodes[idx].gen == static_cast<u32>(id >> 32u) &&
+           _nodes[idx].value.has_value();
+  }
+
+  bool cancel(timer_id id) {
+    if (!is_pending(id)) {
+      return false;
+    }
+    const u32 idx = static_cast<u32>(id & 0xFFFFFFFF);
+    _unlink(idx);
+    _free_node(idx);
+    return true;
+  }
+
+  // Moves one tick forward and calls func(T&&) for every timer due. The callback can schedule
+  // and cancel timers, new ones never fire in the same call.
+  template<typename F>
+  void advance(F&& func) {
+    ++_now;
+    // Refill the lower levels when they wrap around
+    for (u32 level = 1u; level < LEVEL_COUNT; ++level) {
+      if ((_now & ((1u << (LEVEL_BITS * level)) - 1u)) != 0u) {
+        break;
+      }
+      _cascade(level, _slot_of(level, _now));
+    }
+
+    u32& head = _buckets[_slot_of(0u, _now)];
+    while (head != NULL_NODE) {
+      const u32 idx = head;
+      _unlink(idx);
+      T value = std::move(*_nodes[idx].value);
+      _free_node(idx);
+      std::invoke(func, std::move(value));
+    }
+  }
+
+public:
+  u32 now() const { return _now; }
+
+  u32 size() const { return _size; }
+
+private:
+  static u32 _slot_of(u32 level, u32 tick) {
+    return (tick >> (LEVEL_BITS * level)) & (LEVEL_SIZE - 1u);
+  }
+
+  u32 _alloc_node() {
+    if (_free != NULL_NODE) {
+      const u32 idx = _free;
+      _free = _nodes[idx].next;
+      return idx;
+    }
+    _nodes.push_back({ntf::nullopt, 0u, NULL_NODE, NULL_NODE, 0u, 0u});
+    return static_cast<u32>(_nodes.size() - 1u);
+  }
+
+  void _free_node(u32 idx) {
+    auto& n = _nodes[idx];
+    n.value.reset();
+    ++n.gen;
+    n.next = _free;
+    _free = idx;
+    --_size;
+  }
+
+  void _link(u32 idx) {
+    auto& n = _nodes[idx];
+    const u32 delta = n.expires - _now;
+    u32 level = 0u;
+    while (level + 1u < LEVEL_COUNT && delta >= (1u << (LEVEL_BITS * (level + 1u)))) {
+      ++level;
+    }
+    n.bucket = (level * LEVEL_SIZE) + _slot_of(level, n.expires);
+    u32& head = _buckets[n.bucket];
+    n.prev = NULL_NODE;
+    n.next = head;
+    if (head != NULL_NODE) {
+      _nodes[head].prev = idx;
+    }
+    head = idx;
+  }
+
+  void _unlink(u32 idx) {
+    auto& n = _nodes[idx];
+    if (n.prev != NULL_NODE) {
+      _nodes[n.prev].next = n.next;
+    } else {
+      _buckets[n.bucket] = n.next;
+    }
+    if (n.next != NULL_NODE) {
+      _nodes[n.next].prev = n.prev;
+    }
+  }
+
+  void _cascade(u32 level, u32 slot) {
+    u32 idx = std::exchange(_buckets[(level * LEVEL_SIZE) + slot], NULL_NODE);
+    while (idx != NULL_NODE) {
+      const u32 next = _nodes[idx].next;
+      _link(idx);
+      idx = next;
+    }
+  }
+
+private:
+  std::vector<node> _nodes;
+  std::array<u32, LEVEL_SIZE * LEVEL_COUNT> _buckets;
+  u32 _free{NULL_NODE};
+  u32 _now{0u};
+  u32 _size{0u};
+};
+
+} // namespace okuu::util